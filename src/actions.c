@@ -23,6 +23,7 @@
 #include "xschem.h"
 #ifdef __unix__
 #include <sys/wait.h>  /* waitpid */
+#include <dirent.h>  /* opendir */
 #endif
 
 void here(double i)
@@ -353,31 +354,375 @@ int set_netlist_dir(int what, const char *dir)
   return 1;
 }
 
-/* wrapper to TCL function */
+#ifdef __unix__
+/* SYMBOL PATH INDEX
+ * entries of directories searched by abs_sym_path(), so testing a missing file
+ * (most lookups when searching pathlist) is a hash lookup instead of a file system
+ * access. Resolved paths are kept too, so a symbol is searched only once.
+ * File system is checked again only after revalidate_sym_path_index(), called on
+ * each xschem command and event: then directories are stat()ed once and scanned
+ * again if their modification time changes. */
+typedef struct {
+  time_t mtime;   /* directory modification time at scan */
+  time_t scanned; /* time of scan */
+  int checked;    /* sym_path_stamp when mtime was last checked */
+  int missing;    /* directory does not exist */
+  int unreadable; /* opendir() failed (search only permission), use stat() */
+  Int_hashtable names;
+} Dir_index;
+
+static Ptr_hashtable dir_index = {NULL, 0}; /* safe even with multiple schematics */
+static Str_hashtable sym_path_res = {NULL, 0}; /* resolved abs_sym_path() results */
+static int sym_path_stamp = 1; /* incremented by revalidate_sym_path_index() */
+static int sym_path_res_stamp = 0; /* sym_path_stamp when sym_path_res was filled */
+static char sym_path_cwd[PATH_MAX]; /* current directory, got once for each stamp */
+static char *pathlist_str = NULL; /* pathlist tcl variable split into pathlist_dir[] */
+static char **pathlist_dir = NULL;
+static int pathlist_n = 0;
+
+/* drop resolved paths and get current directory if stamp changed */
+static void sym_path_check_stamp(void)
+{
+  if(sym_path_res_stamp == sym_path_stamp) return;
+  sym_path_res_stamp = sym_path_stamp;
+  str_hash_free(&sym_path_res);
+  str_hash_init(&sym_path_res, HASHSIZE);
+  if(!getcwd(sym_path_cwd, S(sym_path_cwd))) sym_path_cwd[0] = '\0';
+}
+
+static void scan_dir_index(Dir_index *d, const char *dir)
+{
+  DIR *dp;
+  struct dirent *de;
+
+  int_hash_free(&d->names);
+  int_hash_init(&d->names, 1021);
+  d->unreadable = 0;
+  if(!(dp = opendir(dir))) {
+    d->unreadable = 1;
+    return;
+  }
+  while((de = readdir(dp))) {
+    int_hash_lookup(&d->names, de->d_name, 1, XINSERT);
+  }
+  closedir(dp);
+}
+
+/* return 1 if file path exists */
+static int sym_path_exists(const char *path)
+{
+  char dir[PATH_MAX];
+  const char *base;
+  struct stat buf;
+  Ptr_hashentry *entry;
+  Dir_index *d;
+
+  base = strrchr(path, '/');
+  if(!base || base == path || !base[1] || !strcmp(base + 1, ".") || !strcmp(base + 1, "..") ||
+     base - path >= PATH_MAX) return !stat(path, &buf);
+  my_strncpy(dir, path, base - path + 1);
+  base++;
+  if(!dir_index.table) ptr_hash_init(&dir_index, HASHSIZE);
+  if((entry = ptr_hash_lookup(&dir_index, dir, NULL, XLOOKUP))) {
+    d = entry->value;
+  } else {
+    d = my_calloc(_ALLOC_ID_, 1, sizeof(Dir_index));
+    ptr_hash_lookup(&dir_index, dir, d, XINSERT);
+  }
+  if(d->checked != sym_path_stamp) {
+    d->checked = sym_path_stamp;
+    d->missing = stat(dir, &buf) != 0;
+    /* also scan again if directory was modified in the same second of last scan */
+    if(!d->missing && (!d->names.table || buf.st_mtime != d->mtime || d->mtime >= d->scanned)) {
+      dbg(1, "sym_path_exists(): scanning %s\n", dir);
+      d->mtime = buf.st_mtime;
+      d->scanned = time(NULL);
+      scan_dir_index(d, dir);
+    }
+  }
+  if(d->missing) return 0;
+  if(d->unreadable) return !stat(path, &buf);
+  /* confirm hits, a dangling symlink is listed but does not exist, like tcl 'file exists'.
+   * Done once for each resolved symbol, see native_abs_sym_path() */
+  return int_hash_lookup(&d->names, base, 0, XLOOKUP) != NULL && !stat(path, &buf);
+}
+
+/* search paths from pathlist tcl variable, split again only if changed */
+static char **sym_pathlist(int *n)
+{
+  const char *pathlist;
+  const char **argv;
+  int i;
+
+  pathlist = tclgetvar("pathlist");
+  if(!pathlist) pathlist = "";
+  if(!pathlist_str || strcmp(pathlist, pathlist_str)) {
+    for(i = 0; i < pathlist_n; ++i) my_free(_ALLOC_ID_, &pathlist_dir[i]);
+    my_free(_ALLOC_ID_, &pathlist_dir);
+    pathlist_n = 0;
+    my_strdup2(_ALLOC_ID_, &pathlist_str, pathlist);
+    sym_path_res_stamp = 0;
+    if(Tcl_SplitList(interp, pathlist, &pathlist_n, &argv) == TCL_OK) {
+      pathlist_dir = my_calloc(_ALLOC_ID_, pathlist_n + 1, sizeof(char *));
+      for(i = 0; i < pathlist_n; ++i) my_strdup2(_ALLOC_ID_, &pathlist_dir[i], argv[i]);
+      Tcl_Free((char *)argv);
+    } else pathlist_n = 0;
+  }
+  *n = pathlist_n;
+  return pathlist_dir;
+}
+
+/* same as tcl 'file dirname' */
+static void sym_path_dirname(char *f)
+{
+  char *p;
+  size_t l = strlen(f);
+
+  while(l > 1 && f[l - 1] == '/') f[--l] = '\0';
+  if(!(p = strrchr(f, '/'))) {
+    my_strncpy(f, ".", 2);
+    return;
+  }
+  while(p > f && p[-1] == '/') p--;
+  if(p == f) p++;
+  *p = '\0';
+}
+
+/* transform one 'x/../' (or 'x/..') into '', x being a path component not made only of dots.
+ * return 0 if nothing found */
+static int sym_path_dotdot(char *f)
+{
+  char *c = f, *e;
+
+  while(*c) {
+    e = c + strcspn(c, "/");
+    if(!*e) return 0;
+    if(e > c && strspn(c, ".") < (size_t)(e - c) && !strncmp(e, "/..", 3)) {
+      e += 3;
+      if(*e == '/') e++;
+      memmove(c, e, strlen(e) + 1);
+      return 1;
+    }
+    c = e + 1;
+  }
+  return 0;
+}
+
+/* C version of abs_sym_path tcl proc, result stored in res */
+static void resolve_sym_path(const char *s, const char *ext, char *res, size_t ressize)
+{
+  char fname[PATH_MAX], tmpdirname[PATH_MAX];
+  const char *cwd = sym_path_cwd;
+  char *p, *q, *tmpfname;
+  char **pathlist;
+  const char *path_elem;
+  size_t l;
+  int i, n, found = 0;
+
+  my_strncpy(fname, s, S(fname));
+  /* add extension for 1.0 file format compatibility */
+  if(ext[0]) {
+    p = strrchr(fname, '.');
+    q = strrchr(fname, '/');
+    if(p && (!q || p > q)) *p = '\0';
+    l = strlen(fname);
+    my_strncpy(fname + l, ext, S(fname) - l);
+  }
+  /* web url or absolute path: return as is */
+  if(!strncmp(fname, "http://", 7) || !strncmp(fname, "https://", 8) || fname[0] == '/') {
+    my_strncpy(res, fname, ressize);
+    return;
+  }
+  /* replace all runs of multiple / with single / */
+  for(p = q = fname; *p; p++) {
+    if(*p != '/' || q == fname || q[-1] != '/') *q++ = *p;
+  }
+  *q = '\0';
+  /* replace all '/./' with '/' */
+  while((p = strstr(fname, "/./"))) memmove(p + 1, p + 3, strlen(p + 3) + 1);
+  /* transform  a/b/../c to a/c or a/b/c/.. to a/b */
+  while(sym_path_dotdot(fname));
+  /* remove trailing '/'  or '/.' */
+  while((l = strlen(fname)) > 0) {
+    if(fname[l - 1] == '/') fname[l - 1] = '\0';
+    else if(l > 1 && !strcmp(fname + l - 2, "/.")) fname[l - 2] = '\0';
+    else break;
+  }
+  /* remove any leading './', found set to 1 if fname begins with './' or '../' */
+  while(!strncmp(fname, "./", 2)) {
+    memmove(fname, fname + 2, strlen(fname + 2) + 1);
+    found = 1;
+  }
+  if(!fname[0]) my_strncpy(fname, ".", S(fname));
+  if(!strcmp(fname, ".")) {
+    my_strncpy(res, cwd, ressize);
+    return;
+  }
+  my_strncpy(tmpdirname, cwd, S(tmpdirname));
+  tmpfname = fname;
+  /* remove leading '../' and one path component from tmpdirname for each */
+  while(!strncmp(tmpfname, "../", 3)) {
+    tmpfname += 3;
+    found = 1;
+    sym_path_dirname(tmpdirname);
+  }
+  if(!strcmp(tmpfname, "..")) {
+    sym_path_dirname(tmpdirname);
+    my_strncpy(res, tmpdirname, ressize);
+    return;
+  }
+  /* if fname begins with './' or '../' and file or its directory exists return it */
+  if(found) {
+    my_snprintf(res, ressize, "%s/%s", tmpdirname, tmpfname);
+    if(sym_path_exists(res)) return;
+    my_strncpy(tmpdirname, res, S(tmpdirname));
+    sym_path_dirname(tmpdirname);
+    if(sym_path_exists(tmpdirname)) return;
+  }
+  /* if fname is present in one of the pathlist paths get the absolute path */
+  pathlist = sym_pathlist(&n);
+  for(i = 0; i < n; ++i) {
+    path_elem = strcmp(pathlist[i], ".") ? pathlist[i] : cwd;
+    my_snprintf(res, ressize, "%s/%s", path_elem, fname);
+    if(sym_path_exists(res)) return;
+  }
+  /* nothing found -> use current directory */
+  my_snprintf(res, ressize, "%s/%s", cwd, fname);
+}
+
+/* C version of abs_sym_path tcl proc. Results are kept until file system is checked
+ * again (see revalidate_sym_path_index()) */
+static const char *native_abs_sym_path(const char *s, const char *ext)
+{
+  static char res[PATH_MAX]; /* safe to keep even with multiple schematics */
+  char key[PATH_MAX + 100];
+  Str_hashentry *entry;
+  int n;
+
+  if(!s[0]) return "";
+  sym_pathlist(&n); /* drops resolved paths if pathlist changed */
+  sym_path_check_stamp();
+  my_snprintf(key, S(key), "%s\n%s", s, ext);
+  if((entry = str_hash_lookup(&sym_path_res, key, NULL, XLOOKUP))) {
+    my_strncpy(res, entry->value, S(res));
+    return res;
+  }
+  resolve_sym_path(s, ext, res, S(res));
+  str_hash_lookup(&sym_path_res, key, res, XINSERT);
+  return res;
+}
+
+/* C version of rel_sym_path tcl proc */
+static const char *native_rel_sym_path(const char *s)
+{
+  static char res[PATH_MAX]; /* safe to keep even with multiple schematics */
+  char symbol[PATH_MAX], path_elem[PATH_MAX];
+  const char *cwd = sym_path_cwd;
+  char **pathlist;
+  const char *name = NULL;
+  size_t l;
+  int i, n;
+
+  sym_path_check_stamp();
+  my_strncpy(symbol, s, S(symbol));
+  pathlist = sym_pathlist(&n);
+  for(i = 0; i < n; ++i) {
+    my_strncpy(path_elem, strcmp(pathlist[i], ".") ? pathlist[i] : cwd, S(path_elem));
+    l = strlen(path_elem);
+    if((!l || path_elem[l - 1] != '/') && l + 1 < S(path_elem)) {
+      path_elem[l++] = '/';
+      path_elem[l] = '\0';
+    }
+    if(!strncmp(path_elem, symbol, l)) {
+      name = symbol + l;
+      break;
+    }
+  }
+  if(!name || !name[0]) {
+    /* no known lib, so return full path, remove path if file is in current directory */
+    my_strncpy(res, symbol, S(res));
+    sym_path_dirname(res);
+    if(!strcmp(res, cwd)) {
+      l = strlen(symbol);
+      while(l > 1 && symbol[l - 1] == '/') symbol[--l] = '\0';
+      name = strrchr(symbol, '/') ? strrchr(symbol, '/') + 1 : symbol;
+    } else name = symbol;
+  }
+  my_strncpy(res, name, S(res));
+  return res;
+}
+#endif
+
+void free_sym_path_index(void)
+{
+  #ifdef __unix__
+  int i;
+  Ptr_hashentry *entry;
+  Dir_index *d;
+
+  for(i = 0; i < dir_index.size; ++i) {
+    for(entry = dir_index.table[i]; entry; entry = entry->next) {
+      d = entry->value;
+      int_hash_free(&d->names);
+      my_free(_ALLOC_ID_, &d);
+    }
+  }
+  ptr_hash_free(&dir_index);
+  str_hash_free(&sym_path_res);
+  sym_path_res_stamp = 0;
+  for(i = 0; i < pathlist_n; ++i) my_free(_ALLOC_ID_, &pathlist_dir[i]);
+  my_free(_ALLOC_ID_, &pathlist_dir);
+  my_free(_ALLOC_ID_, &pathlist_str);
+  pathlist_n = 0;
+  #endif
+}
+
+/* next symbol path lookups will check the file system again */
+void revalidate_sym_path_index(void)
+{
+  #ifdef __unix__
+  sym_path_stamp++;
+  #endif
+}
+
 /* remove parameter section of symbol generator before calculating abs path : xxx(a,b) -> xxx */
 const char *sanitized_abs_sym_path(const char *s, const char *ext)
 {   
   char c[PATH_MAX+1000];
-      
+
+  #ifdef __unix__
+  if(!tclgetboolvar("tcl_sym_path")) {
+    my_strncpy(c, s, S(c));
+    c[strcspn(c, "(")] = '\0';
+    return native_abs_sym_path(c, ext);
+  }
+  #endif
   my_snprintf(c, S(c), "abs_sym_path [regsub {\\(.*} {%s} {}] {%s}", s, ext);
   tcleval(c);
   return tclresult();
 }
 
-/* wrapper to TCL function */
+/* symbol reference -> absolute path. Uses the abs_sym_path tcl proc if tcl_sym_path is set */
 const char *abs_sym_path(const char *s, const char *ext)
 {
   char c[PATH_MAX+1000];
 
+  #ifdef __unix__
+  if(!tclgetboolvar("tcl_sym_path")) return native_abs_sym_path(s, ext);
+  #endif
   my_snprintf(c, S(c), "abs_sym_path {%s} {%s}", s, ext);
   tcleval(c);
   return tclresult();
 }
 
-/* Wrapper to Tcl function */
+/* absolute path -> symbol reference. Uses the rel_sym_path tcl proc if tcl_sym_path is set */
 const char *rel_sym_path(const char *s)
 {
   char c[PATH_MAX+1000];
+
+  #ifdef __unix__
+  if(!tclgetboolvar("tcl_sym_path")) return native_rel_sym_path(s);
+  #endif
   my_snprintf(c, S(c), "rel_sym_path {%s}", s);
   tcleval(c);
   return tclresult();
@@ -639,86 +984,93 @@ void ask_new_file(void)
 /* Warning: removing a symbol with a loaded schematic will make all symbol references corrupt */
 /* you should clear_drawing() first or load_schematic() or link_symbols_to_instances()
    immediately afterwards */
-void remove_symbol(int j)
+/* free all data of symbol 'sym', leaving an empty symbol */
+void free_symbol(xSymbol *sym)
 {
   int i,c;
-  xSymbol save;
 
-  dbg(1,"clearing symbol %d: %s\n", j, xctx->sym[j].name);
-  my_free(_ALLOC_ID_, &xctx->sym[j].prop_ptr);
-  my_free(_ALLOC_ID_, &xctx->sym[j].templ);
-  my_free(_ALLOC_ID_, &xctx->sym[j].parent_prop_ptr);
-  my_free(_ALLOC_ID_, &xctx->sym[j].type);
-  my_free(_ALLOC_ID_, &xctx->sym[j].name);
+  my_free(_ALLOC_ID_, &sym->prop_ptr);
+  my_free(_ALLOC_ID_, &sym->templ);
+  my_free(_ALLOC_ID_, &sym->parent_prop_ptr);
+  my_free(_ALLOC_ID_, &sym->type);
+  my_free(_ALLOC_ID_, &sym->name);
   /*  /20150409 */
   for(c=0;c<cadlayers; ++c) {
-    for(i=0;i<xctx->sym[j].polygons[c]; ++i) {
-      if(xctx->sym[j].poly[c][i].prop_ptr != NULL) {
-        my_free(_ALLOC_ID_, &xctx->sym[j].poly[c][i].prop_ptr);
+    for(i=0;i<sym->polygons[c]; ++i) {
+      if(sym->poly[c][i].prop_ptr != NULL) {
+        my_free(_ALLOC_ID_, &sym->poly[c][i].prop_ptr);
       }
-      my_free(_ALLOC_ID_, &xctx->sym[j].poly[c][i].x);
-      my_free(_ALLOC_ID_, &xctx->sym[j].poly[c][i].y);
-      my_free(_ALLOC_ID_, &xctx->sym[j].poly[c][i].selected_point);
+      my_free(_ALLOC_ID_, &sym->poly[c][i].x);
+      my_free(_ALLOC_ID_, &sym->poly[c][i].y);
+      my_free(_ALLOC_ID_, &sym->poly[c][i].selected_point);
     }
-    my_free(_ALLOC_ID_, &xctx->sym[j].poly[c]);
-    xctx->sym[j].polygons[c] = 0;
+    my_free(_ALLOC_ID_, &sym->poly[c]);
+    sym->polygons[c] = 0;
  
-    for(i=0;i<xctx->sym[j].lines[c]; ++i) {
-      if(xctx->sym[j].line[c][i].prop_ptr != NULL) {
-        my_free(_ALLOC_ID_, &xctx->sym[j].line[c][i].prop_ptr);
+    for(i=0;i<sym->lines[c]; ++i) {
+      if(sym->line[c][i].prop_ptr != NULL) {
+        my_free(_ALLOC_ID_, &sym->line[c][i].prop_ptr);
       }
     }
-    my_free(_ALLOC_ID_, &xctx->sym[j].line[c]);
-    xctx->sym[j].lines[c] = 0;
+    my_free(_ALLOC_ID_, &sym->line[c]);
+    sym->lines[c] = 0;
  
-    for(i=0;i<xctx->sym[j].arcs[c]; ++i) {
-      if(xctx->sym[j].arc[c][i].prop_ptr != NULL) {
-        my_free(_ALLOC_ID_, &xctx->sym[j].arc[c][i].prop_ptr);
+    for(i=0;i<sym->arcs[c]; ++i) {
+      if(sym->arc[c][i].prop_ptr != NULL) {
+        my_free(_ALLOC_ID_, &sym->arc[c][i].prop_ptr);
       }
     }
-    my_free(_ALLOC_ID_, &xctx->sym[j].arc[c]);
-    xctx->sym[j].arcs[c] = 0;
+    my_free(_ALLOC_ID_, &sym->arc[c]);
+    sym->arcs[c] = 0;
  
-    for(i=0;i<xctx->sym[j].rects[c]; ++i) {
-      if(xctx->sym[j].rect[c][i].prop_ptr != NULL) {
-        my_free(_ALLOC_ID_, &xctx->sym[j].rect[c][i].prop_ptr);
+    for(i=0;i<sym->rects[c]; ++i) {
+      if(sym->rect[c][i].prop_ptr != NULL) {
+        my_free(_ALLOC_ID_, &sym->rect[c][i].prop_ptr);
       }
-      set_rect_extraptr(0, &xctx->sym[j].rect[c][i]);
+      set_rect_extraptr(0, &sym->rect[c][i]);
     }
-    my_free(_ALLOC_ID_, &xctx->sym[j].rect[c]);
-    xctx->sym[j].rects[c] = 0;
+    my_free(_ALLOC_ID_, &sym->rect[c]);
+    sym->rects[c] = 0;
   }
-  for(i=0;i<xctx->sym[j].texts; ++i) {
-    if(xctx->sym[j].text[i].prop_ptr != NULL) {
-      my_free(_ALLOC_ID_, &xctx->sym[j].text[i].prop_ptr);
+  for(i=0;i<sym->texts; ++i) {
+    if(sym->text[i].prop_ptr != NULL) {
+      my_free(_ALLOC_ID_, &sym->text[i].prop_ptr);
     }
-    if(xctx->sym[j].text[i].txt_ptr != NULL) {
-      my_free(_ALLOC_ID_, &xctx->sym[j].text[i].txt_ptr);
-      dbg(1, "remove_symbol(): freeing symbol %d text_ptr %d\n", j, i);
+    if(sym->text[i].txt_ptr != NULL) {
+      my_free(_ALLOC_ID_, &sym->text[i].txt_ptr);
+      dbg(1, "free_symbol(): freeing text_ptr %d\n", i);
     }
-    if(xctx->sym[j].text[i].font != NULL) {
-      my_free(_ALLOC_ID_, &xctx->sym[j].text[i].font);
+    if(sym->text[i].font != NULL) {
+      my_free(_ALLOC_ID_, &sym->text[i].font);
     }
-    if(xctx->sym[j].text[i].floater_instname != NULL) {
-      my_free(_ALLOC_ID_, &xctx->sym[j].text[i].floater_instname);
+    if(sym->text[i].floater_instname != NULL) {
+      my_free(_ALLOC_ID_, &sym->text[i].floater_instname);
     }
-    if(xctx->sym[j].text[i].floater_ptr != NULL) {
-      my_free(_ALLOC_ID_, &xctx->sym[j].text[i].floater_ptr);
+    if(sym->text[i].floater_ptr != NULL) {
+      my_free(_ALLOC_ID_, &sym->text[i].floater_ptr);
     }
   }
-  my_free(_ALLOC_ID_, &xctx->sym[j].text);
-
-  my_free(_ALLOC_ID_, &xctx->sym[j].line);
-  my_free(_ALLOC_ID_, &xctx->sym[j].rect);
-  my_free(_ALLOC_ID_, &xctx->sym[j].arc);
-  my_free(_ALLOC_ID_, &xctx->sym[j].poly);
-  my_free(_ALLOC_ID_, &xctx->sym[j].lines);
-  my_free(_ALLOC_ID_, &xctx->sym[j].polygons);
-  my_free(_ALLOC_ID_, &xctx->sym[j].arcs);
-  my_free(_ALLOC_ID_, &xctx->sym[j].rects);
+  my_free(_ALLOC_ID_, &sym->text);
+
+  my_free(_ALLOC_ID_, &sym->line);
+  my_free(_ALLOC_ID_, &sym->rect);
+  my_free(_ALLOC_ID_, &sym->arc);
+  my_free(_ALLOC_ID_, &sym->poly);
+  my_free(_ALLOC_ID_, &sym->lines);
+  my_free(_ALLOC_ID_, &sym->polygons);
+  my_free(_ALLOC_ID_, &sym->arcs);
+  my_free(_ALLOC_ID_, &sym->rects);
+
+  sym->texts = 0;
+}
 
-  xctx->sym[j].texts = 0;
+void remove_symbol(int j)
+{
+  int i;
+  xSymbol save;
 
+  dbg(1,"clearing symbol %d: %s\n", j, xctx->sym[j].name);
+  free_symbol(&xctx->sym[j]);
   save = xctx->sym[j]; /* save cleared symbol slot */
   for(i = j + 1; i < xctx->symbols; ++i) {
     xctx->sym[i-1] = xctx->sym[i];
@@ -953,6 +1305,7 @@ void clear_drawing(void)
 {
  int i,j;
  xctx->graph_lastsel = -1;
+ free_graph_cache();
  del_inst_table();
  del_wire_table();
  my_free(_ALLOC_ID_, &xctx->schtedaxprop);
@@ -206,14 +206,14 @@ static void start_wire(double mx, double my)
 
 static double interpolate_yval(int idx, int p, double x, int sweep_idx, int point_not_last)
 {          
-  double val = xctx->raw->values[idx][p];
+  /* get_raw_point(): do not load all data columns if raw file is mapped (raw_mmap) */
+  double val = get_raw_point(xctx->raw, idx, p);
   /* not operating point, annotate from 'b' cursor */
   if(point_not_last && (xctx->raw->allpoints > 1) && sweep_idx >= 0) {
     Raw *raw = xctx->raw;
     SPICE_DATA *sweep_gv = raw->values[sweep_idx];
-    SPICE_DATA *gv = raw->values[idx];
     double dx = sweep_gv[p + 1] - sweep_gv[p];
-    double dy = gv[p + 1] - gv[p];
+    double dy = get_raw_point(raw, idx, p + 1) - val;
     double offset = x - sweep_gv[p];
     double interp = dx != 0.0 ? offset * dy / dx : 0.0;
     val += interp;
@@ -304,19 +304,13 @@ void backannotate_at_cursor_b_pos(xRect *r, Graph_ctx *gr)
         }
       }
       dbg(1, "xx=%g, p=%d\n", xx, p);
-      Tcl_UnsetVar(interp, "ngspice::ngspice_data", TCL_GLOBAL_ONLY);
       raw->annot_p = p;
       raw->annot_x = cursor2;
       raw->annot_sweep_idx = sweep_idx;
       for(i = 0; i < raw->nvars; ++i) {
-        char s[100];
         raw->cursor_b_val[i] = interpolate_yval(i, p, cursor2, sweep_idx, (p < ofs_end));
-        my_snprintf(s, S(s), "%.5g", raw->cursor_b_val[i]);
-        /* tclvareval("array set ngspice::ngspice_data [list {",  raw->names[i], "} ", s, "]", NULL); */
-        Tcl_SetVar2(interp, "ngspice::ngspice_data", raw->names[i], s, TCL_GLOBAL_ONLY);
       }
-      Tcl_SetVar2(interp, "ngspice::ngspice_data", "n\\ vars", my_itoa( raw->nvars), TCL_GLOBAL_ONLY);
-      Tcl_SetVar2(interp, "ngspice::ngspice_data", "n\\ points", "1", TCL_GLOBAL_ONLY);
+      set_op_data(raw, "%.5g");
     }
     if(save_npoints != -1) { /* restore multiple OP points from artificial dc sweep */
       raw->datasets = save_datasets;
@@ -662,14 +656,14 @@ static int waves_callback(int event, int mx, int my, KeySym key, int button, int
     if( event == KeyPress || event == ButtonPress || event == MotionNotify ) {
       /* move cursor1 */
       if(event == MotionNotify && (state & Button1Mask) && (xctx->graph_flags & 16 )) {
-        need_redraw = 1;
+        need_redraw = 2; /* only cursors moved */
       }
       /* move cursor2 */
       else if(event == MotionNotify && (state & Button1Mask) && (xctx->graph_flags & 32 )) {
         if(tclgetboolvar("live_cursor2_backannotate")) {
           redraw_all_at_end = 1;
         }
-        else  need_redraw = 1;
+        else  need_redraw = 2;
       }
       else /* drag waves with mouse */
       if(event == MotionNotify && (state & Button1Mask) && !xctx->graph_bottom) {
@@ -1047,7 +1041,11 @@ static int waves_callback(int event, int mx, int my, KeySym key, int button, int
         }
       }
     } /* else if( event == ButtonRelease) */
-    if(need_redraw || need_all_redraw) {
+    if(need_redraw == 2 && !need_all_redraw) {
+      setup_graph_data(i, 0, gr);
+      draw_graph(i, 1 + 16 + (xctx->graph_flags & 6), gr, NULL); /* redraw cursors over cached graph */
+    }
+    else if(need_redraw || need_all_redraw) {
       setup_graph_data(i, 0, gr);
       draw_graph(i, 1 + 8 + (xctx->graph_flags & 6), gr, NULL); /* draw data in each graph box */
     }
@@ -1891,6 +1889,8 @@ int callback(const char *winpath, int event, int mx, int my, KeySym key,
 int draw_xhair = tclgetboolvar("draw_crosshair");
 int rstate; /* (reduced state, without ShiftMask) */
 
+ revalidate_raw_maps();
+ revalidate_sym_path_index();
  /* this fix uses an alternative method for getting mouse coordinates on KeyPress/KeyRelease
   * events. Some remote connection softwares do not generate the correct coordinates
   * on such events */
@@ -2197,10 +2197,9 @@ int sch_waves_loaded(void)
   return -1;
 }
 
-static void get_bus_value(int n_bits, int hex_digits, SPICE_DATA **idx_arr, int p, char *busval,
-                   double vthl, double vthh)
+/* hex value of bus from logic level (0, 1, 2 = X) of each bit, bits[0] is MSB */
+static void get_bus_value(int n_bits, int hex_digits, const char *bits, char *busval)
 {
-  double val;
   int i;
   int hexdigit = 0;
   int bin = 0;
@@ -2208,14 +2207,12 @@ static void get_bus_value(int n_bits, int hex_digits, SPICE_DATA **idx_arr, int
   char hexstr[] = "084C2A6E195D3B7F"; /* mirrored (Left/right) hex */
   int x = 0;
   for(i = n_bits - 1; i >= 0; i--) {
-    if(idx_arr[i]) val = idx_arr[i][p];
-    else val = 0.0; /* undefined bus element */
-    if(val >= vthl && val <= vthh) { /* signal transitioning --> 'X' */
+    if(bits[i] == 2) { /* signal transitioning --> 'X' */
        x = 1; /* flag for 'X' value */
        i += bin - 3;
        bin = 3; /* skip remaining bits of hex digit */
        if(i < 0) break; /* MSB nibble is less than 4 bits --> break */
-    } else hexdigit |= (val >= vthh ? 1 : 0);
+    } else hexdigit |= bits[i];
     if(bin < 3) {
       ++bin;
       hexdigit <<= 1;
@@ -2242,35 +2239,48 @@ static void get_bus_value(int n_bits, int hex_digits, SPICE_DATA **idx_arr, int
   busval[hex_digits] = '\0';
 } 
 
+/* logic level of undefined bus elements (read as 0.0) */
+static char bus_undef_level(double vthl, double vthh)
+{
+  if(0.0 >= vthl && 0.0 <= vthh) return 2;
+  return 0.0 >= vthh ? 1 : 0;
+}
 
-/* idx_arr malloc-ated and returned, caller must free! */
-static SPICE_DATA **get_bus_idx_array(const char *ntok, int *n_bits)
+/* logic levels of bus bits at point p */
+static void get_bus_bits(int n_bits, Raw_levels **lv_arr, int p, char *bits, double vthl, double vthh)
 {
-  SPICE_DATA **idx_arr =NULL;
+  int i;
+  for(i = 0; i < n_bits; i++) {
+    if(lv_arr[i]) bits[i] = lv_arr[i]->level[raw_level_run(lv_arr[i], p)];
+    else bits[i] = bus_undef_level(vthl, vthh);
+  }
+}
+
+/* lv_arr malloc-ated and returned, caller must free!
+ * Logic level runs of bus bits, NULL for undefined bus elements */
+static Raw_levels **get_bus_levels(const char *ntok, int *n_bits, double vthl, double vthh)
+{
+  Raw_levels **lv_arr =NULL;
   int p;
   char *saven, *nptr, *ntok_copy = NULL;
   const char *bit_name;
   *n_bits = count_items(ntok, ";,", "") - 1;
-  dbg(1, "get_bus_idx_array(): ntok=%s\n", ntok);
-  dbg(1, "get_bus_idx_array(): *n_bits=%d\n", *n_bits);
-  idx_arr = my_malloc(_ALLOC_ID_, (*n_bits) * sizeof(SPICE_DATA *));
+  dbg(1, "get_bus_levels(): ntok=%s\n", ntok);
+  dbg(1, "get_bus_levels(): *n_bits=%d\n", *n_bits);
+  lv_arr = my_malloc(_ALLOC_ID_, (*n_bits) * sizeof(Raw_levels *));
   p = 0;
   my_strdup2(_ALLOC_ID_, &ntok_copy, ntok);
   nptr = ntok_copy;
   my_strtok_r(nptr, ";,", "", 0, &saven); /*strip off bus name (1st field) */
   while( (bit_name = my_strtok_r(NULL, ";, \n", "", 0, &saven)) ) {
-    int idx;
     if(p >= *n_bits) break; /* security check to avoid out of bound writing */
-    if( (idx = get_raw_index(bit_name, NULL)) != -1) {
-      idx_arr[p] = xctx->raw->values[idx];
-    } else {
-      idx_arr[p] = NULL;
-    }
-    /* dbg(0, "get_bus_idx_array(): bit_name=%s, p=%d\n", bit_name, p); */
+    lv_arr[p] = get_raw_levels(xctx->raw, get_raw_index(bit_name, NULL), vthl, vthh);
+    /* dbg(0, "get_bus_levels(): bit_name=%s, p=%d\n", bit_name, p); */
     ++p;
   }
+  for(; p < *n_bits; p++) lv_arr[p] = NULL;
   my_free(_ALLOC_ID_, &ntok_copy);
-  return idx_arr;
+  return lv_arr;
 }
 
 /* what == 1: set thick lines,
@@ -2290,6 +2300,40 @@ static void set_thick_waves(int what, int wcnt, int wave_col, Graph_ctx *gr)
   }
 }
 
+/* if sweep variable is strictly increasing in dataset points [ofs, ofs_end) (and so is
+ * spice sweep variable if wraps are checked) return 1 and set [*first, *last] to the range
+ * of points with sweep value in [start, end], *first > *last if none.
+ * return 0 if sweep variable is not monotonic (multiple curves in dataset): caller
+ * must scan all points */
+static int visible_sweep_range(Raw *raw, int sweep_idx, int allow_wrap, int ofs, int ofs_end,
+       double start, double end, int logx, int *first, int *last)
+{
+  SPICE_DATA *gv = raw->values[sweep_idx];
+  int lo, hi, mid;
+
+  if(ofs_end - ofs < 2) return 0;
+  if(!get_raw_run(raw, sweep_idx, ofs, ofs_end - 1)) return 0;
+  if(allow_wrap && sweep_idx != 0 && !get_raw_run(raw, 0, ofs, ofs_end - 1)) return 0;
+  if(logx && gv[ofs] <= 0.0) return 0; /* mylog10() not monotonic */
+  /* first point with sweep value >= start */
+  lo = ofs; hi = ofs_end;
+  while(lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if((logx ? mylog10(gv[mid]) : gv[mid]) < start) lo = mid + 1;
+    else hi = mid;
+  }
+  *first = lo;
+  /* first point with sweep value > end */
+  hi = ofs_end;
+  while(lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if((logx ? mylog10(gv[mid]) : gv[mid]) <= end) lo = mid + 1;
+    else hi = mid;
+  }
+  *last = lo - 1;
+  return 1;
+}
+
 int graph_fullxzoom(int i, Graph_ctx *gr, int dataset)
 {
   xRect *r = &xctx->rect[GRIDLAYER][i];
@@ -2299,7 +2343,7 @@ int graph_fullxzoom(int i, Graph_ctx *gr, int dataset)
     int dset = dataset == -1 ? 0 : dataset;
     char *custom_rawfile = NULL; /* "rawfile" attr. set in graph: load and switch to specified raw */
     char *sim_type = NULL;
-    int k, save_datasets = -1, save_npoints = -1;
+    int k, ofs, save_datasets = -1, save_npoints = -1;
     int autoload = 0;
     Raw *raw = NULL;
 
@@ -2337,11 +2381,18 @@ int graph_fullxzoom(int i, Graph_ctx *gr, int dataset)
       save_npoints = raw->npoints[0];
       raw->npoints[0] = raw->allpoints;
     }   
-    xx1 = xx2 = get_raw_value(dset, idx, 0);
-    for(k = 0; k < xctx->raw->npoints[dset]; k++) {
-      double v = get_raw_value(dset, idx, k);
-      if(v < xx1) xx1 = v;
-      if(v > xx2) xx2 = v;
+    for(ofs = 0, k = 0; k < dset; k++) ofs += raw->npoints[k];
+    if(get_raw_run(raw, idx, ofs, ofs + raw->npoints[dset] - 1)) {
+      /* monotonic sweep: range given by first and last points */
+      xx1 = get_raw_value(dset, idx, 0);
+      xx2 = get_raw_value(dset, idx, raw->npoints[dset] - 1);
+    } else {
+      xx1 = xx2 = get_raw_value(dset, idx, 0);
+      for(k = 0; k < xctx->raw->npoints[dset]; k++) {
+        double v = get_raw_value(dset, idx, k);
+        if(v < xx1) xx1 = v;
+        if(v > xx2) xx2 = v;
+      }
     }
     if(gr->logx) {
       xx1 = mylog10(xx1);
@@ -2495,7 +2546,28 @@ int graph_fullyzoom(xRect *r,  Graph_ctx *gr, int graph_dataset)
             int cnt=0, wrap;
             register SPICE_DATA *gv = raw->values[sweep_idx];
             SPICE_DATA *gv0 = raw->values[0]; /* spice sweep variable, used to determine wrap arounds */
+            int first, last;
             ofs_end = ofs + raw->npoints[dset];
+            /* monotonic sweep: get min/max in visible points range without scanning whole dataset */
+            if(visible_sweep_range(raw, sweep_idx, allow_wrap, ofs, ofs_end, start, end, gr->logx, &first, &last)) {
+              if((dataset == -1 || dataset == sweepvar_wrap) && first <= last) {
+                double vmin, vmax;
+                if(gr->logy) {
+                  vmin = vmax = mylog10(raw->values[v][first]);
+                  for(p = first + 1; p <= last; p++) {
+                    val = mylog10(raw->values[v][p]);
+                    if(val < vmin) vmin = val;
+                    if(val > vmax) vmax = val;
+                  }
+                } else get_raw_minmax(raw, v, first, last, &vmin, &vmax);
+                if(firstyval || vmin < min) min = vmin;
+                if(firstyval || vmax > max) max = vmax;
+                firstyval = 0;
+              }
+              ofs = ofs_end;
+              sweepvar_wrap++;
+              continue;
+            }
             for(p = ofs ; p < ofs_end; p++) {
               if(gr->logx) xx = mylog10(gv[p]);
               else xx = gv[p];
@@ -2566,10 +2638,10 @@ int graph_fullyzoom(xRect *r,  Graph_ctx *gr, int graph_dataset)
  * following are bits that are bundled together:
    LDA,LDA[3],LDA[2],LDA1],LDA[0]
  */
-static void draw_graph_bus_points(const char *ntok, int n_bits, SPICE_DATA **idx_arr, 
+static void draw_graph_bus_points(const char *ntok, int n_bits, Raw_levels **lv_arr, 
          int first, int last, int wave_col, int sweep_idx, int wcnt, int n_nodes, Graph_ctx *gr, void *ct)
 {
-  int p;
+  int p, i;
   double s1 = DIG_NWAVES; /* 1/DIG_NWAVES  waveforms fit in graph if unscaled vertically */
   double s2 = DIG_SPACE; /* (DIG_NWAVES - DIG_SPACE) spacing between traces */
   double c = (n_nodes - wcnt) * s1 * gr->gh - gr->gy1 * s2; /* trace baseline */
@@ -2587,6 +2659,8 @@ static void draw_graph_bus_points(const char *ntok, int n_bits, SPICE_DATA **idx
   double vthh = gr->gy1 * 0.2 + gr->gy2 * 0.8;
   double vthl = gr->gy1 * 0.8 + gr->gy2 * 0.2;
   int hex_digits = ((n_bits - 1) >> 2) + 1;
+  char *bits; /* current logic level of each bit */
+  int *run; /* current level run of each bit */
   Raw *raw = xctx->raw;
 
   if(!raw) {
@@ -2609,21 +2683,32 @@ static void draw_graph_bus_points(const char *ntok, int n_bits, SPICE_DATA **idx
     set_thick_waves(1, wcnt, wave_col, gr);
     drawline(wave_col, NOW, lx1, ylow, lx2, ylow, 0, ct);
     drawline(wave_col, NOW, lx1, yhigh, lx2, yhigh, 0, ct);
-    for(p = first ; p <= last; p++) {
-      /* calculate value of bus by adding all binary bits */
-      /* hex_digits = */
-      get_bus_value(n_bits, hex_digits, idx_arr, p, busval, vthl, vthh);
-      if(gr->logx) {
-        xval =  W_X(mylog10(raw->values[sweep_idx][p]));
-      } else {
-        xval =  W_X(raw->values[sweep_idx][p]);
+    bits = my_malloc(_ALLOC_ID_, n_bits * sizeof(char));
+    run = my_malloc(_ALLOC_ID_, n_bits * sizeof(int));
+    /* bus value before 1st transition */
+    get_bus_bits(n_bits, lv_arr, first, bits, vthl, vthh);
+    for(i = 0; i < n_bits; i++) if(lv_arr[i]) run[i] = raw_level_run(lv_arr[i], first);
+    get_bus_value(n_bits, hex_digits, bits, old_busval);
+    xval_old = lx1;
+    /* walk bit level transitions instead of all points, bus value can change only there */
+    while(1) {
+      p = last + 1;
+      for(i = 0; i < n_bits; i++) {
+        if(lv_arr[i] && run[i] + 1 < lv_arr[i]->n && lv_arr[i]->start[run[i] + 1] < p)
+          p = lv_arr[i]->start[run[i] + 1];
       }
-      /* used to draw bus value before 1st transition */
-      if(p == first) {
-        my_strncpy(old_busval, busval, hex_digits+1);
-        xval_old = xval;
+      if(p > last) break;
+      for(i = 0; i < n_bits; i++) {
+        if(lv_arr[i] && run[i] + 1 < lv_arr[i]->n && lv_arr[i]->start[run[i] + 1] == p)
+          bits[i] = lv_arr[i]->level[++run[i]];
       }
-      if(p > first &&  strcmp(busval, old_busval)) {
+      get_bus_value(n_bits, hex_digits, bits, busval);
+      if(strcmp(busval, old_busval)) {
+        if(gr->logx) {
+          xval =  W_X(mylog10(raw->values[sweep_idx][p]));
+        } else {
+          xval =  W_X(raw->values[sweep_idx][p]);
+        }
         /* draw transition ('X') */
         drawline(BACKLAYER, NOW, xval-x_size, yhigh, xval+x_size, yhigh, 0, ct);
         drawline(BACKLAYER, NOW, xval-x_size, ylow,  xval+x_size, ylow, 0, ct);
@@ -2636,9 +2721,12 @@ static void draw_graph_bus_points(const char *ntok, int n_bits, SPICE_DATA **idx
         }
         my_strncpy(old_busval, busval, hex_digits + 1);
         xval_old = xval;
-      } /* if(p > first &&  busval != old_busval) */
-    } /* for(p = first ; p < last; p++) */
+      } /* if(strcmp(busval, old_busval)) */
+    } /* while(1) */
+    my_free(_ALLOC_ID_, &bits);
+    my_free(_ALLOC_ID_, &run);
     /* draw hex bus value after last transition */
+    xval = lx2;
     if(  fabs(xval - xval_old) > hex_digits * charwidth) {
       draw_string(wave_col, NOW, old_busval, 2, 0, 1, 0, (xval + xval_old) * 0.5,
                   yhigh, labsize, labsize);
@@ -2650,8 +2738,18 @@ static void draw_graph_bus_points(const char *ntok, int n_bits, SPICE_DATA **idx
   }
 }
 #define MAX_POLY_POINTS 4096*16
-/* wcnt is the nth wave in graph, idx is the index in spice raw file */
-static void draw_graph_points(int idx, int first, int last,
+
+/* screen x coordinate of point p of sweep variable sx */
+static short graph_sweep_px(SPICE_DATA *sx, int p, Graph_ctx *gr)
+{
+  return (short)S_X(gr->logx ? mylog10(sx[p]) : sx[p]);
+}
+
+/* wcnt is the nth wave in graph, idx is the index in spice raw file.
+ * if sweep_idx == -1 point[] x coordinates of points first...last are built by caller,
+ * otherwise sweep variable sweep_idx is monotonic in first...last and pixel columns are
+ * found by binary search, point[] must have room for 4 points per pixel column */
+static void draw_graph_points(int idx, int first, int last, int sweep_idx,
          XPoint *point, int wave_col, int wcnt, int n_nodes, Graph_ctx *gr, void *ct)
 {
   int p;
@@ -2684,19 +2782,50 @@ static void draw_graph_points(int idx, int first, int last,
     c1 = c + gr->gh * 0.5 * s2; /* trace y-center, used for clipping */
   }
   if( !digital || (c1 >= gr->ypos1 && c1 <= gr->ypos2) ) {
-    int x;
-    for(p = first ; p <= last; p++) {
-      yy = gv[p];
-      if(digital) {
-        yy = c + yy *s2;
-        /* Build poly y array. Translate from graph coordinates to screen coordinates  */
-        point[poly_npoints].y = (short)CLIP(DS_Y(yy), -30000, 30000);
+    int x, k, n, j;
+    double yval[4];
+    n = last - first + 1;
+    /* points with same x screen coordinate are reduced to first, min, max, last values,
+     * so at most 4 points are drawn per pixel column */
+    for(k = 0; k < n; k = j) {
+      short px;
+      int nval = 0;
+      if(sweep_idx >= 0) { /* last point in pixel column by binary search */
+        SPICE_DATA *sx = raw->values[sweep_idx];
+        int lo = k, hi = n - 1, mid;
+        px = graph_sweep_px(sx, first + k, gr);
+        while(lo < hi) {
+          mid = lo + (hi - lo + 1) / 2;
+          if(graph_sweep_px(sx, first + mid, gr) == px) lo = mid;
+          else hi = mid - 1;
+        }
+        j = lo + 1;
+      } else {
+        px = point[k].x;
+        for(j = k + 1; j < n && point[j].x == px; j++);
+      }
+      if(j - k <= 4) {
+        for(p = first + k; p < first + j; p++) yval[nval++] = gv[p];
       } else {
-        /* Build poly y array. Translate from graph coordinates to screen coordinates  */
-        if(gr->logy) yy = mylog10(yy);
-        point[poly_npoints].y = (short)CLIP(S_Y(yy), -30000, 30000);
+        yval[0] = gv[first + k];
+        get_raw_minmax(raw, idx, first + k + 1, first + j - 2, &yval[1], &yval[2]);
+        yval[3] = gv[first + j - 1];
+        nval = 4;
+      }
+      for(p = 0; p < nval; p++) {
+        yy = yval[p];
+        point[poly_npoints].x = px;
+        if(digital) {
+          yy = c + yy *s2;
+          /* Build poly y array. Translate from graph coordinates to screen coordinates  */
+          point[poly_npoints].y = (short)CLIP(DS_Y(yy), -30000, 30000);
+        } else {
+          /* Build poly y array. Translate from graph coordinates to screen coordinates  */
+          if(gr->logy) yy = mylog10(yy);
+          point[poly_npoints].y = (short)CLIP(S_Y(yy), -30000, 30000);
+        }
+        poly_npoints++;
       }
-      poly_npoints++;
     }
     set_thick_waves(1, wcnt, wave_col, gr);
     for(x = 0; x < 2; x++) {
@@ -2834,6 +2963,8 @@ void setup_graph_data(int i, int skip, Graph_ctx *gr)
   gr->logx = gr->logy = 0;
   gr->digital = 0;
   gr->rainbow = 0;
+  gr->envelope = 0;
+  gr->envelope_sigma = 0.0;
   gr->linewidth_mult = tclgetdoublevar("graph_linewidth_mult");
 
   if(!skip) {
@@ -2909,6 +3040,10 @@ void setup_graph_data(int i, int skip, Graph_ctx *gr)
   if(val[0]) gr->linewidth_mult = atof(val);
   val = get_tok_value(r->prop_ptr,"rainbow",0);
   if(val[0] == '1') gr->rainbow = 1;
+  val = get_tok_value(r->prop_ptr,"envelope",0);
+  if(val[0] == '1') gr->envelope = 1;
+  val = get_tok_value(r->prop_ptr,"envelope_sigma",0);
+  if(val[0]) gr->envelope_sigma = atof(val);
   val = get_tok_value(r->prop_ptr,"logx",0);
   if(val[0] == '1') gr->logx = 1;
   val = get_tok_value(r->prop_ptr,"logy",0);
@@ -3154,7 +3289,7 @@ static void draw_graph_variables(int wcnt, int wave_color, int n_nodes, int swee
 }
 
 static void show_node_measures(int measure_p, double measure_x, double measure_prev_x,
-       const char *bus_msb, int wave_color, int idx, SPICE_DATA **idx_arr,
+       const char *bus_msb, int wave_color, int idx, Raw_levels **lv_arr,
        int n_bits, int n_nodes, const char *ntok, int wcnt, Graph_ctx *gr)
 {
   char tmpstr[1024];
@@ -3194,9 +3329,12 @@ static void show_node_measures(int measure_p, double measure_x, double measure_p
     } else {
       double vthl, vthh;
       int hex_digits = ((n_bits - 1) >> 2) + 1;
+      char *bits = my_malloc(_ALLOC_ID_, n_bits * sizeof(char));
       vthh = gr->gy1 * 0.2 + gr->gy2 * 0.8;
       vthl = gr->gy1 * 0.8 + gr->gy2 * 0.2;
-      get_bus_value(n_bits, hex_digits, idx_arr, measure_p - 1, tmpstr, vthl, vthh);
+      get_bus_bits(n_bits, lv_arr, measure_p - 1, bits, vthl, vthh);
+      get_bus_value(n_bits, hex_digits, bits, tmpstr);
+      my_free(_ALLOC_ID_, &bits);
     }
     if(!bus_msb && !gr->digital) {
       draw_string(wave_color, NOW, tmpstr, 0, 0, 0, 0, 
@@ -3364,6 +3502,15 @@ int calc_custom_data_yrange(int sweep_idx, const char *express, Graph_ctx *gr)
     register SPICE_DATA *gv = raw->values[sweep_idx];
     SPICE_DATA *gv0 = raw->values[0]; /* spice sweep variable, used to determine wrap arounds */
     ofs_end = ofs + raw->npoints[dset];
+    /* monotonic sweep: calculate only visible points range */
+    if(visible_sweep_range(raw, sweep_idx, 1, ofs, ofs_end, start, end, gr->logx, &first, &last)) {
+      if(first <= last && (dataset == -1 || dataset == sweepvar_wrap)) {
+        idx = plot_raw_custom_data(sweep_idx, first, last, express, NULL);
+      }
+      ofs = ofs_end;
+      sweepvar_wrap++;
+      continue;
+    }
     first = -1;
     last = ofs; 
     for(p = ofs ; p < ofs_end; p++) {
@@ -3501,6 +3648,22 @@ int find_closest_wave(int i, Graph_ctx *gr)
          * p loop split repeated 2 timed (for x and y points) to preserve cache locality */
         last = ofs; 
         dbg(1, "find_closest_wave(): xval=%g yval=%g\n", xval, yval);
+        /* monotonic sweep: only point p with sweep(p - 1) <= xval < sweep(p) can be the closest */
+        if(visible_sweep_range(raw, sweep_idx, 1, ofs, ofs_end, xval, end, gr->logx, &first, &last)) {
+          p = first;
+          if(p < ofs_end && (gr->logx ? mylog10(gvx[p]) : gvx[p]) == xval) p++;
+          if(p > ofs && p < ofs_end) {
+            xx = gr->logx ? mylog10(gvx[p]) : gvx[p];
+            yy = gr->logy ? mylog10(gvy[p]) : gvy[p];
+            if(xx >= start && xx <= end && (min < 0.0 || fabs(yval - yy) < min)) {
+              min = fabs(yval - yy);
+              closest_dataset = sweepvar_wrap;
+            }
+          }
+          ofs = ofs_end;
+          sweepvar_wrap++;
+          continue;
+        }
         for(p = ofs ; p < ofs_end; p++) {
           if(gr->logx) xx = mylog10(gvx[p]);
           else xx = gvx[p];
@@ -3561,6 +3724,432 @@ int find_closest_wave(int i, Graph_ctx *gr)
 }
 
 
+/* envelope graphs: statistics of all datasets (and sweep wraps) of a variable or expression
+ * computed on graph x bins (one per pixel column), cached so redraws with unchanged
+ * x range and zoom do not scan data again */
+#define ENVELOPE_CACHE_SIZE 16
+#define ENVELOPE_MAX_BINS 8192
+
+typedef struct {
+  Raw *raw;
+  char *node; /* variable name or expression */
+  int sweep_idx, datasets, allow_wrap, logx, logy, nbins;
+  double start, end;
+  int *cnt; /* number of points in bin */
+  double *min, *max, *mean, *sigma;
+  int stamp; /* last use, for LRU replacement */
+} Graph_envelope;
+
+static Graph_envelope envelope_cache[ENVELOPE_CACHE_SIZE];
+static int envelope_stamp = 0;
+
+static void free_envelope(Graph_envelope *e)
+{
+  if(!e->node) return;
+  my_free(_ALLOC_ID_, &e->node);
+  my_free(_ALLOC_ID_, &e->cnt);
+  my_free(_ALLOC_ID_, &e->min);
+  my_free(_ALLOC_ID_, &e->max);
+  my_free(_ALLOC_ID_, &e->mean);
+  my_free(_ALLOC_ID_, &e->sigma);
+  e->raw = NULL;
+}
+
+/* forget envelopes computed from 'raw' (all if NULL). Called when raw data changes */
+void free_graph_envelopes(Raw *raw)
+{
+  int i;
+  for(i = 0; i < ENVELOPE_CACHE_SIZE; i++) {
+    if(raw && envelope_cache[i].raw != raw) continue;
+    free_envelope(&envelope_cache[i]);
+  }
+}
+
+/* add points [first, last] of y data column to envelope bins. mean/sigma hold sum/sum of squares */
+static void envelope_add_points(Graph_envelope *e, int sweep_idx, SPICE_DATA *gy, int first, int last)
+{
+  int p, b;
+  double xx, yy;
+  double scale = (e->nbins - 1) / (e->end - e->start);
+  SPICE_DATA *gx = xctx->raw->values[sweep_idx];
+
+  for(p = first; p <= last; p++) {
+    xx = e->logx ? mylog10(gx[p]) : gx[p];
+    yy = e->logy ? mylog10(gy[p]) : gy[p];
+    b = (int)((xx - e->start) * scale + 0.5);
+    if(b < 0) b = 0;
+    if(b >= e->nbins) b = e->nbins - 1;
+    if(e->cnt[b] == 0 || yy < e->min[b]) e->min[b] = yy;
+    if(e->cnt[b] == 0 || yy > e->max[b]) e->max[b] = yy;
+    e->mean[b] += yy;
+    e->sigma[b] += yy * yy;
+    e->cnt[b]++;
+  }
+}
+
+/* return envelope of variable 'idx' (or expression 'express' if not NULL) for graph x range
+ * [start, end] divided into 'nbins' bins, computing it in a single pass over all datasets
+ * if not cached. Returns NULL if expression can not be evaluated */
+static Graph_envelope *get_graph_envelope(int idx, const char *express, int sweep_idx, int allow_wrap,
+       int nbins, double start, double end, Graph_ctx *gr)
+{
+  int i, b, dset, p, ofs, ofs_end, first, last, cnt = 0, wrap = 0;
+  double xx = 0.0, xx0 = 0.0;
+  Graph_envelope *e = NULL, *lru = NULL;
+  Raw *raw = xctx->raw;
+  const char *node = express ? express : raw->names[idx];
+  SPICE_DATA *gv = raw->values[sweep_idx];
+  SPICE_DATA *gv0 = raw->values[0];
+  SPICE_DATA *gy;
+
+  for(i = 0; i < ENVELOPE_CACHE_SIZE; i++) {
+    e = &envelope_cache[i];
+    if(e->node && e->raw == raw && e->sweep_idx == sweep_idx && e->datasets == raw->datasets &&
+       e->allow_wrap == allow_wrap && e->logx == gr->logx && e->logy == gr->logy && e->nbins == nbins &&
+       e->start == start && e->end == end && !strcmp(e->node, node)) {
+      e->stamp = ++envelope_stamp;
+      return e;
+    }
+    if(!lru || !e->node || (lru->node && e->stamp < lru->stamp)) lru = e;
+  }
+  e = lru;
+  free_envelope(e);
+  e->cnt = my_calloc(_ALLOC_ID_, nbins, sizeof(int));
+  e->min = my_calloc(_ALLOC_ID_, nbins, sizeof(double));
+  e->max = my_calloc(_ALLOC_ID_, nbins, sizeof(double));
+  e->mean = my_calloc(_ALLOC_ID_, nbins, sizeof(double));
+  e->sigma = my_calloc(_ALLOC_ID_, nbins, sizeof(double));
+  e->raw = raw;
+  my_strdup2(_ALLOC_ID_, &e->node, node);
+  e->sweep_idx = sweep_idx;
+  e->datasets = raw->datasets;
+  e->allow_wrap = allow_wrap;
+  e->nbins = nbins;
+  e->start = start;
+  e->end = end;
+  e->logx = gr->logx;
+  e->logy = gr->logy;
+  /* find visible runs of points of each dataset (split at sweep wraps) and add them to bins */
+  ofs = 0;
+  for(dset = 0 ; dset < raw->datasets; dset++) {
+    ofs_end = ofs + raw->npoints[dset];
+    if(visible_sweep_range(raw, sweep_idx, allow_wrap, ofs, ofs_end, start, end, gr->logx, &first, &last)) {
+      p = ofs_end; /* single run */
+    } else {
+      p = ofs;
+      first = -1;
+      last = ofs;
+      cnt = 0;
+      xx0 = gv0[ofs];
+    }
+    for(; p <= ofs_end; p++) {
+      if(p < ofs_end) {
+        xx = gr->logx ? mylog10(gv[p]) : gv[p];
+        wrap = allow_wrap && cnt > 1 && gv0[p] == xx0;
+      }
+      if(first != -1 && first <= last && (p == ofs_end || xx > end || xx < start || wrap)) {
+        gy = raw->values[idx];
+        if(express) {
+          if(plot_raw_custom_data(sweep_idx, first, last, express, NULL) == -1) {
+            free_envelope(e);
+            return NULL;
+          }
+          gy = raw->values[raw->nvars];
+        }
+        envelope_add_points(e, sweep_idx, gy, first, last);
+        first = -1;
+      }
+      if(p == ofs_end) break;
+      if(wrap) cnt = 0;
+      if(xx >= start && xx <= end) {
+        if(first == -1) first = p;
+        last = p;
+        ++cnt;
+      }
+    }
+    ofs = ofs_end;
+  }
+  for(b = 0; b < nbins; b++) {
+    if(e->cnt[b] == 0) continue;
+    e->mean[b] /= e->cnt[b];
+    e->sigma[b] = e->sigma[b] / e->cnt[b] - e->mean[b] * e->mean[b];
+    e->sigma[b] = e->sigma[b] > 0.0 ? sqrt(e->sigma[b]) : 0.0;
+  }
+  e->stamp = ++envelope_stamp;
+  return e;
+}
+
+static void draw_envelope_lines(XPoint *point, int npoints, int wave_col, void *ct)
+{
+  int x, offset, size;
+  Drawable  w;
+  if(npoints < 2) return;
+  for(x = 0; x < 2; x++) {
+    if(x == 0 && xctx->draw_window) w = xctx->window;
+    else if(x == 1 && xctx->draw_pixmap) w = xctx->save_pixmap;
+    else continue;
+    for(offset = 0; ; offset += MAX_POLY_POINTS - 1) {
+      size = npoints - offset;
+      if(size > MAX_POLY_POINTS) size = MAX_POLY_POINTS;
+      XDrawLines(display, w, xctx->gc[wave_col], point + offset, size, CoordModeOrigin);
+      if(offset + size >= npoints) break;
+    }
+  }
+  #if !defined(__unix__) && HAS_CAIRO==1
+  check_cairo_drawpoints(ct, wave_col, point, npoints);
+  #endif
+}
+
+/* draw envelope of all datasets of variable 'idx' (or expression 'express' if not NULL):
+ * filled min/max band, mean line and, if graph 'envelope_sigma' attribute is set to N,
+ * mean +/- N * sigma lines */
+static void draw_graph_envelope(int idx, const char *express, int sweep_idx, int allow_wrap,
+       int wave_col, int wcnt, Graph_ctx *gr, void *ct)
+{
+  int b, b0, j, k, n, nbins;
+  double start = (gr->gx1 <= gr->gx2) ? gr->gx1 : gr->gx2;
+  double end = (gr->gx1 <= gr->gx2) ? gr->gx2 : gr->gx1;
+  double yy;
+  Graph_envelope *e;
+  XPoint *point, *band;
+
+  nbins = (int)fabs(S_X(end) - S_X(start)) + 1;
+  if(nbins < 2) nbins = 2;
+  if(nbins > ENVELOPE_MAX_BINS) nbins = ENVELOPE_MAX_BINS;
+  e = get_graph_envelope(idx, express, sweep_idx, allow_wrap, nbins, start, end, gr);
+  if(!e) return;
+  dbg(1, "draw_graph_envelope(): node=%s, nbins=%d\n", e->node, nbins);
+  point = my_malloc(_ALLOC_ID_, nbins * sizeof(XPoint));
+  band = my_malloc(_ALLOC_ID_, 2 * nbins * sizeof(XPoint));
+  XSetLineAttributes(display, xctx->gc[wave_col],
+    XLINEWIDTH(gr->linewidth_mult * xctx->lw), LineSolid, LINECAP , LINEJOIN);
+  /* process runs [b0, b) of non empty bins */
+  for(b0 = 0; b0 < nbins; b0 = b) {
+    for(; b0 < nbins && e->cnt[b0] == 0; b0++);
+    for(b = b0; b < nbins && e->cnt[b]; b++);
+    n = b - b0;
+    if(n == 0) break;
+    for(j = 0; j < n; j++) {
+      point[j].x = (short)CLIP(S_X(start + (b0 + j) * (end - start) / (nbins - 1)), -30000, 30000);
+    }
+    /* min/max band: max values left to right, min values right to left */
+    if(xctx->fill_pattern && n > 1) {
+      for(j = 0; j < n; j++) {
+        band[j].x = band[2 * n - 1 - j].x = point[j].x;
+        band[j].y = (short)CLIP(S_Y(e->max[b0 + j]), -30000, 30000);
+        band[2 * n - 1 - j].y = (short)CLIP(S_Y(e->min[b0 + j]), -30000, 30000);
+      }
+      if(xctx->draw_window)
+        XFillPolygon(display, xctx->window, xctx->gcstipple[wave_col], band, 2 * n, Polygontype, CoordModeOrigin);
+      if(xctx->draw_pixmap)
+        XFillPolygon(display, xctx->save_pixmap, xctx->gcstipple[wave_col], band, 2 * n, Polygontype, CoordModeOrigin);
+    }
+    /* k: 0: max, 1: min, 2: mean, 3: mean + N * sigma, 4: mean - N * sigma */
+    for(k = 0; k < 5; k++) {
+      if(k >= 3 && gr->envelope_sigma <= 0.0) break;
+      for(j = 0; j < n; j++) {
+        if(k == 0) yy = e->max[b0 + j];
+        else if(k == 1) yy = e->min[b0 + j];
+        else if(k == 2) yy = e->mean[b0 + j];
+        else if(k == 3) yy = e->mean[b0 + j] + gr->envelope_sigma * e->sigma[b0 + j];
+        else yy = e->mean[b0 + j] - gr->envelope_sigma * e->sigma[b0 + j];
+        point[j].y = (short)CLIP(S_Y(yy), -30000, 30000);
+      }
+      if(k == 2) set_thick_waves(1, wcnt, wave_col, gr);
+      draw_envelope_lines(point, n, wave_col, ct);
+      if(k == 2) set_thick_waves(0, wcnt, wave_col, gr);
+    }
+  }
+  XSetLineAttributes(display, xctx->gc[wave_col], XLINEWIDTH(xctx->lw), LineSolid, LINECAP , LINEJOIN);
+  my_free(_ALLOC_ID_, &point);
+  my_free(_ALLOC_ID_, &band);
+}
+
+static Graph_cache *get_graph_cache(int i)
+{
+  if(i >= xctx->graph_caches) {
+    my_realloc(_ALLOC_ID_, &xctx->graph_cache, (i + 1) * sizeof(Graph_cache));
+    memset(xctx->graph_cache + xctx->graph_caches, 0, (i + 1 - xctx->graph_caches) * sizeof(Graph_cache));
+    xctx->graph_caches = i + 1;
+  }
+  return &xctx->graph_cache[i];
+}
+
+static void clear_graph_meas(Graph_cache *gc)
+{
+  int k;
+  for(k = 0; k < gc->nmeas; k++) my_free(_ALLOC_ID_, &gc->meas[k].ntok);
+  gc->nmeas = 0;
+}
+
+/* free cached graph contents of all graphs */
+void free_graph_cache(void)
+{
+  int i;
+  Graph_cache *gc;
+  for(i = 0; i < xctx->graph_caches; i++) {
+    gc = &xctx->graph_cache[i];
+    #ifdef __unix__
+    if(gc->pixmap) XFreePixmap(display, gc->pixmap);
+    #endif
+    clear_graph_meas(gc);
+    my_free(_ALLOC_ID_, &gc->meas);
+    my_free(_ALLOC_ID_, &gc->prop);
+  }
+  my_free(_ALLOC_ID_, &xctx->graph_cache);
+  xctx->graph_caches = 0;
+}
+
+/* screen area of graph container clipped to window, return 0 if empty */
+static int graph_cache_area(Graph_ctx *gr, int *x, int *y, int *w, int *h)
+{
+  int x2, y2;
+  *x = (int)floor(X_TO_SCREEN(gr->rx1));
+  *y = (int)floor(Y_TO_SCREEN(gr->ry1));
+  x2 = (int)ceil(X_TO_SCREEN(gr->rx2)) + 1;
+  y2 = (int)ceil(Y_TO_SCREEN(gr->ry2)) + 1;
+  if(*x < 0) *x = 0;
+  if(*y < 0) *y = 0;
+  if(x2 > xctx->xrect[0].width) x2 = xctx->xrect[0].width;
+  if(y2 > xctx->xrect[0].height) y2 = xctx->xrect[0].height;
+  *w = x2 - *x;
+  *h = y2 - *y;
+  return *w > 0 && *h > 0;
+}
+
+/* record node showing value at cursor1, drawn after graph contents are cached */
+static void add_graph_meas(Graph_cache *gc, const char *ntok, int bus, int idx, int sweep_idx,
+       int dataset, int wave_color, int wcnt, int n_nodes,
+       int measure_p, double measure_x, double measure_prev_x)
+{
+  Graph_meas *m;
+  if((gc->nmeas & 15) == 0) my_realloc(_ALLOC_ID_, &gc->meas, (gc->nmeas + 16) * sizeof(Graph_meas));
+  m = &gc->meas[gc->nmeas++];
+  m->ntok = NULL;
+  my_strdup2(_ALLOC_ID_, &m->ntok, ntok);
+  m->bus = bus;
+  m->idx = idx;
+  m->sweep_idx = sweep_idx;
+  m->dataset = dataset;
+  m->wave_color = wave_color;
+  m->wcnt = wcnt;
+  m->n_nodes = n_nodes;
+  m->measure_p = measure_p;
+  m->measure_x = measure_x;
+  m->measure_prev_x = measure_prev_x;
+}
+
+/* find point where sweep variable crosses cursor1 as done when drawing waves in draw_graph(),
+ * using a binary search. Return 0 if sweep variable is not monotonic in all datasets */
+static int graph_measure_point(Graph_meas *m, Graph_ctx *gr)
+{
+  Raw *raw = xctx->raw;
+  int dset, ofs = 0, ofs_end, a, b, lo, hi, mid;
+  double start = (gr->gx1 <= gr->gx2) ? gr->gx1 : gr->gx2;
+  double end = (gr->gx1 <= gr->gx2) ? gr->gx2 : gr->gx1;
+  double cursor1 = gr->logx ? mylog10(xctx->graph_cursor1_x) : xctx->graph_cursor1_x;
+  SPICE_DATA *gv;
+
+  m->measure_p = -1;
+  if(!get_raw_column(raw, m->idx) || !(gv = get_raw_column(raw, m->sweep_idx))) return 0;
+  for(dset = 0; dset < raw->datasets; dset++) {
+    ofs_end = ofs + raw->npoints[dset];
+    if(ofs_end - ofs >= 2 && (m->dataset == -1 || m->dataset == dset)) {
+      if(!visible_sweep_range(raw, m->sweep_idx, 1, ofs, ofs_end, start, end, gr->logx, &a, &b)) return 0;
+      /* first visible point with sweep value >= cursor1, must follow another visible point */
+      lo = a; hi = b + 1;
+      while(lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if((gr->logx ? mylog10(gv[mid]) : gv[mid]) < cursor1) lo = mid + 1;
+        else hi = mid;
+      }
+      if(lo > a && lo <= b) {
+        m->measure_p = lo;
+        m->measure_x = gr->logx ? mylog10(gv[lo]) : gv[lo];
+        m->measure_prev_x = gr->logx ? mylog10(gv[lo - 1]) : gv[lo - 1];
+        return 1;
+      }
+    }
+    ofs = ofs_end;
+  }
+  return 1;
+}
+
+/* draw recorded cursor1 node values */
+static void draw_graph_meas(Graph_cache *gc, Graph_ctx *gr)
+{
+  int k, n_bits = 1;
+  Graph_meas *m;
+  Raw_levels **lv_arr;
+
+  for(k = 0; k < gc->nmeas; k++) {
+    m = &gc->meas[k];
+    if(m->measure_p == -1) continue;
+    lv_arr = NULL;
+    if(m->bus) lv_arr = get_bus_levels(m->ntok, &n_bits, gr->gy1 * 0.8 + gr->gy2 * 0.2,
+                                       gr->gy1 * 0.2 + gr->gy2 * 0.8);
+    show_node_measures(m->measure_p, m->measure_x, m->measure_prev_x, m->bus ? m->ntok : NULL,
+       m->wave_color, m->idx, lv_arr, n_bits, m->n_nodes, m->ntok, m->wcnt, gr);
+    if(lv_arr) my_free(_ALLOC_ID_, &lv_arr);
+  }
+}
+
+/* save graph contents drawn so far (no cursors) to graph cache */
+static void graph_cache_save(int i, int flags, Graph_ctx *gr, void *ct)
+{
+  Graph_cache *gc = get_graph_cache(i);
+  int x, y, w, h;
+
+  my_free(_ALLOC_ID_, &gc->prop);
+  #ifdef __unix__
+  if(ct || !xctx->draw_pixmap || !xctx->save_pixmap || !graph_cache_area(gr, &x, &y, &w, &h)) return;
+  if(gc->pixmap && (gc->w != w || gc->h != h)) {
+    XFreePixmap(display, gc->pixmap);
+    gc->pixmap = 0;
+  }
+  if(!gc->pixmap) gc->pixmap = XCreatePixmap(display, xctx->window, w, h, screendepth);
+  #if HAS_CAIRO==1
+  cairo_surface_flush(xctx->cairo_save_sfc);
+  #endif
+  XCopyArea(display, xctx->save_pixmap, gc->pixmap, xctx->gc[0], x, y, w, h, 0, 0);
+  gc->x = x;
+  gc->y = y;
+  gc->w = w;
+  gc->h = h;
+  my_strdup2(_ALLOC_ID_, &gc->prop, xctx->rect[GRIDLAYER][i].prop_ptr);
+  gc->raw = xctx->raw;
+  gc->raw_stamp = get_raw_stamp();
+  gc->flags = flags & 6;
+  #endif
+}
+
+/* restore cached graph contents if still valid, updating cursor1 node values.
+ * Return 0 if graph must be fully redrawn */
+static int graph_cache_restore(int i, int flags, Graph_ctx *gr)
+{
+  Graph_cache *gc;
+  int k, x, y, w, h;
+
+  if(i >= xctx->graph_caches) return 0;
+  gc = &xctx->graph_cache[i];
+  if(!gc->prop || !xctx->draw_pixmap || !xctx->save_pixmap) return 0;
+  if(strcmp(gc->prop, xctx->rect[GRIDLAYER][i].prop_ptr ? xctx->rect[GRIDLAYER][i].prop_ptr : "")) return 0;
+  if(gc->raw != xctx->raw || gc->raw_stamp != get_raw_stamp() || gc->flags != (flags & 6)) return 0;
+  if(!graph_cache_area(gr, &x, &y, &w, &h) || x != gc->x || y != gc->y || w != gc->w || h != gc->h) return 0;
+  if(flags & 2) {
+    if(!gc->measure_ok) return 0;
+    for(k = 0; k < gc->nmeas; k++) {
+      if(!graph_measure_point(&gc->meas[k], gr)) return 0;
+    }
+  }
+  XCopyArea(display, gc->pixmap, xctx->save_pixmap, xctx->gc[0], 0, 0, w, h, x, y);
+  if(xctx->draw_window) XCopyArea(display, gc->pixmap, xctx->window, xctx->gc[0], 0, 0, w, h, x, y);
+  #if HAS_CAIRO==1
+  cairo_surface_mark_dirty_rectangle(xctx->cairo_save_sfc, x, y, w, h);
+  #endif
+  return 1;
+}
+
 /* flags:
  * 1: do final XCopyArea (copy 2nd buffer areas to screen) 
  *    If draw_graph_all() is called from draw() no need to do XCopyArea, as draw() does it already.
@@ -3568,6 +4157,8 @@ int find_closest_wave(int i, Graph_ctx *gr)
  * 2: draw x-cursor1
  * 4: draw x-cursor2
  * 8: all drawing, if not set do only XCopyArea / x-cursor if specified
+ * 16: cursors moved: restore cached graph contents and draw only cursors and cursor1 node values.
+ *     Do all drawing (8) if cache is not valid
  * ct is a pointer used in windows for cairo
  */
 void draw_graph(int i, const int flags, Graph_ctx *gr, void *ct)
@@ -3591,10 +4182,20 @@ void draw_graph(int i, const int flags, Graph_ctx *gr, void *ct)
   char *custom_rawfile = NULL; /* "rawfile" attr. set in graph: load and switch to specified raw */
   char *sim_type = NULL;
   int save_extra_idx = -1;
+  Raw *loaded_raw = NULL; /* raw file where graph variables have been loaded (raw_mmap) */
+  Raw *graph_raw = xctx->raw; /* raw file active when graph drawing starts */
+  Graph_cache *gc = NULL;
   
   if(xctx->only_probes) return;
   if(RECT_OUTSIDE( gr->sx1, gr->sy1, gr->sx2, gr->sy2,
       xctx->areax1, xctx->areay1, xctx->areax2, xctx->areay2)) return;
+  if(flags & 16) {
+    if(!graph_cache_restore(i, flags, gr)) {
+      draw_graph(i, (flags & ~16) | 8, gr, ct);
+      return;
+    }
+    if(flags & 2) draw_graph_meas(get_graph_cache(i), gr);
+  }
   
   #if 0
   dbg(0, "draw_graph(): window: %d %d %d %d\n", xctx->areax1, xctx->areay1, xctx->areax2, xctx->areay2);
@@ -3615,6 +4216,9 @@ void draw_graph(int i, const int flags, Graph_ctx *gr, void *ct)
     #endif
     autoload = !strboolcmp(get_tok_value(r->prop_ptr,"autoload",0), "1");
     if(autoload == 0) autoload = 2; 
+    gc = get_graph_cache(i);
+    clear_graph_meas(gc);
+    gc->measure_ok = 1;
     /* graph box, gridlines and axes */
     draw_graph_grid(gr, ct);
     /* get data to plot */
@@ -3689,6 +4293,12 @@ void draw_graph(int i, const int flags, Graph_ctx *gr, void *ct)
         my_strdup(_ALLOC_ID_, &ntok_copy, ntok);
       }
 
+      /* if raw file is mapped load all graph data columns in one pass */
+      if(raw && raw != loaded_raw) {
+        raw_load_columns(raw, node);
+        raw_load_columns(raw, sweep);
+        loaded_raw = raw;
+      }
       /* transform multiple OP points into a dc sweep */
       if(raw && raw->sim_type && !strcmp(raw->sim_type, "op") && raw->datasets > 1 && raw->npoints[0] == 1) {
         save_datasets = raw->datasets;
@@ -3753,40 +4363,93 @@ void draw_graph(int i, const int flags, Graph_ctx *gr, void *ct)
         double start;
         double end;
         int n_bits = 1; 
-        SPICE_DATA **idx_arr = NULL;
+        Raw_levels **lv_arr = NULL;
         int sweepvar_wrap = 0; /* incremented on new dataset or sweep variable wrap */
         XPoint *point = NULL;
         int dataset = node_dataset >=0 ? node_dataset : gr->dataset;
         int digital = gr->digital;
+        int envelope;
         ofs = 0;
         start = (gr->gx1 <= gr->gx2) ? gr->gx1 : gr->gx2;
         end = (gr->gx1 <= gr->gx2) ? gr->gx2 : gr->gx1;
         if(bus_msb) {
-          idx_arr = get_bus_idx_array(ntok_copy, &n_bits); /* idx_arr allocated by function, must free! */
+          /* lv_arr allocated by function, must free! */
+          lv_arr = get_bus_levels(ntok_copy, &n_bits, gr->gy1 * 0.8 + gr->gy2 * 0.2, gr->gy1 * 0.2 + gr->gy2 * 0.8);
         }
         bbox(START, 0.0, 0.0, 0.0, 0.0);
         bbox(ADD,gr->x1, gr->y1, gr->x2, gr->y2);
         bbox(SET, 0.0, 0.0, 0.0, 0.0);
+        /* envelope graph: draw statistics of all datasets instead of each dataset */
+        envelope = gr->envelope && !bus_msb && !digital && dataset == -1;
+        if(envelope) {
+          draw_graph_envelope(idx, expression ? express : NULL, sweep_idx, allow_wrap, wc, wcnt, gr, ct);
+        }
         /* loop through all datasets found in raw file */
 
-        for(dset = 0 ; dset < raw->datasets; dset++) {
+        for(dset = 0 ; !envelope && dset < raw->datasets; dset++) {
           double prev_x;
           int cnt=0, wrap;
+          int pstart, pend; /* range of points to process */
+          int monotonic, ncols;
+          double sx1 = S_X(start), sx2 = S_X(end);
           register SPICE_DATA *gv = raw->values[sweep_idx];
           SPICE_DATA *gv0 = raw->values[0]; /* spice sweep variable, used to determine wrap arounds */
             
           ofs_end = ofs + raw->npoints[dset];
           first = -1;
           poly_npoints = 0;
-          my_realloc(_ALLOC_ID_, &point, raw->npoints[dset] * sizeof(XPoint));
+          /* monotonic sweep (no wraps): process only points in visible range */
+          monotonic = visible_sweep_range(raw, sweep_idx, allow_wrap, ofs, ofs_end, start, end, gr->logx,
+                                          &pstart, &pend);
+          if(monotonic) {
+            pend++;
+          } else {
+            pstart = ofs;
+            pend = ofs_end;
+          }
+          /* monotonic sweep with 2 or more points per pixel column: find columns by binary search
+           * and draw them reduced to at most 4 points, so time depends on graph width only */
+          ncols = (int)fabs(sx2 - sx1) + 2; /* pixel columns in visible range */
+          if(monotonic && !bus_msb && pend - pstart > 2 * ncols &&
+             sx1 >= -32768.0 && sx1 <= 32767.0 && sx2 >= -32768.0 && sx2 <= 32767.0) {
+            if(dataset == -1 || dataset == sweepvar_wrap) {
+              first = pstart;
+              last = pend - 1;
+              if(flags & 2 && measure_p == -1) {
+                double cursor1 = xctx->graph_cursor1_x;
+                int lo = first + 1, hi = pend, mid;
+                if(gr->logx) cursor1 = mylog10(cursor1);
+                /* cursor1 is between the first point with sweep value >= cursor1 and previous one */
+                while(lo < hi) {
+                  mid = lo + (hi - lo) / 2;
+                  if((gr->logx ? mylog10(gv[mid]) : gv[mid]) < cursor1) lo = mid + 1;
+                  else hi = mid;
+                }
+                if(lo <= last && (gr->logx ? mylog10(gv[first]) : gv[first]) < cursor1) {
+                  measure_p = lo;
+                  measure_x = gr->logx ? mylog10(gv[lo]) : gv[lo];
+                  measure_prev_x = gr->logx ? mylog10(gv[lo - 1]) : gv[lo - 1];
+                }
+              }
+              if(gr->rainbow) wave_color = 4 + (wc - 4 + sweepvar_wrap) % (cadlayers - 4);
+              else wave_color = wc;
+              my_realloc(_ALLOC_ID_, &point, 4 * ncols * sizeof(XPoint));
+              if(expression) idx = plot_raw_custom_data(sweep_idx, first, last, express, NULL);
+              draw_graph_points(idx, first, last, sweep_idx, point, wave_color, wcnt, n_nodes, gr, ct);
+            }
+            ofs = ofs_end;
+            sweepvar_wrap++;
+            continue;
+          }
+          if(pend > pstart) my_realloc(_ALLOC_ID_, &point, (pend - pstart) * sizeof(XPoint));
           /* Process "npoints" simulation items 
            * p loop split repeated 2 timed (for x and y points) to preserve cache locality */
           prev_x = 0;
           last = ofs; 
-          for(p = ofs ; p < ofs_end; p++) {
+          xx0 = gv0[ofs];
+          for(p = pstart ; p < pend; p++) {
             if(gr->logx) xx = mylog10(gv[p]);
             else  xx = gv[p];
-            if(p == ofs) xx0 = gv0[p];
             wrap = allow_wrap && (cnt > 1 && gv0[p] == xx0);
             dbg(1, "draw_graph(): wrap=%d, xx=%g, xx0=%g, p=%d\n", wrap, xx, xx0, p);
             if(first != -1) {                      /* there is something to plot ... */
@@ -3798,12 +4461,12 @@ void draw_graph(int i, const int flags, Graph_ctx *gr, void *ct)
                   else wave_color = wc;
                   if(bus_msb) {
                     if(digital) {
-                      draw_graph_bus_points(ntok_copy, n_bits, idx_arr, first, last, wave_color,
+                      draw_graph_bus_points(ntok_copy, n_bits, lv_arr, first, last, wave_color,
                                    sweep_idx, wcnt, n_nodes, gr, ct);
                     }
                   } else {
                     if(expression) idx = plot_raw_custom_data(sweep_idx, first, last, express, NULL);
-                    draw_graph_points(idx, first, last, point, wave_color, wcnt, n_nodes, gr, ct);
+                    draw_graph_points(idx, first, last, -1, point, wave_color, wcnt, n_nodes, gr, ct);
                   }
                 }
                 poly_npoints = 0;
@@ -3843,12 +4506,12 @@ void draw_graph(int i, const int flags, Graph_ctx *gr, void *ct)
               else wave_color = wc;
               if(bus_msb) {
                 if(digital) {
-                  draw_graph_bus_points(ntok_copy, n_bits, idx_arr, first, last, wave_color,
+                  draw_graph_bus_points(ntok_copy, n_bits, lv_arr, first, last, wave_color,
                                sweep_idx, wcnt, n_nodes, gr, ct);
                 }
               } else {
                 if(expression) idx = plot_raw_custom_data(sweep_idx, first, last, express, NULL);
-                draw_graph_points(idx, first, last, point, wave_color, wcnt, n_nodes, gr, ct);
+                draw_graph_points(idx, first, last, -1, point, wave_color, wcnt, n_nodes, gr, ct);
               }
             }
           }
@@ -3857,12 +4520,21 @@ void draw_graph(int i, const int flags, Graph_ctx *gr, void *ct)
           sweepvar_wrap++;
         } /* for(dset...) */
         bbox(END, 0.0, 0.0, 0.0, 0.0);
-        if(flags & 2 && measure_p != -1)
-           show_node_measures(measure_p, measure_x, measure_prev_x, bus_msb, wave_color, 
-              idx, idx_arr, n_bits, n_nodes, ntok_copy, wcnt, gr);
+        if(flags & 2) {
+          if(!expression && raw == graph_raw && save_npoints == -1) {
+            /* drawn after caching graph contents, so moving cursors does not redraw waves */
+            add_graph_meas(gc, ntok_copy, bus_msb != NULL, idx, sweep_idx, dataset, wave_color,
+               wcnt, n_nodes, measure_p, measure_x, measure_prev_x);
+          } else {
+            /* expression data or data from other raw files is not kept after drawing */
+            gc->measure_ok = 0;
+            if(measure_p != -1) show_node_measures(measure_p, measure_x, measure_prev_x, bus_msb,
+               wave_color, idx, lv_arr, n_bits, n_nodes, ntok_copy, wcnt, gr);
+          }
+        }
 
         my_free(_ALLOC_ID_, &point);
-        if(idx_arr) my_free(_ALLOC_ID_, &idx_arr);
+        if(lv_arr) my_free(_ALLOC_ID_, &lv_arr);
       } /* if( expression || (idx = get_raw_index(bus_msb ? bus_msb : express, NULL)) != -1 ) */
       ++wcnt;
       if(bus_msb) my_free(_ALLOC_ID_, &bus_msb);
@@ -3885,13 +4557,17 @@ void draw_graph(int i, const int flags, Graph_ctx *gr, void *ct)
     my_free(_ALLOC_ID_, &node);
     my_free(_ALLOC_ID_, &color);
     my_free(_ALLOC_ID_, &sweep);
+    if(xctx->raw == graph_raw) {
+      graph_cache_save(i, flags, gr, ct);
+      if(flags & 2) draw_graph_meas(gc, gr);
+    } else my_free(_ALLOC_ID_, &gc->prop); /* invalidate cache */
   } /* if(flags & 8) */
   /* 
    * bbox(START, 0.0, 0.0, 0.0, 0.0);
    * bbox(ADD, gr->rx1, gr->ry1, gr->rx2, gr->ry2);
    * bbox(SET_INSIDE, 0.0, 0.0, 0.0, 0.0);
    */
-  if(flags & 8) {
+  if(flags & (8 | 16)) {
     double cursor1 = xctx->graph_cursor1_x;
     double cursor2 = xctx->graph_cursor2_x;
     /* cursor1 */
@@ -3952,6 +4628,8 @@ static void draw_graph_all(int flags)
     cairo_set_font_face(xctx->cairo_save_ctx, xctx->cairo_font);
     cairo_font_face_destroy(xctx->cairo_font);
     #endif
+    /* free least recently used raw file data (raw_max_columns, raw_memory_budget) */
+    if(sch_loaded) raw_trim_memory();
     if(xctx->draw_single_layer==-1 || GRIDLAYER == xctx->draw_single_layer) {
       if(xctx->enable_layer[GRIDLAYER]) for(i = 0; i < xctx->rects[GRIDLAYER]; ++i) {
         xRect *r = &xctx->rect[GRIDLAYER][i];
@@ -22,109 +22,109 @@
 
 #include "xschem.h"
 
-static void free_undo_lines(int slot)
+static void free_undo_lines(Undo_slot *u)
 {
   int i, c;
 
   for(c = 0;c<cadlayers; ++c) {
-    for(i = 0;i<xctx->uslot[slot].lines[c]; ++i) {
-      my_free(_ALLOC_ID_, &xctx->uslot[slot].lptr[c][i].prop_ptr);
+    for(i = 0;i<u->lines[c]; ++i) {
+      my_free(_ALLOC_ID_, &u->lptr[c][i].prop_ptr);
     }
-    my_free(_ALLOC_ID_, &xctx->uslot[slot].lptr[c]);
-    xctx->uslot[slot].lines[c] = 0;
+    my_free(_ALLOC_ID_, &u->lptr[c]);
+    u->lines[c] = 0;
   }
 }
 
-static void free_undo_rects(int slot)
+static void free_undo_rects(Undo_slot *u)
 {
   int i, c;
 
   for(c = 0;c<cadlayers; ++c) {
-    for(i = 0;i<xctx->uslot[slot].rects[c]; ++i) {
-      my_free(_ALLOC_ID_, &xctx->uslot[slot].bptr[c][i].prop_ptr);
+    for(i = 0;i<u->rects[c]; ++i) {
+      my_free(_ALLOC_ID_, &u->bptr[c][i].prop_ptr);
     }
-    my_free(_ALLOC_ID_, &xctx->uslot[slot].bptr[c]);
-    xctx->uslot[slot].rects[c] = 0;
+    my_free(_ALLOC_ID_, &u->bptr[c]);
+    u->rects[c] = 0;
   }
 }
 
-static void free_undo_polygons(int slot)
+static void free_undo_polygons(Undo_slot *u)
 {
   int i, c;
 
   for(c = 0;c<cadlayers; ++c) {
-    for(i = 0;i<xctx->uslot[slot].polygons[c]; ++i) {
-      my_free(_ALLOC_ID_, &xctx->uslot[slot].pptr[c][i].prop_ptr);
-      my_free(_ALLOC_ID_, &xctx->uslot[slot].pptr[c][i].x);
-      my_free(_ALLOC_ID_, &xctx->uslot[slot].pptr[c][i].y);
-      my_free(_ALLOC_ID_, &xctx->uslot[slot].pptr[c][i].selected_point);
+    for(i = 0;i<u->polygons[c]; ++i) {
+      my_free(_ALLOC_ID_, &u->pptr[c][i].prop_ptr);
+      my_free(_ALLOC_ID_, &u->pptr[c][i].x);
+      my_free(_ALLOC_ID_, &u->pptr[c][i].y);
+      my_free(_ALLOC_ID_, &u->pptr[c][i].selected_point);
     }
-    my_free(_ALLOC_ID_, &xctx->uslot[slot].pptr[c]);
-    xctx->uslot[slot].polygons[c] = 0;
+    my_free(_ALLOC_ID_, &u->pptr[c]);
+    u->polygons[c] = 0;
   }
 }
 
-static void free_undo_arcs(int slot)
+static void free_undo_arcs(Undo_slot *u)
 {
   int i, c;
 
   for(c = 0;c<cadlayers; ++c) {
-    for(i = 0;i<xctx->uslot[slot].arcs[c]; ++i) {
-      my_free(_ALLOC_ID_, &xctx->uslot[slot].aptr[c][i].prop_ptr);
+    for(i = 0;i<u->arcs[c]; ++i) {
+      my_free(_ALLOC_ID_, &u->aptr[c][i].prop_ptr);
     }
-    my_free(_ALLOC_ID_, &xctx->uslot[slot].aptr[c]);
-    xctx->uslot[slot].arcs[c] = 0;
+    my_free(_ALLOC_ID_, &u->aptr[c]);
+    u->arcs[c] = 0;
   }
 }
 
-static void free_undo_wires(int slot)
+static void free_undo_wires(Undo_slot *u)
 {
   int i;
 
-  for(i = 0;i<xctx->uslot[slot].wires; ++i) {
-    my_free(_ALLOC_ID_, &xctx->uslot[slot].wptr[i].prop_ptr);
+  for(i = 0;i<u->wires; ++i) {
+    my_free(_ALLOC_ID_, &u->wptr[i].prop_ptr);
   }
-  my_free(_ALLOC_ID_, &xctx->uslot[slot].wptr);
-  xctx->uslot[slot].wires = 0;
+  my_free(_ALLOC_ID_, &u->wptr);
+  u->wires = 0;
 }
 
-static void free_undo_texts(int slot)
+static void free_undo_texts(Undo_slot *u)
 {
   int i;
 
-  for(i = 0;i<xctx->uslot[slot].texts; ++i) {
-    my_free(_ALLOC_ID_, &xctx->uslot[slot].tptr[i].prop_ptr);
-    my_free(_ALLOC_ID_, &xctx->uslot[slot].tptr[i].txt_ptr);
-    my_free(_ALLOC_ID_, &xctx->uslot[slot].tptr[i].font);
-    my_free(_ALLOC_ID_, &xctx->uslot[slot].tptr[i].floater_instname);
-    my_free(_ALLOC_ID_, &xctx->uslot[slot].tptr[i].floater_ptr);
+  for(i = 0;i<u->texts; ++i) {
+    my_free(_ALLOC_ID_, &u->tptr[i].prop_ptr);
+    my_free(_ALLOC_ID_, &u->tptr[i].txt_ptr);
+    my_free(_ALLOC_ID_, &u->tptr[i].font);
+    my_free(_ALLOC_ID_, &u->tptr[i].floater_instname);
+    my_free(_ALLOC_ID_, &u->tptr[i].floater_ptr);
   }
-  my_free(_ALLOC_ID_, &xctx->uslot[slot].tptr);
-  xctx->uslot[slot].texts = 0;
+  my_free(_ALLOC_ID_, &u->tptr);
+  u->texts = 0;
 }
 
-static void free_undo_instances(int slot)
+static void free_undo_instances(Undo_slot *u)
 {
   int i;
 
-  for(i = 0;i<xctx->uslot[slot].instances; ++i) {
-    my_free(_ALLOC_ID_, &xctx->uslot[slot].iptr[i].name);
-    my_free(_ALLOC_ID_, &xctx->uslot[slot].iptr[i].prop_ptr);
-    my_free(_ALLOC_ID_, &xctx->uslot[slot].iptr[i].instname);
-    my_free(_ALLOC_ID_, &xctx->uslot[slot].iptr[i].lab);
+  for(i = 0;i<u->instances; ++i) {
+    my_free(_ALLOC_ID_, &u->iptr[i].name);
+    my_free(_ALLOC_ID_, &u->iptr[i].prop_ptr);
+    my_free(_ALLOC_ID_, &u->iptr[i].instname);
+    my_free(_ALLOC_ID_, &u->iptr[i].lab);
   }
-  my_free(_ALLOC_ID_, &xctx->uslot[slot].iptr);
-  xctx->uslot[slot].instances = 0;
+  my_free(_ALLOC_ID_, &u->iptr);
+  u->instances = 0;
 }
 
-static void free_undo_symbols(int slot)
+static void free_undo_symbols(Undo_slot *u)
 {
   int i, j, c, symbols;
   xSymbol *sym;
 
-  symbols = xctx->uslot[slot].symbols;
+  symbols = u->symbols;
   for(i = 0;i < symbols; ++i) {
-    sym = &xctx->uslot[slot].symptr[i];
+    sym = &u->symptr[i];
     my_free(_ALLOC_ID_, &sym->name);
     my_free(_ALLOC_ID_, &sym->prop_ptr);
     my_free(_ALLOC_ID_, &sym->type);
@@ -195,8 +195,254 @@ static void free_undo_symbols(int slot)
     my_free(_ALLOC_ID_, &sym->polygons);
     my_free(_ALLOC_ID_, &sym->arcs);
   }
-  my_free(_ALLOC_ID_, &xctx->uslot[slot].symptr);
-  xctx->uslot[slot].symbols = 0;
+  my_free(_ALLOC_ID_, &u->symptr);
+  u->symbols = 0;
+}
+
+static void free_undo_objects(Undo_slot *u)
+{
+  free_undo_lines(u);
+  free_undo_rects(u);
+  free_undo_polygons(u);
+  free_undo_arcs(u);
+  free_undo_wires(u);
+  free_undo_texts(u);
+  free_undo_instances(u);
+}
+
+static void init_undo_slot(Undo_slot *u)
+{
+  u->lines = my_calloc(_ALLOC_ID_, cadlayers, sizeof(int));
+  u->rects = my_calloc(_ALLOC_ID_, cadlayers, sizeof(int));
+  u->arcs = my_calloc(_ALLOC_ID_, cadlayers, sizeof(int));
+  u->polygons = my_calloc(_ALLOC_ID_, cadlayers, sizeof(int));
+  u->lptr = my_calloc(_ALLOC_ID_, cadlayers, sizeof(xLine *));
+  u->bptr = my_calloc(_ALLOC_ID_, cadlayers, sizeof(xRect *));
+  u->aptr = my_calloc(_ALLOC_ID_, cadlayers, sizeof(xArc *));
+  u->pptr = my_calloc(_ALLOC_ID_, cadlayers, sizeof(xPoly *));
+}
+
+static void delete_undo_slot(Undo_slot *u)
+{
+  my_free(_ALLOC_ID_, &u->lines);
+  my_free(_ALLOC_ID_, &u->rects);
+  my_free(_ALLOC_ID_, &u->arcs);
+  my_free(_ALLOC_ID_, &u->polygons);
+  my_free(_ALLOC_ID_, &u->lptr);
+  my_free(_ALLOC_ID_, &u->bptr);
+  my_free(_ALLOC_ID_, &u->aptr);
+  my_free(_ALLOC_ID_, &u->pptr);
+}
+
+/* copy schematic attributes and objects (not symbols) into u */
+static void save_undo_objects(Undo_slot *u)
+{
+  int i, c;
+
+  my_strdup(_ALLOC_ID_, &u->gptr, xctx->schvhdlprop);
+  my_strdup(_ALLOC_ID_, &u->vptr, xctx->schverilogprop);
+  my_strdup(_ALLOC_ID_, &u->sptr, xctx->schprop);
+  my_strdup(_ALLOC_ID_, &u->kptr, xctx->schsymbolprop);
+  my_strdup(_ALLOC_ID_, &u->eptr, xctx->schtedaxprop);
+
+  free_undo_objects(u);
+
+  memcpy(u->lines, xctx->lines, sizeof(xctx->lines[0]) * cadlayers);
+  memcpy(u->rects, xctx->rects, sizeof(xctx->rects[0]) * cadlayers);
+  memcpy(u->arcs, xctx->arcs, sizeof(xctx->arcs[0]) * cadlayers);
+  memcpy(u->polygons, xctx->polygons, sizeof(xctx->polygons[0]) * cadlayers);
+  for(c = 0;c<cadlayers; ++c) {
+    u->lptr[c] = my_calloc(_ALLOC_ID_, xctx->lines[c], sizeof(xLine));
+    u->bptr[c] = my_calloc(_ALLOC_ID_, xctx->rects[c], sizeof(xRect));
+    u->pptr[c] = my_calloc(_ALLOC_ID_, xctx->polygons[c], sizeof(xPoly));
+    u->aptr[c] = my_calloc(_ALLOC_ID_, xctx->arcs[c], sizeof(xArc));
+  }
+  u->wptr = my_calloc(_ALLOC_ID_, xctx->wires, sizeof(xWire));
+  u->tptr = my_calloc(_ALLOC_ID_, xctx->texts, sizeof(xText));
+  u->iptr = my_calloc(_ALLOC_ID_, xctx->instances, sizeof(xInstance));
+  u->texts = xctx->texts;
+  u->instances = xctx->instances;
+  u->wires = xctx->wires;
+
+  for(c = 0;c<cadlayers; ++c) {
+    /* lines */
+    for(i = 0;i<xctx->lines[c]; ++i) {
+      u->lptr[c][i] = xctx->line[c][i];
+      u->lptr[c][i].prop_ptr = NULL;
+      my_strdup(_ALLOC_ID_, &u->lptr[c][i].prop_ptr, xctx->line[c][i].prop_ptr);
+    }
+    /* rects */
+    for(i = 0;i<xctx->rects[c]; ++i) {
+      u->bptr[c][i] = xctx->rect[c][i];
+      u->bptr[c][i].prop_ptr = NULL;
+      u->bptr[c][i].extraptr = NULL;
+      my_strdup(_ALLOC_ID_, &u->bptr[c][i].prop_ptr, xctx->rect[c][i].prop_ptr);
+    }
+    /* arcs */
+    for(i = 0;i<xctx->arcs[c]; ++i) {
+      u->aptr[c][i] = xctx->arc[c][i];
+      u->aptr[c][i].prop_ptr = NULL;
+      my_strdup(_ALLOC_ID_, &u->aptr[c][i].prop_ptr, xctx->arc[c][i].prop_ptr);
+    }
+    /*polygons */
+    for(i = 0;i<xctx->polygons[c]; ++i) {
+      int points = xctx->poly[c][i].points;
+      u->pptr[c][i] = xctx->poly[c][i];
+      u->pptr[c][i].prop_ptr = NULL;
+      u->pptr[c][i].x = my_malloc(_ALLOC_ID_, points * sizeof(double));
+      u->pptr[c][i].y = my_malloc(_ALLOC_ID_, points * sizeof(double));
+      u->pptr[c][i].selected_point = my_malloc(_ALLOC_ID_, points * sizeof(unsigned short));
+      memcpy(u->pptr[c][i].x, xctx->poly[c][i].x, points * sizeof(double));
+      memcpy(u->pptr[c][i].y, xctx->poly[c][i].y, points * sizeof(double));
+      memcpy(u->pptr[c][i].selected_point, xctx->poly[c][i].selected_point, 
+        points * sizeof(unsigned short));
+      my_strdup(_ALLOC_ID_, &u->pptr[c][i].prop_ptr, xctx->poly[c][i].prop_ptr);
+    }
+  }
+  /* instances */
+  for(i = 0;i<xctx->instances; ++i) {
+    u->iptr[i] = xctx->inst[i];
+    u->iptr[i].prop_ptr = NULL;
+    u->iptr[i].name = NULL;
+    u->iptr[i].instname = NULL;
+    u->iptr[i].lab = NULL;
+    u->iptr[i].node = NULL;
+    my_strdup2(_ALLOC_ID_, &u->iptr[i].lab, xctx->inst[i].lab);
+    my_strdup2(_ALLOC_ID_, &u->iptr[i].instname, xctx->inst[i].instname);
+    my_strdup2(_ALLOC_ID_, &u->iptr[i].prop_ptr, xctx->inst[i].prop_ptr);
+    my_strdup2(_ALLOC_ID_, &u->iptr[i].name, xctx->inst[i].name);
+  }
+  /* texts */
+  for(i = 0;i<xctx->texts; ++i) {
+    u->tptr[i] = xctx->text[i];
+    u->tptr[i].prop_ptr = NULL;
+    u->tptr[i].txt_ptr = NULL;
+    u->tptr[i].font = NULL;
+    u->tptr[i].floater_instname = NULL;
+    u->tptr[i].floater_ptr = NULL;
+    my_strdup2(_ALLOC_ID_, &u->tptr[i].prop_ptr, xctx->text[i].prop_ptr);
+    my_strdup2(_ALLOC_ID_, &u->tptr[i].txt_ptr, xctx->text[i].txt_ptr);
+    my_strdup2(_ALLOC_ID_, &u->tptr[i].font, xctx->text[i].font);
+    my_strdup2(_ALLOC_ID_, &u->tptr[i].floater_instname, xctx->text[i].floater_instname);
+    my_strdup2(_ALLOC_ID_, &u->tptr[i].floater_ptr, xctx->text[i].floater_ptr);
+  }
+
+  /* wires */
+  for(i = 0;i<xctx->wires; ++i) {
+    u->wptr[i] = xctx->wire[i];
+    u->wptr[i].prop_ptr = NULL;
+    u->wptr[i].node = NULL;
+    my_strdup(_ALLOC_ID_, &u->wptr[i].prop_ptr, xctx->wire[i].prop_ptr);
+  }
+}
+
+/* replace schematic attributes and objects (not symbols) with a copy of u,
+ * object data must have been cleared with clear_drawing() */
+static void restore_undo_objects(Undo_slot *u)
+{
+  int i, c;
+
+  my_free(_ALLOC_ID_, &xctx->wire);
+  my_free(_ALLOC_ID_, &xctx->text);
+  my_free(_ALLOC_ID_, &xctx->inst);
+  for(i = 0;i<cadlayers; ++i) {
+    my_free(_ALLOC_ID_, &xctx->rect[i]);
+    my_free(_ALLOC_ID_, &xctx->line[i]);
+    my_free(_ALLOC_ID_, &xctx->poly[i]);
+    my_free(_ALLOC_ID_, &xctx->arc[i]);
+  }
+
+  my_strdup(_ALLOC_ID_, &xctx->schvhdlprop, u->gptr);
+  my_strdup(_ALLOC_ID_, &xctx->schverilogprop, u->vptr);
+  my_strdup(_ALLOC_ID_, &xctx->schprop, u->sptr);
+  my_strdup(_ALLOC_ID_, &xctx->schsymbolprop, u->kptr);
+  my_strdup(_ALLOC_ID_, &xctx->schtedaxprop, u->eptr);
+
+  for(c = 0;c<cadlayers; ++c) {
+    /* lines */
+    xctx->maxl[c] = xctx->lines[c] = u->lines[c];
+    xctx->line[c] = my_calloc(_ALLOC_ID_, xctx->lines[c], sizeof(xLine));
+    for(i = 0;i<xctx->lines[c]; ++i) {
+      xctx->line[c][i] = u->lptr[c][i];
+      xctx->line[c][i].prop_ptr = NULL;
+      my_strdup(_ALLOC_ID_, &xctx->line[c][i].prop_ptr, u->lptr[c][i].prop_ptr);
+    }
+    /* rects */
+    xctx->maxr[c] = xctx->rects[c] = u->rects[c];
+    xctx->rect[c] = my_calloc(_ALLOC_ID_, xctx->rects[c], sizeof(xRect));
+    for(i = 0;i<xctx->rects[c]; ++i) {
+      xctx->rect[c][i] = u->bptr[c][i];
+      xctx->rect[c][i].prop_ptr = NULL;
+      xctx->rect[c][i].extraptr = NULL;
+      my_strdup(_ALLOC_ID_, &xctx->rect[c][i].prop_ptr, u->bptr[c][i].prop_ptr);
+    }
+    /* arcs */
+    xctx->maxa[c] = xctx->arcs[c] = u->arcs[c];
+    xctx->arc[c] = my_calloc(_ALLOC_ID_, xctx->arcs[c], sizeof(xArc));
+    for(i = 0;i<xctx->arcs[c]; ++i) {
+      xctx->arc[c][i] = u->aptr[c][i];
+      xctx->arc[c][i].prop_ptr = NULL;
+      my_strdup(_ALLOC_ID_, &xctx->arc[c][i].prop_ptr, u->aptr[c][i].prop_ptr);
+    }
+    /* polygons */
+    xctx->maxp[c] = xctx->polygons[c] = u->polygons[c];
+    xctx->poly[c] = my_calloc(_ALLOC_ID_, xctx->polygons[c], sizeof(xPoly));
+    for(i = 0;i<xctx->polygons[c]; ++i) {
+      int points = u->pptr[c][i].points;
+      xctx->poly[c][i] = u->pptr[c][i];
+      xctx->poly[c][i].prop_ptr = NULL;
+      my_strdup(_ALLOC_ID_, &xctx->poly[c][i].prop_ptr, u->pptr[c][i].prop_ptr);
+      xctx->poly[c][i].x = my_malloc(_ALLOC_ID_, points * sizeof(double));
+      xctx->poly[c][i].y = my_malloc(_ALLOC_ID_, points * sizeof(double));
+      xctx->poly[c][i].selected_point = my_malloc(_ALLOC_ID_, points * sizeof(unsigned short));
+      memcpy(xctx->poly[c][i].x, u->pptr[c][i].x, points * sizeof(double));
+      memcpy(xctx->poly[c][i].y, u->pptr[c][i].y, points * sizeof(double));
+      memcpy(xctx->poly[c][i].selected_point, u->pptr[c][i].selected_point, 
+        points * sizeof(unsigned short));
+    }
+  }
+
+  /* instances */
+  xctx->maxi = xctx->instances = u->instances;
+  xctx->inst = my_calloc(_ALLOC_ID_, xctx->instances, sizeof(xInstance));
+  for(i = 0;i<xctx->instances; ++i) {
+    xctx->inst[i] = u->iptr[i];
+    xctx->inst[i].prop_ptr = NULL;
+    xctx->inst[i].name = NULL;
+    xctx->inst[i].instname = NULL;
+    xctx->inst[i].lab = NULL;
+    my_strdup2(_ALLOC_ID_, &xctx->inst[i].prop_ptr, u->iptr[i].prop_ptr);
+    my_strdup2(_ALLOC_ID_, &xctx->inst[i].name, u->iptr[i].name);
+    my_strdup2(_ALLOC_ID_, &xctx->inst[i].instname, u->iptr[i].instname);
+    my_strdup2(_ALLOC_ID_, &xctx->inst[i].lab, u->iptr[i].lab);
+  }
+
+  /* texts */
+  xctx->maxt = xctx->texts = u->texts;
+  xctx->text = my_calloc(_ALLOC_ID_, xctx->texts, sizeof(xText));
+  for(i = 0;i<xctx->texts; ++i) {
+    xctx->text[i] = u->tptr[i];
+    xctx->text[i].txt_ptr = NULL;
+    xctx->text[i].font = NULL;
+    xctx->text[i].floater_instname = NULL;
+    xctx->text[i].floater_ptr = NULL;
+    xctx->text[i].prop_ptr = NULL;
+    my_strdup2(_ALLOC_ID_, &xctx->text[i].prop_ptr, u->tptr[i].prop_ptr);
+    my_strdup2(_ALLOC_ID_, &xctx->text[i].txt_ptr, u->tptr[i].txt_ptr);
+    my_strdup2(_ALLOC_ID_, &xctx->text[i].font, u->tptr[i].font);
+    my_strdup2(_ALLOC_ID_, &xctx->text[i].floater_instname, u->tptr[i].floater_instname);
+    my_strdup2(_ALLOC_ID_, &xctx->text[i].floater_ptr, u->tptr[i].floater_ptr);
+  }
+
+  /* wires */
+  xctx->maxw = xctx->wires = u->wires;
+  xctx->wire = my_calloc(_ALLOC_ID_, xctx->wires, sizeof(xWire));
+  for(i = 0;i<xctx->wires; ++i) {
+    xctx->wire[i] = u->wptr[i];
+    xctx->wire[i].prop_ptr = NULL;
+    xctx->wire[i].node = NULL;
+    my_strdup(_ALLOC_ID_, &xctx->wire[i].prop_ptr, u->wptr[i].prop_ptr);
+  }
 }
 
 static void mem_init_undo(void)
@@ -206,14 +452,7 @@ static void mem_init_undo(void)
   dbg(1, "mem_init_undo(): undo_initialized = %d\n", xctx->undo_initialized);
   if(!xctx->undo_initialized) {
     for(slot = 0;slot<MAX_UNDO; slot++) {
-      xctx->uslot[slot].lines = my_calloc(_ALLOC_ID_, cadlayers, sizeof(int));
-      xctx->uslot[slot].rects = my_calloc(_ALLOC_ID_, cadlayers, sizeof(int));
-      xctx->uslot[slot].arcs = my_calloc(_ALLOC_ID_, cadlayers, sizeof(int));
-      xctx->uslot[slot].polygons = my_calloc(_ALLOC_ID_, cadlayers, sizeof(int));
-      xctx->uslot[slot].lptr = my_calloc(_ALLOC_ID_, cadlayers, sizeof(xLine *));
-      xctx->uslot[slot].bptr = my_calloc(_ALLOC_ID_, cadlayers, sizeof(xRect *));
-      xctx->uslot[slot].aptr = my_calloc(_ALLOC_ID_, cadlayers, sizeof(xArc *));
-      xctx->uslot[slot].pptr = my_calloc(_ALLOC_ID_, cadlayers, sizeof(xPoly *));
+      init_undo_slot(&xctx->uslot[slot]);
     }
     xctx->undo_initialized = 1;
   }
@@ -229,14 +468,8 @@ void mem_clear_undo(void)
   xctx->head_undo_ptr = 0;
   if(!xctx->undo_initialized) return;
   for(slot = 0; slot<MAX_UNDO; slot++) {
-    free_undo_lines(slot);
-    free_undo_rects(slot);
-    free_undo_polygons(slot);
-    free_undo_arcs(slot);
-    free_undo_wires(slot);
-    free_undo_texts(slot);
-    free_undo_instances(slot);
-    free_undo_symbols(slot);
+    free_undo_objects(&xctx->uslot[slot]);
+    free_undo_symbols(&xctx->uslot[slot]);
   }
 }
 
@@ -248,136 +481,28 @@ void mem_delete_undo(void)
   if(!xctx->undo_initialized) return;
   mem_clear_undo();
   for(slot = 0;slot<MAX_UNDO; slot++) {
-    my_free(_ALLOC_ID_, &xctx->uslot[slot].lines);
-    my_free(_ALLOC_ID_, &xctx->uslot[slot].rects);
-    my_free(_ALLOC_ID_, &xctx->uslot[slot].arcs);
-    my_free(_ALLOC_ID_, &xctx->uslot[slot].polygons);
-    my_free(_ALLOC_ID_, &xctx->uslot[slot].lptr);
-    my_free(_ALLOC_ID_, &xctx->uslot[slot].bptr);
-    my_free(_ALLOC_ID_, &xctx->uslot[slot].aptr);
-    my_free(_ALLOC_ID_, &xctx->uslot[slot].pptr);
+    delete_undo_slot(&xctx->uslot[slot]);
   }
   xctx->undo_initialized = 0;
 }
 
 void mem_push_undo(void)
 {
-  int slot, i, c;
+  int slot, i;
 
   if(xctx->no_undo)return;
   mem_init_undo();
   slot = xctx->cur_undo_ptr%MAX_UNDO;
 
-  my_strdup(_ALLOC_ID_, &xctx->uslot[slot].gptr, xctx->schvhdlprop);
-  my_strdup(_ALLOC_ID_, &xctx->uslot[slot].vptr, xctx->schverilogprop);
-  my_strdup(_ALLOC_ID_, &xctx->uslot[slot].sptr, xctx->schprop);
-  my_strdup(_ALLOC_ID_, &xctx->uslot[slot].kptr, xctx->schsymbolprop);
-  my_strdup(_ALLOC_ID_, &xctx->uslot[slot].eptr, xctx->schtedaxprop);
-
-  free_undo_lines(slot);
-  free_undo_rects(slot);
-  free_undo_polygons(slot);
-  free_undo_arcs(slot);
-  free_undo_wires(slot);
-  free_undo_texts(slot);
-  free_undo_instances(slot);
-  free_undo_symbols(slot);
-
-  memcpy(xctx->uslot[slot].lines, xctx->lines, sizeof(xctx->lines[0]) * cadlayers);
-  memcpy(xctx->uslot[slot].rects, xctx->rects, sizeof(xctx->rects[0]) * cadlayers);
-  memcpy(xctx->uslot[slot].arcs, xctx->arcs, sizeof(xctx->arcs[0]) * cadlayers);
-  memcpy(xctx->uslot[slot].polygons, xctx->polygons, sizeof(xctx->polygons[0]) * cadlayers);
-  for(c = 0;c<cadlayers; ++c) {
-    xctx->uslot[slot].lptr[c] = my_calloc(_ALLOC_ID_, xctx->lines[c], sizeof(xLine));
-    xctx->uslot[slot].bptr[c] = my_calloc(_ALLOC_ID_, xctx->rects[c], sizeof(xRect));
-    xctx->uslot[slot].pptr[c] = my_calloc(_ALLOC_ID_, xctx->polygons[c], sizeof(xPoly));
-    xctx->uslot[slot].aptr[c] = my_calloc(_ALLOC_ID_, xctx->arcs[c], sizeof(xArc));
-  }
-  xctx->uslot[slot].wptr = my_calloc(_ALLOC_ID_, xctx->wires, sizeof(xWire));
-  xctx->uslot[slot].tptr = my_calloc(_ALLOC_ID_, xctx->texts, sizeof(xText));
-  xctx->uslot[slot].iptr = my_calloc(_ALLOC_ID_, xctx->instances, sizeof(xInstance));
-  xctx->uslot[slot].symptr = my_calloc(_ALLOC_ID_, xctx->symbols, sizeof(xSymbol));
-  xctx->uslot[slot].texts = xctx->texts;
-  xctx->uslot[slot].instances = xctx->instances;
-  xctx->uslot[slot].symbols = xctx->symbols;
-  xctx->uslot[slot].wires = xctx->wires;
-
-  for(c = 0;c<cadlayers; ++c) {
-    /* lines */
-    for(i = 0;i<xctx->lines[c]; ++i) {
-      xctx->uslot[slot].lptr[c][i] = xctx->line[c][i];
-      xctx->uslot[slot].lptr[c][i].prop_ptr = NULL;
-      my_strdup(_ALLOC_ID_, &xctx->uslot[slot].lptr[c][i].prop_ptr, xctx->line[c][i].prop_ptr);
-    }
-    /* rects */
-    for(i = 0;i<xctx->rects[c]; ++i) {
-      xctx->uslot[slot].bptr[c][i] = xctx->rect[c][i];
-      xctx->uslot[slot].bptr[c][i].prop_ptr = NULL;
-      xctx->uslot[slot].bptr[c][i].extraptr = NULL;
-      my_strdup(_ALLOC_ID_, &xctx->uslot[slot].bptr[c][i].prop_ptr, xctx->rect[c][i].prop_ptr);
-    }
-    /* arcs */
-    for(i = 0;i<xctx->arcs[c]; ++i) {
-      xctx->uslot[slot].aptr[c][i] = xctx->arc[c][i];
-      xctx->uslot[slot].aptr[c][i].prop_ptr = NULL;
-      my_strdup(_ALLOC_ID_, &xctx->uslot[slot].aptr[c][i].prop_ptr, xctx->arc[c][i].prop_ptr);
-    }
-    /*polygons */
-    for(i = 0;i<xctx->polygons[c]; ++i) {
-      int points = xctx->poly[c][i].points;
-      xctx->uslot[slot].pptr[c][i] = xctx->poly[c][i];
-      xctx->uslot[slot].pptr[c][i].prop_ptr = NULL;
-      xctx->uslot[slot].pptr[c][i].x = my_malloc(_ALLOC_ID_, points * sizeof(double));
-      xctx->uslot[slot].pptr[c][i].y = my_malloc(_ALLOC_ID_, points * sizeof(double));
-      xctx->uslot[slot].pptr[c][i].selected_point = my_malloc(_ALLOC_ID_, points * sizeof(unsigned short));
-      memcpy(xctx->uslot[slot].pptr[c][i].x, xctx->poly[c][i].x, points * sizeof(double));
-      memcpy(xctx->uslot[slot].pptr[c][i].y, xctx->poly[c][i].y, points * sizeof(double));
-      memcpy(xctx->uslot[slot].pptr[c][i].selected_point, xctx->poly[c][i].selected_point, 
-        points * sizeof(unsigned short));
-      my_strdup(_ALLOC_ID_, &xctx->uslot[slot].pptr[c][i].prop_ptr, xctx->poly[c][i].prop_ptr);
-    }
-  }
-  /* instances */
-  for(i = 0;i<xctx->instances; ++i) {
-    xctx->uslot[slot].iptr[i] = xctx->inst[i];
-    xctx->uslot[slot].iptr[i].prop_ptr = NULL;
-    xctx->uslot[slot].iptr[i].name = NULL;
-    xctx->uslot[slot].iptr[i].instname = NULL;
-    xctx->uslot[slot].iptr[i].lab = NULL;
-    xctx->uslot[slot].iptr[i].node = NULL;
-    my_strdup2(_ALLOC_ID_, &xctx->uslot[slot].iptr[i].lab, xctx->inst[i].lab);
-    my_strdup2(_ALLOC_ID_, &xctx->uslot[slot].iptr[i].instname, xctx->inst[i].instname);
-    my_strdup2(_ALLOC_ID_, &xctx->uslot[slot].iptr[i].prop_ptr, xctx->inst[i].prop_ptr);
-    my_strdup2(_ALLOC_ID_, &xctx->uslot[slot].iptr[i].name, xctx->inst[i].name);
-  }
+  save_undo_objects(&xctx->uslot[slot]);
 
   /* symbols */
+  free_undo_symbols(&xctx->uslot[slot]);
+  xctx->uslot[slot].symptr = my_calloc(_ALLOC_ID_, xctx->symbols, sizeof(xSymbol));
+  xctx->uslot[slot].symbols = xctx->symbols;
   for(i = 0;i<xctx->symbols; ++i) {
     copy_symbol(&xctx->uslot[slot].symptr[i], &xctx->sym[i]);
   }
-  /* texts */
-  for(i = 0;i<xctx->texts; ++i) {
-    xctx->uslot[slot].tptr[i] = xctx->text[i];
-    xctx->uslot[slot].tptr[i].prop_ptr = NULL;
-    xctx->uslot[slot].tptr[i].txt_ptr = NULL;
-    xctx->uslot[slot].tptr[i].font = NULL;
-    xctx->uslot[slot].tptr[i].floater_instname = NULL;
-    xctx->uslot[slot].tptr[i].floater_ptr = NULL;
-    my_strdup2(_ALLOC_ID_, &xctx->uslot[slot].tptr[i].prop_ptr, xctx->text[i].prop_ptr);
-    my_strdup2(_ALLOC_ID_, &xctx->uslot[slot].tptr[i].txt_ptr, xctx->text[i].txt_ptr);
-    my_strdup2(_ALLOC_ID_, &xctx->uslot[slot].tptr[i].font, xctx->text[i].font);
-    my_strdup2(_ALLOC_ID_, &xctx->uslot[slot].tptr[i].floater_instname, xctx->text[i].floater_instname);
-    my_strdup2(_ALLOC_ID_, &xctx->uslot[slot].tptr[i].floater_ptr, xctx->text[i].floater_ptr);
-  }
-
-  /* wires */
-  for(i = 0;i<xctx->wires; ++i) {
-    xctx->uslot[slot].wptr[i] = xctx->wire[i];
-    xctx->uslot[slot].wptr[i].prop_ptr = NULL;
-    xctx->uslot[slot].wptr[i].node = NULL;
-    my_strdup(_ALLOC_ID_, &xctx->uslot[slot].wptr[i].prop_ptr, xctx->wire[i].prop_ptr);
-  }
-
 
   xctx->cur_undo_ptr++;
   xctx->head_undo_ptr = xctx->cur_undo_ptr;
@@ -391,7 +516,7 @@ void mem_push_undo(void)
  */
 void mem_pop_undo(int redo, int set_modify_status)
 {
-  int slot, i, c;
+  int slot, i;
 
   if(xctx->no_undo)return;
   if(redo == 1) {
@@ -416,17 +541,6 @@ void mem_pop_undo(int redo, int set_modify_status)
   slot = xctx->cur_undo_ptr%MAX_UNDO;
   clear_drawing();
   unselect_all(1);
-  my_free(_ALLOC_ID_, &xctx->wire);
-  my_free(_ALLOC_ID_, &xctx->text);
-  my_free(_ALLOC_ID_, &xctx->inst);
-
-  for(i = 0;i<cadlayers; ++i) {
-    my_free(_ALLOC_ID_, &xctx->rect[i]);
-    my_free(_ALLOC_ID_, &xctx->line[i]);
-    my_free(_ALLOC_ID_, &xctx->poly[i]);
-    my_free(_ALLOC_ID_, &xctx->arc[i]);
-  }
-
   remove_symbols();
 
 
@@ -445,70 +559,7 @@ void mem_pop_undo(int redo, int set_modify_status)
   my_free(_ALLOC_ID_, &xctx->sym);
 
 
-  my_strdup(_ALLOC_ID_, &xctx->schvhdlprop, xctx->uslot[slot].gptr);
-  my_strdup(_ALLOC_ID_, &xctx->schverilogprop, xctx->uslot[slot].vptr);
-  my_strdup(_ALLOC_ID_, &xctx->schprop, xctx->uslot[slot].sptr);
-  my_strdup(_ALLOC_ID_, &xctx->schsymbolprop, xctx->uslot[slot].kptr);
-  my_strdup(_ALLOC_ID_, &xctx->schtedaxprop, xctx->uslot[slot].eptr);
-
-  for(c = 0;c<cadlayers; ++c) {
-    /* lines */
-    xctx->maxl[c] = xctx->lines[c] = xctx->uslot[slot].lines[c];
-    xctx->line[c] = my_calloc(_ALLOC_ID_, xctx->lines[c], sizeof(xLine));
-    for(i = 0;i<xctx->lines[c]; ++i) {
-      xctx->line[c][i] = xctx->uslot[slot].lptr[c][i];
-      xctx->line[c][i].prop_ptr = NULL;
-      my_strdup(_ALLOC_ID_, &xctx->line[c][i].prop_ptr, xctx->uslot[slot].lptr[c][i].prop_ptr);
-    }
-    /* rects */
-    xctx->maxr[c] = xctx->rects[c] = xctx->uslot[slot].rects[c];
-    xctx->rect[c] = my_calloc(_ALLOC_ID_, xctx->rects[c], sizeof(xRect));
-    for(i = 0;i<xctx->rects[c]; ++i) {
-      xctx->rect[c][i] = xctx->uslot[slot].bptr[c][i];
-      xctx->rect[c][i].prop_ptr = NULL;
-      xctx->rect[c][i].extraptr = NULL;
-      my_strdup(_ALLOC_ID_, &xctx->rect[c][i].prop_ptr, xctx->uslot[slot].bptr[c][i].prop_ptr);
-    }
-    /* arcs */
-    xctx->maxa[c] = xctx->arcs[c] = xctx->uslot[slot].arcs[c];
-    xctx->arc[c] = my_calloc(_ALLOC_ID_, xctx->arcs[c], sizeof(xArc));
-    for(i = 0;i<xctx->arcs[c]; ++i) {
-      xctx->arc[c][i] = xctx->uslot[slot].aptr[c][i];
-      xctx->arc[c][i].prop_ptr = NULL;
-      my_strdup(_ALLOC_ID_, &xctx->arc[c][i].prop_ptr, xctx->uslot[slot].aptr[c][i].prop_ptr);
-    }
-    /* polygons */
-    xctx->maxp[c] = xctx->polygons[c] = xctx->uslot[slot].polygons[c];
-    xctx->poly[c] = my_calloc(_ALLOC_ID_, xctx->polygons[c], sizeof(xPoly));
-    for(i = 0;i<xctx->polygons[c]; ++i) {
-      int points = xctx->uslot[slot].pptr[c][i].points;
-      xctx->poly[c][i] = xctx->uslot[slot].pptr[c][i];
-      xctx->poly[c][i].prop_ptr = NULL;
-      my_strdup(_ALLOC_ID_, &xctx->poly[c][i].prop_ptr, xctx->uslot[slot].pptr[c][i].prop_ptr);
-      xctx->poly[c][i].x = my_malloc(_ALLOC_ID_, points * sizeof(double));
-      xctx->poly[c][i].y = my_malloc(_ALLOC_ID_, points * sizeof(double));
-      xctx->poly[c][i].selected_point = my_malloc(_ALLOC_ID_, points * sizeof(unsigned short));
-      memcpy(xctx->poly[c][i].x, xctx->uslot[slot].pptr[c][i].x, points * sizeof(double));
-      memcpy(xctx->poly[c][i].y, xctx->uslot[slot].pptr[c][i].y, points * sizeof(double));
-      memcpy(xctx->poly[c][i].selected_point, xctx->uslot[slot].pptr[c][i].selected_point, 
-        points * sizeof(unsigned short));
-    }
-  }
-
-  /* instances */
-  xctx->maxi = xctx->instances = xctx->uslot[slot].instances;
-  xctx->inst = my_calloc(_ALLOC_ID_, xctx->instances, sizeof(xInstance));
-  for(i = 0;i<xctx->instances; ++i) {
-    xctx->inst[i] = xctx->uslot[slot].iptr[i];
-    xctx->inst[i].prop_ptr = NULL;
-    xctx->inst[i].name = NULL;
-    xctx->inst[i].instname = NULL;
-    xctx->inst[i].lab = NULL;
-    my_strdup2(_ALLOC_ID_, &xctx->inst[i].prop_ptr, xctx->uslot[slot].iptr[i].prop_ptr);
-    my_strdup2(_ALLOC_ID_, &xctx->inst[i].name, xctx->uslot[slot].iptr[i].name);
-    my_strdup2(_ALLOC_ID_, &xctx->inst[i].instname, xctx->uslot[slot].iptr[i].instname);
-    my_strdup2(_ALLOC_ID_, &xctx->inst[i].lab, xctx->uslot[slot].iptr[i].lab);
-  }
+  restore_undo_objects(&xctx->uslot[slot]);
 
   /* symbols */
   xctx->maxs = xctx->symbols = xctx->uslot[slot].symbols;
@@ -518,32 +569,6 @@ void mem_pop_undo(int redo, int set_modify_status)
     copy_symbol(&xctx->sym[i], &xctx->uslot[slot].symptr[i]);
   }
 
-  /* texts */
-  xctx->maxt = xctx->texts = xctx->uslot[slot].texts;
-  xctx->text = my_calloc(_ALLOC_ID_, xctx->texts, sizeof(xText));
-  for(i = 0;i<xctx->texts; ++i) {
-    xctx->text[i] = xctx->uslot[slot].tptr[i];
-    xctx->text[i].txt_ptr = NULL;
-    xctx->text[i].font = NULL;
-    xctx->text[i].floater_instname = NULL;
-    xctx->text[i].floater_ptr = NULL;
-    xctx->text[i].prop_ptr = NULL;
-    my_strdup2(_ALLOC_ID_, &xctx->text[i].prop_ptr, xctx->uslot[slot].tptr[i].prop_ptr);
-    my_strdup2(_ALLOC_ID_, &xctx->text[i].txt_ptr, xctx->uslot[slot].tptr[i].txt_ptr);
-    my_strdup2(_ALLOC_ID_, &xctx->text[i].font, xctx->uslot[slot].tptr[i].font);
-    my_strdup2(_ALLOC_ID_, &xctx->text[i].floater_instname, xctx->uslot[slot].tptr[i].floater_instname);
-    my_strdup2(_ALLOC_ID_, &xctx->text[i].floater_ptr, xctx->uslot[slot].tptr[i].floater_ptr);
-  }
-
-  /* wires */
-  xctx->maxw = xctx->wires = xctx->uslot[slot].wires;
-  xctx->wire = my_calloc(_ALLOC_ID_, xctx->wires, sizeof(xWire));
-  for(i = 0;i<xctx->wires; ++i) {
-    xctx->wire[i] = xctx->uslot[slot].wptr[i];
-    xctx->wire[i].prop_ptr = NULL;
-    xctx->wire[i].node = NULL;
-    my_strdup(_ALLOC_ID_, &xctx->wire[i].prop_ptr, xctx->uslot[slot].wptr[i].prop_ptr);
-  }
   /* unnecessary since in_memory_undo saves all symbols */
   /* link_symbols_to_instances(-1); */
   if(redo == 2) xctx->cur_undo_ptr++; /* restore undo stack pointer */
@@ -555,3 +580,32 @@ void mem_pop_undo(int redo, int set_modify_status)
   update_conn_cues(WIRELAYER, 0, 0);
   int_hash_free(&xctx->floater_inst_table);
 }
+
+/* session design cache (see load_schematic()): snapshot of current schematic attributes
+ * and objects, symbols are not included */
+Undo_slot *mem_save_objects(void)
+{
+  Undo_slot *u = my_calloc(_ALLOC_ID_, 1, sizeof(Undo_slot));
+
+  init_undo_slot(u);
+  save_undo_objects(u);
+  return u;
+}
+
+/* replace current schematic attributes and objects with snapshot u */
+void mem_restore_objects(Undo_slot *u)
+{
+  restore_undo_objects(u);
+}
+
+void mem_free_objects(Undo_slot *u)
+{
+  free_undo_objects(u);
+  my_free(_ALLOC_ID_, &u->gptr);
+  my_free(_ALLOC_ID_, &u->vptr);
+  my_free(_ALLOC_ID_, &u->sptr);
+  my_free(_ALLOC_ID_, &u->kptr);
+  my_free(_ALLOC_ID_, &u->eptr);
+  delete_undo_slot(u);
+  my_free(_ALLOC_ID_, &u);
+}
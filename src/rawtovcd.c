@@ -27,6 +27,7 @@
 #include <string.h>
 #include <math.h>
 #define BUFSIZE 4095
+#define OUTBUFSIZE (1 << 20)
 int binary_waves=0;
 double voltage = 3;
 double vth=2.5;
@@ -34,7 +35,6 @@ double vtl=0.5;
 int debug = 1;
 FILE *fd;
 int nvars = 0 , npoints = 0;
-double **values = NULL;
 char **names = NULL, **vcd_ids = NULL;
 double timescale=1e11; /* spice times will be multiplied by this number to get an integer */
 double rel_timestep_precision = 5e-3;
@@ -71,25 +71,6 @@ const char *get_vcd_id(int idx)
   return res + pos;
 }
 
-/* binary block is just a blob of npoints * nvars doubles */
-void read_binary_block()
-{
-  int p;
-
-  /* allocate storage for binary block */
-  values = calloc(npoints, sizeof(double *));
-  for(p = 0 ; p < npoints; p++) {
-    values[p] = calloc(nvars, sizeof(double));
-  }
-  /* read binary block */
-  for(p = 0; p < npoints; p++) {
-    if(fread(values[p], sizeof(double), nvars, fd) != nvars) {
-       fprintf(stderr, "Warning: binary block is not of correct size\n");
-    }
-  }
-  if(debug) fprintf(stderr, "done reading binary block\n");
-}
-
 /* parse ascii raw header section:
  * returns: 1 if dataset and variables were read.
  *          0 if transient sim dataset not found
@@ -159,20 +140,20 @@ int read_dataset(void)
     variables = -1; /* EOF */
   }
   if(debug) fprintf(stderr, "npoints=%d, nvars=%d\n", npoints, nvars);
-  if(variables == 1) {
-    read_binary_block();
-  } else if(variables == 0) {
+  if(variables == 0) {
     if(debug) fprintf(stderr, "seeking past binary block\n");
     fseek(fd, nvars * npoints * sizeof(double), SEEK_CUR); /* skip binary block */
   }
   return variables;
 }
 
-unsigned char tobin(double v)
+/* digital value of v with hysteresis: level changes only when crossing the opposite
+ * threshold, 'x' only if no level has been reached yet */
+unsigned char tobin(double v, unsigned char prev)
 {
   if(v > vth) return '1';
   else if(v < vtl) return '0';
-  else return 'x';
+  else return prev;
 }
 
 void write_vcd_header()
@@ -206,44 +187,65 @@ void write_vcd_header()
   printf("$enddefinitions $end\n");
 }
 
+/* binary block is a blob of npoints rows of nvars doubles: read one row at a time
+ * and print only changed values, so memory use does not depend on raw file size */
 void dump_vcd_waves()
 {
-  int p, v;
-  double *lastvalue, val;
+  int p, v, changed;
+  double *row, *lastvalue, val;
+  unsigned char *lastbin, b;
+  long t, lastt = -1;
 
+  row = malloc(nvars * sizeof(double));
   lastvalue = malloc(nvars * sizeof(double));
+  lastbin = malloc(nvars);
   for(p = 0; p < npoints; p++) {
+    if(fread(row, sizeof(double), nvars, fd) != (size_t)nvars) {
+      fprintf(stderr, "Warning: binary block is not of correct size\n");
+      break;
+    }
     if(p == 0) {
       printf("#0\n");
       printf("$dumpvars\n");
-      for(v = 1 ; val = values[p][v], v < nvars; v++) {
-        if(binary_waves) printf("%c%s\n", tobin(val), vcd_ids[v]);
-        else             printf("r%.3g %s\n", val, vcd_ids[v]);
-        if(binary_waves) lastvalue[v] = tobin(val);
-        else             lastvalue[v] = val;
+      for(v = 1; v < nvars; v++) {
+        val = row[v];
+        if(binary_waves) {
+          lastbin[v] = tobin(val, 'x');
+          printf("%c%s\n", lastbin[v], vcd_ids[v]);
+        } else {
+          lastvalue[v] = val;
+          printf("r%.3g %s\n", val, vcd_ids[v]);
+        }
       }
       printf("$end\n");
+      lastt = 0;
     } else {
-      printf("#%d\n", (int) (values[p][0] * timescale));
-      for(v = 1 ; val = values[p][v], v < nvars; v++) {
+      t = (long) (row[0] * timescale);
+      changed = 0;
+      for(v = 1; v < nvars; v++) {
+        val = row[v];
         if(binary_waves) {
-          if( tobin(val) != lastvalue[v] ) {
-            printf("%c%s\n", tobin(val), vcd_ids[v]);
-            lastvalue[v] = tobin(val);
-          }
+          if((b = tobin(val, lastbin[v])) == lastbin[v]) continue;
+          lastbin[v] = b;
         } else {
-          if(
+          if(!(
              (val != 0.0 &&  fabs((val - lastvalue[v]) / val) > rel_timestep_precision) ||
              (val == 0.0 && fabs(val - lastvalue[v]) > abs_timestep_precision)
-            ) {
-            printf("r%.3g %s\n", val, vcd_ids[v]);
-            lastvalue[v] = val;
-          }
+            )) continue;
+          lastvalue[v] = val;
         }
+        if(!changed && t != lastt) printf("#%ld\n", t);
+        changed = 1;
+        lastt = t;
+        if(binary_waves) printf("%c%s\n", b, vcd_ids[v]);
+        else             printf("r%.3g %s\n", val, vcd_ids[v]);
       }
     }
   }
+  if(debug) fprintf(stderr, "done converting %d points\n", p);
+  free(row);
   free(lastvalue);
+  free(lastbin);
 }
 
 void free_storage()
@@ -254,10 +256,6 @@ void free_storage()
     free(names[i]);
     free(vcd_ids[i]);
   }
-  for(i = 0 ; i < npoints; ++i) {
-    free(values[i]);
-  }
-  free(values);
   free(names);
   free(vcd_ids);
 }
@@ -275,6 +273,12 @@ int main(int argc, char *argv[])
       voltage = atof(argv[i]);
       vth = voltage * 0.75;
       vtl = voltage * 0.25;
+    } else if(!strcmp(argv[i], "-t")) {
+      i += 2;
+      if(i + 1 >= argc) continue;
+      binary_waves = 1;
+      vth = atof(argv[i - 1]);
+      vtl = atof(argv[i]);
     } else if(argv[i][0] == '-') {
       ++i;
     } else {
@@ -285,9 +289,11 @@ int main(int argc, char *argv[])
   if(i >= argc) {
     fprintf(stderr, "Rawtovcd: convert a spice RAW file to VCD\n");
     fprintf(stderr, "If '-v voltage' is given transform waves to digital (binary values)\n");
-    fprintf(stderr, "usage: rawtovcd [-v voltage] rawfile > vcdfile\n");
+    fprintf(stderr, "with thresholds at 75%% and 25%% of voltage, '-t vth vtl' gives thresholds\n");
+    fprintf(stderr, "usage: rawtovcd [-v voltage | -t vth vtl] rawfile > vcdfile\n");
     exit(EXIT_FAILURE);
   }
+  setvbuf(stdout, NULL, _IOFBF, OUTBUFSIZE);
   if(!strcmp(argv[i], "-")) fd = stdin;
   else fd = fopen(argv[i], "r");
   if(fd) for(;;) {
@@ -23,6 +23,7 @@
 #include "xschem.h"
 #ifdef __unix__
 #include <sys/wait.h>  /* waitpid */
+#include <sys/mman.h>  /* mmap */
 #endif
 
 
@@ -391,18 +392,63 @@ void transpose_matrix(double *a, int r, int c)
  * data layout in memory arranged to maximize cache locality 
  * when looking up data 
  */
+/* assign binary block row 'tmp' (nvars doubles) to data columns at 'point',
+ * memory aligned per variable, for cache locality */
+static void store_binary_row(Raw *raw, double *tmp, int nvars, int point, int ac)
+{
+  int v;
+  if(ac) {
+    for(v = 0; v < nvars; v += 2) { /*AC analysis: calculate magnitude */
+      if( v == 0 )  /* sweep var */
+        raw->values[v][point] = (SPICE_DATA)sqrt( tmp[v] * tmp[v] + tmp[v + 1] * tmp[v + 1]);
+      else /* magnitude */
+        /* avoid 0 for dB calculations */
+        if(tmp[v] == 0.0 && tmp[v + 1] == 0.0) raw->values[v][point] = 1e-35f;
+        else raw->values[v][point] = 
+                (SPICE_DATA)sqrt(tmp[v] * tmp[v] + tmp[v + 1] * tmp[v + 1]);
+      /* AC analysis: calculate phase */
+      if(tmp[v] == 0.0 && tmp[v + 1] == 0.0) raw->values[v + 1] [point] = 0.0; 
+      else raw->values[v + 1] [point] =
+              (SPICE_DATA)(atan2(tmp[v + 1], tmp[v]) * 180.0 / XSCH_PI);
+    }
+  } 
+  else for(v = 0; v < nvars; v++) {
+    raw->values[v][point] = (SPICE_DATA)tmp[v];
+  }
+}
+
+/* read sweep variable (first column) of row 'p' of binary block starting at 'pos' */
+static double read_sweep_value(FILE *fd, size_t pos, size_t rowsize, int p)
+{
+  double v = 0.0;
+  xfseek(fd, pos + p * rowsize, SEEK_SET);
+  if(fread(&v, sizeof(double), 1, fd) != 1) {
+    dbg(0, "Warning: binary block is not of correct size\n");
+  }
+  return v;
+}
+
+/* first row in binary block starting at 'pos' with sweep variable >= val.
+ * sweep variable must be monotonically increasing */
+static int sweep_lower_bound(FILE *fd, size_t pos, size_t rowsize, int n, double val)
+{
+  int lo = 0, hi = n, mid;
+  while(lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if(read_sweep_value(fd, pos, rowsize, mid) < val) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
 static void read_binary_block(FILE *fd, Raw *raw, int ac)
 {
-  int i, p, v;
+  int i, p;
   double *tmp;
   int offset = 0;
-  #ifdef __unix__
-    long filepos;
-  #else
-    __int3264 filepos;
-  #endif 
-  int npoints;
-
+  int npoints, first = 0, last;
+  int range = !(raw && raw->sweep1 == raw->sweep2 && raw->sweep1 == -1.0);
+  size_t rowsize, pos = 0;
 
   if(!raw) {
     dbg(0, "read_binary_block() no raw struct allocated\n");
@@ -411,27 +457,27 @@ static void read_binary_block(FILE *fd, Raw *raw, int ac)
 
   /* read buffer */
   tmp = my_calloc(_ALLOC_ID_, raw->nvars, (sizeof(double *) ));
-
-  /* if sweep1 and sweep2 are given calculate actual npoints that will be loaded */
-  npoints = raw->npoints[raw->datasets];
-  if(!(raw->sweep1 == raw->sweep2 && raw->sweep1 == -1.0)) {
-    double sweepvar;
-    npoints = 0;
-    filepos = xftell(fd); /* store file pointer position */
-    for(p = 0; p < raw->npoints[raw->datasets]; p++) {
-      if(fread(tmp, sizeof(double), raw->nvars, fd) != raw->nvars) {
-         dbg(0, "Warning: binary block is not of correct size\n");
-      }
-      sweepvar = tmp[0];
-      if(sweepvar < raw->sweep1 || sweepvar >= raw->sweep2) continue;
-      else npoints++;
-    }
-    xfseek(fd, filepos, SEEK_SET); /* rewind file pointer */
+  rowsize = raw->nvars * sizeof(double);
+  npoints = last = raw->npoints[raw->datasets];
+  /* if sweep1 and sweep2 are given and sweep variable is monotonic (time, frequency)
+   * locate first and last rows in range with a binary search on the sweep column
+   * and read only these rows. Other analyses (dc sweeps may go backwards) are
+   * filtered while reading all rows. */
+  if(range) {
+    pos = xftell(fd);
+    if(raw->sim_type && (!strcmp(raw->sim_type, "tran") ||
+        !strcmp(raw->sim_type, "ac") || !strcmp(raw->sim_type, "noise"))) {
+      first = sweep_lower_bound(fd, pos, rowsize, npoints, raw->sweep1);
+      last = first + sweep_lower_bound(fd, pos + first * rowsize, rowsize, npoints - first, raw->sweep2);
+      npoints = last - first;
+    }
+    xfseek(fd, pos + first * rowsize, SEEK_SET);
   }
   for(p = 0 ; p < raw->datasets; p++) {
     offset += raw->npoints[p];
   }
-  /* allocate storage for binary block, add one data column for custom data plots */
+  /* allocate storage for binary block, add one data column for custom data plots.
+   * If filtering all rows allocate for the worst case and shrink afterwards */
   if(!raw->values) raw->values = my_calloc(_ALLOC_ID_, raw->nvars + 1, sizeof(SPICE_DATA *));
   for(p = 0 ; p <= raw->nvars; p++) {
     my_realloc(_ALLOC_ID_,
@@ -439,41 +485,1284 @@ static void read_binary_block(FILE *fd, Raw *raw, int ac)
   }
   /* read binary block */
   p = 0;
-  for(i = 0; i < raw->npoints[raw->datasets]; i++) {
+  for(i = first; i < last; i++) {
     if(fread(tmp, sizeof(double), raw->nvars, fd) != raw->nvars) {
        dbg(0, "Warning: binary block is not of correct size\n");
     }
 
-    if(!(raw->sweep1 == raw->sweep2 && raw->sweep1 == -1.0)) {
+    if(range) {
       double sweepvar = tmp[0];
       if(sweepvar < raw->sweep1 || sweepvar >= raw->sweep2) continue;
     }
-
-    /* assign to xschem struct, memory aligned per variable, for cache locality */
-    if(ac) {
-      for(v = 0; v < raw->nvars; v += 2) { /*AC analysis: calculate magnitude */
-        if( v == 0 )  /* sweep var */
-          raw->values[v][offset + p] = (SPICE_DATA)sqrt( tmp[v] * tmp[v] + tmp[v + 1] * tmp[v + 1]);
-        else /* magnitude */
-          /* avoid 0 for dB calculations */
-          if(tmp[v] == 0.0 && tmp[v + 1] == 0.0) raw->values[v][offset + p] = 1e-35f;
-          else raw->values[v][offset + p] = 
-                  (SPICE_DATA)sqrt(tmp[v] * tmp[v] + tmp[v + 1] * tmp[v + 1]);
-        /* AC analysis: calculate phase */
-        if(tmp[v] == 0.0 && tmp[v + 1] == 0.0) raw->values[v + 1] [offset + p] = 0.0; 
-        else raw->values[v + 1] [offset + p] =
-                (SPICE_DATA)(atan2(tmp[v + 1], tmp[v]) * 180.0 / XSCH_PI);
-      }
-    } 
-    else for(v = 0; v < raw->nvars; v++) {
-      raw->values[v][offset + p] = (SPICE_DATA)tmp[v];
-    }
+    store_binary_row(raw, tmp, raw->nvars, offset + p, ac);
     p++;
   }
+  if(range) {
+    if(p < npoints) for(i = 0 ; i <= raw->nvars; i++) {
+      my_realloc(_ALLOC_ID_, &raw->values[i], (offset + p) * sizeof(SPICE_DATA));
+    }
+    npoints = p;
+    /* skip remaining rows of block */
+    xfseek(fd, pos + raw->npoints[raw->datasets] * rowsize, SEEK_SET);
+  }
   raw->npoints[raw->datasets] = npoints; /* if sweeep1 and sweep2 are given less points are read */
+  /* position where a still running simulation will append data (follow mode) */
+  raw->follow_pos = xftell(fd);
+  raw->follow_nvars = raw->nvars;
+  raw->follow_ac = ac;
+  raw->follow_alloc = offset + npoints;
   my_free(_ALLOC_ID_, &tmp);
 }
 
+/* chunked reader of ASCII raw file values */
+#define ASCII_CHUNK 65536
+typedef struct {
+  FILE *fd;
+  size_t pos, len;
+  int eof;
+  int comma; /* comma is a delimiter */
+  char buf[ASCII_CHUNK + 1];
+} Ascii_reader;
+
+#define ASCII_DELIM(r, c) ((c) == ' ' || (c) == '\t' || (c) == '\n' || (c) == '\r' || \
+                           ((c) == ',' && (r)->comma))
+
+/* return next blank, newline or comma (if r->comma set) separated token, nul terminated in
+ * reader buffer, valid until next call. NULL at end of file.
+ * Buffer is refilled as needed keeping a partially read token */
+static char *ascii_token(Ascii_reader *r)
+{
+  size_t start, end;
+
+  for(;;) {
+    while(r->pos < r->len && ASCII_DELIM(r, r->buf[r->pos])) r->pos++;
+    if(r->pos < r->len || r->eof) break;
+    r->len = fread(r->buf, 1, ASCII_CHUNK, r->fd);
+    r->pos = 0;
+    if(r->len < ASCII_CHUNK) r->eof = 1;
+  }
+  if(r->pos >= r->len) return NULL;
+  start = r->pos;
+  for(;;) {
+    for(end = r->pos; end < r->len && !ASCII_DELIM(r, r->buf[end]); end++);
+    if(end < r->len || r->eof) break;
+    /* token continues in next chunk: move it to buffer start and read more */
+    r->len -= start;
+    memmove(r->buf, r->buf + start, r->len);
+    r->pos = r->len;
+    start = 0;
+    r->len += fread(r->buf + r->len, 1, ASCII_CHUNK - r->len, r->fd);
+    if(r->len < ASCII_CHUNK) r->eof = 1;
+    if(r->pos == r->len) break; /* token longer than buffer */
+  }
+  r->buf[end] = '\0';
+  r->pos = end < r->len ? end + 1 : end;
+  return r->buf + start;
+}
+
+/* read ASCII raw file 'Values:' section of current dataset. Each point is given as its
+ * index followed by all variable values, complex (AC) values as 're,im' pairs, so a point
+ * is 1 + nvars blank, newline or comma separated tokens. File is read in chunks and
+ * numbers converted in place, data is stored as read_binary_block() does.
+ * If 'store' is 0 the section is skipped (dataset not selected).
+ * On return file position is after the last value of the section */
+static void read_ascii_block(FILE *fd, Raw *raw, int nvars, int npoints, int ac, int store)
+{
+  Ascii_reader *r;
+  double *tmp = NULL;
+  char *tok = NULL;
+  int i, p, v, n = 0, offset = 0;
+  int range = store && !(raw->sweep1 == raw->sweep2 && raw->sweep1 == -1.0);
+
+  r = my_malloc(_ALLOC_ID_, sizeof(Ascii_reader));
+  r->fd = fd;
+  r->pos = r->len = 0;
+  r->eof = 0;
+  r->comma = 1; /* complex values are given as 're,im' */
+  if(store) {
+    tmp = my_calloc(_ALLOC_ID_, nvars, sizeof(double));
+    for(i = 0 ; i < raw->datasets; i++) offset += raw->npoints[i];
+    /* allocate storage for values block, add one data column for custom data plots */
+    if(!raw->values) raw->values = my_calloc(_ALLOC_ID_, nvars + 1, sizeof(SPICE_DATA *));
+    for(i = 0 ; i <= nvars; i++) {
+      my_realloc(_ALLOC_ID_, &raw->values[i], (offset + npoints) * sizeof(SPICE_DATA));
+    }
+  }
+  for(p = 0; p < npoints; p++) {
+    if(!(tok = ascii_token(r))) break; /* point index */
+    for(v = 0; v < nvars; v++) {
+      if(!(tok = ascii_token(r))) break;
+      if(store) tmp[v] = my_atod(tok);
+    }
+    if(!tok) break;
+    if(!store) continue;
+    if(range && (tmp[0] < raw->sweep1 || tmp[0] >= raw->sweep2)) continue;
+    store_binary_row(raw, tmp, nvars, offset + n, ac);
+    n++;
+  }
+  if(p < npoints) dbg(0, "Warning: ASCII values block is not of correct size\n");
+  if(store) {
+    if(n < npoints) for(i = 0 ; i <= nvars; i++) {
+      my_realloc(_ALLOC_ID_, &raw->values[i], (offset + n) * sizeof(SPICE_DATA));
+    }
+    raw->npoints[raw->datasets] = n;
+    my_free(_ALLOC_ID_, &tmp);
+  }
+  /* give back to stdio data read beyond last value */
+  xfseek(fd, -(long)(r->len - r->pos), SEEK_CUR);
+  my_free(_ALLOC_ID_, &r);
+}
+
+/* vcd files: digital values 0, 1 are stored as 0.0, 1.0, x and z values as VCD_X,
+ * shown as X in digital graphs with y range 0 to 1 (see get_bus_value() in draw.c) */
+#define VCD_X 0.5
+
+typedef struct {
+  int first; /* first data column of variable */
+  int width; /* number of data columns (bits, 1 for real variables) */
+  int next;  /* next variable with same vcd identifier, -1 if none */
+} Vcd_ref;
+
+static SPICE_DATA vcd_bit(int c)
+{
+  return c == '0' ? 0.0 : c == '1' ? 1.0 : VCD_X;
+}
+
+/* append value change of a vcd variable at time point 'p' */
+static void vcd_change(Vcd_signal *s, int p, SPICE_DATA v)
+{
+  if(s->n && s->point[s->n - 1] == p) { /* more changes at same time: last one wins */
+    s->val[s->n - 1] = v;
+    return;
+  }
+  if(s->n && s->val[s->n - 1] == v) return;
+  if(s->n == 0 || (s->n >= 4 && !(s->n & (s->n - 1)))) { /* grow to next power of 2 */
+    int alloc = s->n ? 2 * s->n : 4;
+    my_realloc(_ALLOC_ID_, &s->point, alloc * sizeof(int));
+    my_realloc(_ALLOC_ID_, &s->val, alloc * sizeof(SPICE_DATA));
+  }
+  s->point[s->n] = p;
+  s->val[s->n++] = v;
+}
+
+/* value of vcd variable at time point 'p': binary search in value changes */
+static SPICE_DATA vcd_value(Vcd_signal *s, int p)
+{
+  int lo = 0, hi = s->n - 1, mid;
+
+  if(s->n == 0 || s->point[0] > p) return VCD_X;
+  while(lo < hi) { /* find last change at or before p */
+    mid = (lo + hi + 1) / 2;
+    if(s->point[mid] <= p) lo = mid;
+    else hi = mid - 1;
+  }
+  return s->val[lo];
+}
+
+/* build data column 'idx' (already allocated) of vcd file from its value changes */
+static void vcd_column(Raw *raw, int idx)
+{
+  Vcd_signal *s = &raw->vcd[idx];
+  SPICE_DATA *col = raw->values[idx], v = VCD_X;
+  int k, p = 0, end;
+
+  for(k = 0; k <= s->n; k++) {
+    end = k < s->n ? s->point[k] : raw->allpoints;
+    for(; p < end; p++) col[p] = v;
+    if(k < s->n) v = s->val[k];
+  }
+}
+
+/* add data columns of a '$var type width id ref [range] $end' declaration */
+static void vcd_var(Raw *raw, Int_hashtable *ids, Vcd_ref **refs, int *nrefs, const char *scope,
+                    const char *type, int width, const char *id, char *ref, const char *range)
+{
+  int msb, lsb, k, n;
+  char *br;
+  Int_hashentry *entry;
+  Vcd_ref *r;
+
+  if(!strcmp(type, "real") || width < 1) width = 1;
+  msb = width - 1;
+  lsb = 0;
+  if(!range && (br = strchr(ref, '['))) { /* range attached to name */
+    range = br;
+    *br = '\0';
+  }
+  if(range) {
+    n = sscanf(range, "[%d:%d]", &msb, &lsb);
+    if(n == 1) lsb = msb;
+    else if(n != 2) range = NULL;
+    if(range && abs(msb - lsb) + 1 != width) { /* inconsistent range */
+      msb = width - 1;
+      lsb = 0;
+    }
+  }
+  my_realloc(_ALLOC_ID_, refs, (*nrefs + 1) * sizeof(Vcd_ref));
+  r = &(*refs)[*nrefs];
+  r->first = raw->nvars;
+  r->width = width;
+  r->next = -1;
+  if((entry = int_hash_lookup(ids, id, *nrefs, XINSERT_NOREPLACE))) { /* alias of another variable */
+    r->next = entry->value;
+    entry->value = *nrefs;
+  }
+  (*nrefs)++;
+  raw->nvars += width;
+  my_realloc(_ALLOC_ID_, &raw->names, raw->nvars * sizeof(char *));
+  for(k = 0; k < width; k++) {
+    char *name = NULL;
+    size_t len = strlen(scope) + strlen(ref) + 30;
+    name = my_malloc(_ALLOC_ID_, len);
+    if(width == 1 && !range) my_snprintf(name, len, "%s%s", scope, ref);
+    else my_snprintf(name, len, "%s%s[%d]", scope, ref, msb >= lsb ? msb - k : msb + k);
+    raw->names[r->first + k] = name;
+  }
+}
+
+/* vcd files begin with a $keyword, raw files with 'Title:' */
+static int is_vcd_file(FILE *fd)
+{
+  int c;
+
+  while((c = getc(fd)) == ' ' || c == '\t' || c == '\n' || c == '\r');
+  if(c == EOF) return 0;
+  ungetc(c, fd);
+  return c == '$';
+}
+
+/* read a vcd file. Value changes of each variable are stored in raw->vcd, the time
+ * (sweep variable) data column has a point for each time with value changes.
+ * Vectors are split in bits: name[msb] ... name[lsb], names are prefixed with
+ * the '.' separated scope path. Data columns are built from value changes only when used
+ * and values at any time point are found with a binary search (get_raw_point()).
+ * File is parsed in chunks without reading it all in memory.
+ * return 1 if data read */
+static int vcd_read(FILE *fd, Raw *raw)
+{
+  Ascii_reader *r;
+  Int_hashtable ids;
+  Int_hashentry *entry;
+  Vcd_ref *refs = NULL;
+  char *tok, *scope = NULL, *vbuf = NULL, *type = NULL, *id = NULL, *ref = NULL, *range = NULL;
+  char *ts = NULL;
+  int nrefs = 0, i, k, w, len, p = -1, defs = 1, alloc = 0, width;
+  double timescale = 1.0, t, mult;
+  SPICE_DATA *time = NULL, v;
+
+  r = my_malloc(_ALLOC_ID_, sizeof(Ascii_reader));
+  r->fd = fd;
+  r->pos = r->len = 0;
+  r->eof = 0;
+  r->comma = 0; /* comma is a valid identifier character */
+  int_hash_init(&ids, HASHSIZE);
+  my_strdup2(_ALLOC_ID_, &scope, "");
+  raw->nvars = 1;
+  raw->names = my_calloc(_ALLOC_ID_, 1, sizeof(char *));
+  my_strdup2(_ALLOC_ID_, &raw->names[0], "time");
+  while((tok = ascii_token(r))) {
+    if(tok[0] == '$') {
+      if(!strcmp(tok, "$end") || !strcmp(tok, "$dumpvars") || !strcmp(tok, "$dumpall") ||
+         !strcmp(tok, "$dumpon") || !strcmp(tok, "$dumpoff")) {
+        continue; /* value changes follow */
+      } else if(!strcmp(tok, "$enddefinitions")) {
+        defs = 0;
+        raw->vcd = my_calloc(_ALLOC_ID_, raw->nvars, sizeof(Vcd_signal));
+      } else if(defs && !strcmp(tok, "$timescale")) { /* '1ns' or '1 ns' */
+        my_strdup2(_ALLOC_ID_, &ts, "");
+        while((tok = ascii_token(r)) && strcmp(tok, "$end")) my_strcat(_ALLOC_ID_, &ts, tok);
+        timescale = my_atod(ts);
+        len = strlen(ts);
+        mult = 1.0;
+        if(len > 1 && ts[len - 1] == 's') switch(ts[len - 2]) {
+          case 'm': mult = 1e-3; break;
+          case 'u': mult = 1e-6; break;
+          case 'n': mult = 1e-9; break;
+          case 'p': mult = 1e-12; break;
+          case 'f': mult = 1e-15; break;
+        }
+        timescale = (timescale > 0.0 ? timescale : 1.0) * mult;
+      } else if(defs && !strcmp(tok, "$scope")) { /* $scope type name $end */
+        if((tok = ascii_token(r)) && (tok = ascii_token(r))) {
+          my_strcat(_ALLOC_ID_, &scope, tok);
+          my_strcat(_ALLOC_ID_, &scope, ".");
+        }
+      } else if(defs && !strcmp(tok, "$upscope")) {
+        len = strlen(scope);
+        if(len) scope[len - 1] = '\0'; /* remove trailing '.' */
+        tok = strrchr(scope, '.');
+        if(tok) tok[1] = '\0';
+        else scope[0] = '\0';
+      } else if(defs && !strcmp(tok, "$var")) { /* $var type width id ref [range] $end */
+        width = 0;
+        for(k = 0; (tok = ascii_token(r)) && strcmp(tok, "$end"); k++) {
+          if(k == 0) my_strdup2(_ALLOC_ID_, &type, tok);
+          else if(k == 1) width = atoi(tok);
+          else if(k == 2) my_strdup2(_ALLOC_ID_, &id, tok);
+          else if(k == 3) my_strdup2(_ALLOC_ID_, &ref, tok);
+          else if(k == 4) my_strdup2(_ALLOC_ID_, &range, tok);
+        }
+        if(k >= 4) vcd_var(raw, &ids, &refs, &nrefs, scope, type, width, id, ref, k > 4 ? range : NULL);
+      } else { /* $comment, $date, $version, ...: skip */
+        while((tok = ascii_token(r)) && strcmp(tok, "$end"));
+        if(!tok) break;
+      }
+      continue;
+    }
+    if(defs) continue;
+    if(tok[0] == '#') { /* new time */
+      t = my_atod(tok + 1) * timescale;
+      if(p >= 0 && t == time[p]) continue;
+      if(++p >= alloc) {
+        alloc = alloc ? 2 * alloc : 1024;
+        my_realloc(_ALLOC_ID_, &time, alloc * sizeof(SPICE_DATA));
+      }
+      time[p] = t;
+      continue;
+    }
+    if(p < 0) { /* values before first time: time 0 */
+      p = 0;
+      alloc = 1024;
+      time = my_malloc(_ALLOC_ID_, alloc * sizeof(SPICE_DATA));
+      time[0] = 0.0;
+    }
+    if(strchr("01xXzZ", tok[0])) { /* scalar value change: 0! */
+      if(!(entry = int_hash_lookup(&ids, tok + 1, 0, XLOOKUP))) continue;
+      v = vcd_bit(tok[0]);
+      for(i = entry->value; i >= 0; i = refs[i].next) {
+        for(k = 0; k < refs[i].width; k++) vcd_change(&raw->vcd[refs[i].first + k], p, v);
+      }
+    } else if(tok[0] == 'b' || tok[0] == 'B') { /* vector value change: b1010 ! */
+      my_strdup2(_ALLOC_ID_, &vbuf, tok + 1);
+      if(!(tok = ascii_token(r))) break;
+      if(!(entry = int_hash_lookup(&ids, tok, 0, XLOOKUP))) continue;
+      len = strlen(vbuf);
+      for(i = entry->value; i >= 0; i = refs[i].next) {
+        w = refs[i].width;
+        for(k = 0; k < w; k++) { /* extend with 0 if msb is 0 or 1, with x or z otherwise */
+          int c = k >= w - len ? vbuf[k - (w - len)] : vbuf[0] == '1' ? '0' : vbuf[0];
+          vcd_change(&raw->vcd[refs[i].first + k], p, vcd_bit(c));
+        }
+      }
+    } else if(tok[0] == 'r' || tok[0] == 'R') { /* real value change: r1.5 ! */
+      v = my_atod(tok + 1);
+      if(!(tok = ascii_token(r))) break;
+      if(!(entry = int_hash_lookup(&ids, tok, 0, XLOOKUP))) continue;
+      for(i = entry->value; i >= 0; i = refs[i].next) vcd_change(&raw->vcd[refs[i].first], p, v);
+    }
+  }
+  int_hash_free(&ids);
+  my_free(_ALLOC_ID_, &refs);
+  my_free(_ALLOC_ID_, &scope);
+  my_free(_ALLOC_ID_, &ts);
+  my_free(_ALLOC_ID_, &vbuf);
+  my_free(_ALLOC_ID_, &type);
+  my_free(_ALLOC_ID_, &id);
+  my_free(_ALLOC_ID_, &ref);
+  my_free(_ALLOC_ID_, &range);
+  my_free(_ALLOC_ID_, &r);
+  if(!raw->vcd || p < 0 || raw->nvars < 2) {
+    my_free(_ALLOC_ID_, &time);
+    return 0;
+  }
+  raw->datasets = 1;
+  raw->npoints = my_malloc(_ALLOC_ID_, sizeof(int));
+  raw->npoints[0] = p + 1;
+  my_strdup(_ALLOC_ID_, &raw->sim_type, "tran");
+  raw->values = my_calloc(_ALLOC_ID_, raw->nvars + 1, sizeof(SPICE_DATA *));
+  my_realloc(_ALLOC_ID_, &time, (p + 1) * sizeof(SPICE_DATA));
+  raw->values[0] = time;
+  /* extra data column for custom data plots */
+  raw->values[raw->nvars] = my_calloc(_ALLOC_ID_, p + 1, sizeof(SPICE_DATA));
+  raw->cursor_b_val = my_calloc(_ALLOC_ID_, raw->nvars, sizeof(double));
+  raw->map_col = my_malloc(_ALLOC_ID_, raw->nvars * sizeof(int));
+  raw->map_lru = my_calloc(_ALLOC_ID_, raw->nvars, sizeof(int));
+  raw->map_col[0] = -1; /* time column is never freed */
+  for(i = 1; i < raw->nvars; i++) raw->map_col[i] = i;
+  for(i = 0; i < raw->nvars; i++) int_hash_lookup(&raw->table, raw->names[i], i, XINSERT_NOREPLACE);
+  return 1;
+}
+
+/* raw_mmap mode: get value of column 'col' from binary block row starting at 'row'.
+ * Rows are not aligned in the mapped file, so use memcpy */
+static double raw_map_value(Raw *raw, const char *row, int col)
+{
+  double re, im;
+
+  if(!raw->map_ac) {
+    memcpy(&re, row + col * sizeof(double), sizeof(double));
+    return re;
+  }
+  /* AC analysis: (re, im) pairs are converted to (magnitude, phase) */
+  memcpy(&re, row + (col & ~1) * sizeof(double), sizeof(double));
+  memcpy(&im, row + (col | 1) * sizeof(double), sizeof(double));
+  if(col & 1) { /* phase */
+    if(re == 0.0 && im == 0.0) return 0.0;
+    return atan2(im, re) * 180.0 / XSCH_PI;
+  }
+  /* avoid 0 for dB calculations, but not on sweep var */
+  if(col != 0 && re == 0.0 && im == 0.0) return 1e-35f;
+  return sqrt(re * re + im * im);
+}
+
+/* raw_mmap mode: record position of binary block of current dataset and skip it */
+static void map_binary_block(FILE *fd, Raw *raw, int ac)
+{
+  size_t ofs, rowsize, avail;
+
+  ofs = xftell(fd);
+  rowsize = raw->nvars * sizeof(double);
+  avail = ofs < raw->map_size ? (raw->map_size - ofs) / rowsize : 0;
+  if(avail < (size_t)raw->npoints[raw->datasets]) {
+    dbg(0, "Warning: binary block is not of correct size\n");
+    raw->npoints[raw->datasets] = (int)avail;
+  }
+  my_realloc(_ALLOC_ID_, &raw->map_ofs, (raw->datasets + 1) * sizeof(size_t));
+  raw->map_ofs[raw->datasets] = ofs;
+  raw->map_nvars = raw->nvars;
+  raw->map_ac = ac;
+  xfseek(fd, raw->npoints[raw->datasets] * rowsize, SEEK_CUR); /* skip binary block */
+}
+
+/* raw_mmap mode: map raw file in memory. If this fails data will be read normally */
+static void map_rawfile(FILE *fd, Raw *raw)
+{
+  #ifdef __unix__
+  struct stat st;
+  void *ptr;
+
+  if(fstat(fileno(fd), &st) || st.st_size == 0) return;
+  ptr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(fd), 0);
+  if(ptr == MAP_FAILED) {
+    dbg(0, "map_rawfile(): mmap() failed, reading all data\n");
+    return;
+  }
+  raw->map = ptr;
+  raw->map_size = st.st_size;
+  raw->map_mtime = st.st_mtime;
+  raw->map_checked = 0;
+  #endif
+}
+
+static void unmap_rawfile(Raw *raw)
+{
+  #ifdef __unix__
+  if(raw->map) munmap(raw->map, raw->map_size);
+  #endif
+  raw->map = NULL;
+  raw->map_columns = raw->map_float = 0;
+  my_free(_ALLOC_ID_, &raw->map_ofs);
+  my_free(_ALLOC_ID_, &raw->map_col);
+  my_free(_ALLOC_ID_, &raw->map_lru);
+}
+
+/* raw cache file name of raw file 'f' */
+static void raw_cache_name(const char *f, char *s, size_t n)
+{
+  my_snprintf(s, n, "%s.xcache", f);
+}
+
+static int raw_map_stamp = 1; /* incremented by revalidate_raw_maps() */
+
+/* mapped raw files are checked again on next access. Called once for each
+ * xschem command and event, so data accesses do not stat() the raw file */
+void revalidate_raw_maps(void)
+{
+  raw_map_stamp++;
+}
+
+/* return 0 if mapped raw file has been truncated or rewritten (new simulation run),
+ * accessing the mapping would give garbage or a SIGBUS */
+static int map_is_valid(Raw *raw)
+{
+  struct stat st;
+  char f[PATH_MAX + 10];
+
+  if(raw->map_checked == raw_map_stamp) return raw->map_valid;
+  raw->map_checked = raw_map_stamp;
+  raw->map_valid = 1; /* also if file no more exists: mapping stays valid */
+  if(raw->map_columns) raw_cache_name(raw->rawfile, f, S(f));
+  else my_strncpy(f, raw->rawfile, S(f));
+  if(!stat(f, &st) && (st.st_size < raw->map_size || st.st_mtime != raw->map_mtime)) {
+    dbg(0, "Warning: %s changed on disk, reload it to see data\n", f);
+    raw->map_valid = 0;
+  }
+  return raw->map_valid;
+}
+
+/* lookup variable 'node' in raw file variable names, trying also upper/lower case
+ * and v(...) voltage names */
+static Int_hashentry *raw_index_lookup(Raw *raw, const char *node)
+{
+  char inode[512];
+  char vnode[512];
+  Int_hashentry *entry;
+
+  my_strncpy(inode, node, S(inode));
+  entry = int_hash_lookup(&raw->table, inode, 0, XLOOKUP);
+  if(!entry) {
+    strtoupper(inode);
+    entry = int_hash_lookup(&raw->table, inode, 0, XLOOKUP);
+  }
+  if(!entry) {
+    strtolower(inode);
+    entry = int_hash_lookup(&raw->table, inode, 0, XLOOKUP);
+  }
+  if(!entry) {
+    my_snprintf(vnode, S(vnode), "v(%s)", inode);
+    entry = int_hash_lookup(&raw->table, vnode, 0, XLOOKUP);
+  }
+  if(!entry && strstr(inode, "i(v.x")) {
+    char *ptr = inode;
+    inode[2] = 'i';
+    inode[3] = '(';
+    ptr += 2;
+    entry = int_hash_lookup(&raw->table, ptr, 0, XLOOKUP);
+  }
+  return entry;
+}
+
+/* raw_mmap mode: gather data columns listed in idx[] (already allocated in raw->values)
+ * reading mapped raw file rows only once */
+static void gather_columns(Raw *raw, int *idx, int n)
+{
+  int dset, p, i, ofs = 0;
+  size_t rowsize;
+
+  if(raw->vcd) { /* vcd file: build columns from value changes */
+    for(i = 0; i < n; i++) vcd_column(raw, idx[i]);
+    return;
+  }
+  if(n == 0 || !map_is_valid(raw)) return;
+  if(raw->map_columns) { /* raw cache file: columns are stored contiguously */
+    size_t elsize = raw->map_float ? sizeof(float) : sizeof(double);
+    for(i = 0; i < n; i++) {
+      const char *col = raw->map + raw->map_ofs[0] + (size_t)raw->map_col[idx[i]] * elsize * raw->allpoints;
+      if(raw->map_float) {
+        float f;
+        for(p = 0; p < raw->allpoints; p++) {
+          memcpy(&f, col + p * sizeof(float), sizeof(float));
+          raw->values[idx[i]][p] = (SPICE_DATA)f;
+        }
+      } else if(sizeof(SPICE_DATA) == sizeof(double)) {
+        memcpy(raw->values[idx[i]], col, raw->allpoints * sizeof(double));
+      } else {
+        double d;
+        for(p = 0; p < raw->allpoints; p++) {
+          memcpy(&d, col + p * sizeof(double), sizeof(double));
+          raw->values[idx[i]][p] = (SPICE_DATA)d;
+        }
+      }
+    }
+    return;
+  }
+  rowsize = raw->map_nvars * sizeof(double);
+  for(dset = 0; dset < raw->datasets; dset++) {
+    const char *row = raw->map + raw->map_ofs[dset];
+    for(p = 0; p < raw->npoints[dset]; p++, row += rowsize) {
+      for(i = 0; i < n; i++) {
+        raw->values[idx[i]][ofs + p] = (SPICE_DATA)raw_map_value(raw, row, raw->map_col[idx[i]]);
+      }
+    }
+    ofs += raw->npoints[dset];
+  }
+}
+
+/* use clock of raw files and data columns, for raw_max_columns and raw_memory_budget */
+static int raw_lru_stamp = 0;
+static int raw_trim_stamp = 0; /* raw_lru_stamp at last raw_trim_memory() */
+
+/* return data column of variable 'idx', gathering it from mapped file (or building it
+ * from vcd file value changes) if not yet done */
+SPICE_DATA *get_raw_column(Raw *raw, int idx)
+{
+  if(!raw || !raw->values || idx < 0 || idx > raw->nvars) return NULL;
+  if(!raw->map_col || idx == raw->nvars || raw->map_col[idx] < 0) return raw->values[idx];
+  raw->map_lru[idx] = raw->lru = ++raw_lru_stamp;
+  if(!raw->values[idx]) {
+    dbg(1, "get_raw_column(): gather %s\n", raw->names[idx]);
+    raw->values[idx] = my_calloc(_ALLOC_ID_, raw->allpoints, sizeof(SPICE_DATA));
+    gather_columns(raw, &idx, 1);
+  }
+  return raw->values[idx];
+}
+
+/* raw_mmap mode or vcd file: gather in one pass all not yet loaded columns of variables
+ * referenced in 'nodes' (a graph node attribute) */
+void raw_load_columns(Raw *raw, const char *nodes)
+{
+  char *copy = NULL, *nptr, *saven;
+  const char *tok;
+  int *idx, n = 0, i;
+  Int_hashentry *entry;
+
+  if(!raw || !raw->map_col || !raw->values || !nodes) return;
+  idx = my_malloc(_ALLOC_ID_, raw->nvars * sizeof(int));
+  my_strdup2(_ALLOC_ID_, &copy, nodes);
+  nptr = copy;
+  /* aliases, dataset numbers and expression operators simply do not match any variable */
+  while( (tok = my_strtok_r(nptr, " \t\n\"%;,", "", 0, &saven)) ) {
+    nptr = NULL;
+    if(!(entry = raw_index_lookup(raw, tok))) continue;
+    i = entry->value;
+    if(raw->map_col[i] < 0) continue;
+    raw->map_lru[i] = raw->lru = ++raw_lru_stamp;
+    if(raw->values[i] || n >= raw->nvars) continue;
+    raw->values[i] = my_calloc(_ALLOC_ID_, raw->allpoints, sizeof(SPICE_DATA));
+    idx[n++] = i;
+  }
+  dbg(1, "raw_load_columns(): gather %d columns\n", n);
+  gather_columns(raw, idx, n);
+  my_free(_ALLOC_ID_, &copy);
+  my_free(_ALLOC_ID_, &idx);
+}
+
+static Raw *lru_raw; /* raw struct being sorted by lru_cmp() */
+static int lru_cmp(const void *a, const void *b)
+{
+  return lru_raw->map_lru[*(const int *)a] - lru_raw->map_lru[*(const int *)b];
+}
+
+/* raw_mmap mode or vcd file: free least recently used data columns if more than raw_max_columns
+ * are loaded. Must be called only when no pointers to data columns are held
+ * (draw_graph_all() before drawing). Sweep variable and vectors not coming from the
+ * raw file (raw_add_vector()) are never freed. */
+static void raw_trim_columns(Raw *raw)
+{
+  int max, i, n = 0, *idx;
+
+  if(!raw || !raw->map_col || !raw->values) return;
+  max = tclgetintvar("raw_max_columns");
+  if(max <= 0) return;
+  idx = my_malloc(_ALLOC_ID_, raw->nvars * sizeof(int));
+  for(i = 1; i < raw->nvars; i++) {
+    if(raw->values[i] && raw->map_col[i] >= 0) idx[n++] = i;
+  }
+  if(n > max) {
+    lru_raw = raw;
+    qsort(idx, n, sizeof(int), lru_cmp);
+    dbg(1, "raw_trim_columns(): free %d columns\n", n - max);
+    for(i = 0; i < n - max; i++) {
+      free_raw_colcache(raw, idx[i]);
+      my_free(_ALLOC_ID_, &raw->values[idx[i]]);
+    }
+  }
+  my_free(_ALLOC_ID_, &idx);
+}
+
+/* incremented whenever raw data changes or is freed, see get_raw_stamp() */
+static int raw_data_stamp = 0;
+
+/* used to validate data drawn from raw files (graph contents cache) */
+int get_raw_stamp(void)
+{
+  return raw_data_stamp;
+}
+
+/* free cached derived data of data column 'idx', or of all columns if idx == -1.
+ * Must be called whenever data column contents change or column is freed */
+void free_raw_colcache(Raw *raw, int idx)
+{
+  int i, l;
+  Raw_colcache *cc;
+
+  raw_data_stamp++;
+  if(!raw || !raw->colcache) return;
+  for(i = 0; i < raw->nvars; i++) {
+    if((idx != -1 && i != idx) || !(cc = raw->colcache[i])) continue;
+    for(l = 0; cc->min && l < cc->levels; l++) {
+      my_free(_ALLOC_ID_, &cc->min[l]);
+      my_free(_ALLOC_ID_, &cc->max[l]);
+    }
+    for(l = 0; cc->integ && l < cc->levels; l++) {
+      my_free(_ALLOC_ID_, &cc->integ[l]);
+      my_free(_ALLOC_ID_, &cc->integ2[l]);
+    }
+    my_free(_ALLOC_ID_, &cc->min);
+    my_free(_ALLOC_ID_, &cc->max);
+    my_free(_ALLOC_ID_, &cc->integ);
+    my_free(_ALLOC_ID_, &cc->integ2);
+    my_free(_ALLOC_ID_, &cc->runs);
+    my_free(_ALLOC_ID_, &cc->lev.start);
+    my_free(_ALLOC_ID_, &cc->lev.level);
+    my_free(_ALLOC_ID_, &raw->colcache[i]);
+  }
+  if(idx == -1) my_free(_ALLOC_ID_, &raw->colcache);
+}
+
+static Raw_colcache *get_colcache(Raw *raw, int idx)
+{
+  if(!raw->colcache) raw->colcache = my_calloc(_ALLOC_ID_, raw->nvars, sizeof(Raw_colcache *));
+  if(!raw->colcache[idx]) raw->colcache[idx] = my_calloc(_ALLOC_ID_, 1, sizeof(Raw_colcache));
+  return raw->colcache[idx];
+}
+
+static int pyramid_levels(Raw *raw)
+{
+  int n, levels = 0;
+  for(n = raw->allpoints / PYRAMID_BLOCK; n > 0; n /= PYRAMID_BLOCK) levels++;
+  return levels;
+}
+
+/* build min/max pyramid of data column 'idx'. Only complete blocks are summarized */
+static void build_pyramid(Raw *raw, int idx, Raw_colcache *cc)
+{
+  SPICE_DATA *gv = raw->values[idx];
+  SPICE_DATA *min, *max;
+  int l, j, k, n;
+
+  cc->levels = pyramid_levels(raw);
+  cc->min = my_calloc(_ALLOC_ID_, cc->levels, sizeof(SPICE_DATA *));
+  cc->max = my_calloc(_ALLOC_ID_, cc->levels, sizeof(SPICE_DATA *));
+  dbg(1, "build_pyramid(): %s, levels=%d\n", raw->names[idx], cc->levels);
+  n = raw->allpoints;
+  for(l = 0; l < cc->levels; l++) {
+    /* level 0 summarizes data points, upper levels summarize previous level blocks */
+    min = l ? cc->min[l - 1] : gv;
+    max = l ? cc->max[l - 1] : gv;
+    n /= PYRAMID_BLOCK;
+    cc->min[l] = my_malloc(_ALLOC_ID_, n * sizeof(SPICE_DATA));
+    cc->max[l] = my_malloc(_ALLOC_ID_, n * sizeof(SPICE_DATA));
+    for(j = 0; j < n; j++) {
+      SPICE_DATA lo = min[j * PYRAMID_BLOCK], hi = max[j * PYRAMID_BLOCK];
+      for(k = j * PYRAMID_BLOCK + 1; k < (j + 1) * PYRAMID_BLOCK; k++) {
+        if(min[k] < lo) lo = min[k];
+        if(max[k] > hi) hi = max[k];
+      }
+      cc->min[l][j] = lo;
+      cc->max[l][j] = hi;
+    }
+  }
+}
+
+/* return 1 if data column 'idx' is strictly increasing in points range [a, b].
+ * Index of increasing runs is built on first use, so this is O(log(runs)) */
+int get_raw_run(Raw *raw, int idx, int a, int b)
+{
+  Raw_colcache *cc;
+  SPICE_DATA *gv;
+  int p, lo, hi, mid;
+
+  if(!raw || idx < 0 || idx >= raw->nvars || !(gv = raw->values[idx])) return 0;
+  cc = get_colcache(raw, idx);
+  if(!cc->runs) {
+    cc->nruns = 0;
+    for(p = 0; p < raw->allpoints; p++) {
+      if(p == 0 || gv[p] <= gv[p - 1]) {
+        if((cc->nruns & 1023) == 0) my_realloc(_ALLOC_ID_, &cc->runs, (cc->nruns + 1024) * sizeof(int));
+        cc->runs[cc->nruns++] = p;
+      }
+    }
+    dbg(1, "get_raw_run(): %s, runs=%d\n", raw->names[idx], cc->nruns);
+  }
+  if(cc->nruns == 0) return 0;
+  /* find last run starting at or before a */
+  lo = 0; hi = cc->nruns - 1;
+  while(lo < hi) {
+    mid = (lo + hi + 1) / 2;
+    if(cc->runs[mid] <= a) lo = mid;
+    else hi = mid - 1;
+  }
+  /* next run must start after b */
+  return lo + 1 >= cc->nruns || cc->runs[lo + 1] > b;
+}
+
+/* get min and max values of data column 'idx' in points range [a, b].
+ * For raw file variables a min/max pyramid is built on first use so time
+ * does not depend on the number of points in range */
+void get_raw_minmax(Raw *raw, int idx, int a, int b, double *min, double *max)
+{
+  Raw_colcache *pyr = NULL;
+  SPICE_DATA *gv = raw->values[idx];
+  int l, lev, bs, nbs, p;
+
+  if(idx < raw->nvars && b - a >= 2 * PYRAMID_BLOCK) {
+    pyr = get_colcache(raw, idx);
+    if(!pyr->min) build_pyramid(raw, idx, pyr);
+  }
+  *min = *max = gv[a];
+  for(p = a; p <= b; ) {
+    /* find biggest block starting at p and fully inside range */
+    lev = -1;
+    bs = 1;
+    if(pyr) for(l = 0, nbs = PYRAMID_BLOCK; l < pyr->levels; l++) {
+      if(p % nbs || p + nbs - 1 > b) break;
+      lev = l;
+      bs = nbs;
+      if(l + 1 < pyr->levels) nbs *= PYRAMID_BLOCK;
+    }
+    if(lev == -1) {
+      if(gv[p] < *min) *min = gv[p];
+      if(gv[p] > *max) *max = gv[p];
+    } else {
+      if(pyr->min[lev][p / bs] < *min) *min = pyr->min[lev][p / bs];
+      if(pyr->max[lev][p / bs] > *max) *max = pyr->max[lev][p / bs];
+    }
+    p += bs;
+  }
+}
+
+/* logic level runs of data column 'idx': values between vthl and vthh are 'X' (2),
+ * values above are 1, below are 0. Runs are built on first use and rebuilt only if
+ * thresholds change, so digital buses are drawn walking level transitions only.
+ * Returned pointer is valid until column cache is freed */
+Raw_levels *get_raw_levels(Raw *raw, int idx, double vthl, double vthh)
+{
+  Raw_levels *lv;
+  SPICE_DATA *gv;
+  int p;
+  char l, prev = -1;
+
+  if(!raw || idx < 0 || idx >= raw->nvars || raw->allpoints <= 0) return NULL;
+  lv = &get_colcache(raw, idx)->lev;
+  if(lv->start && lv->vthl == vthl && lv->vthh == vthh) return lv;
+  if(!(gv = get_raw_column(raw, idx))) return NULL; /* load mapped or vcd column if needed */
+  my_free(_ALLOC_ID_, &lv->start);
+  my_free(_ALLOC_ID_, &lv->level);
+  lv->n = 0;
+  lv->vthl = vthl;
+  lv->vthh = vthh;
+  for(p = 0; p < raw->allpoints; p++) {
+    if(gv[p] >= vthl && gv[p] <= vthh) l = 2;
+    else l = gv[p] >= vthh ? 1 : 0;
+    if(l == prev) continue;
+    if((lv->n & 1023) == 0) {
+      my_realloc(_ALLOC_ID_, &lv->start, (lv->n + 1024) * sizeof(int));
+      my_realloc(_ALLOC_ID_, &lv->level, (lv->n + 1024) * sizeof(char));
+    }
+    lv->start[lv->n] = p;
+    lv->level[lv->n++] = l;
+    prev = l;
+  }
+  dbg(1, "get_raw_levels(): %s, runs=%d\n", raw->names[idx], lv->n);
+  return lv;
+}
+
+/* index of run containing point p */
+int raw_level_run(Raw_levels *lv, int p)
+{
+  int lo = 0, hi = lv->n - 1, mid;
+  while(lo < hi) {
+    mid = (lo + hi + 1) / 2;
+    if(lv->start[mid] <= p) lo = mid;
+    else hi = mid - 1;
+  }
+  return lo;
+}
+
+/* build pyramid of integrals of y and y^2 of data column 'idx' versus sweep variable.
+ * Level 0 block j holds the sum over intervals [p, p + 1] with p in [j * bs, (j + 1) * bs).
+ * Intervals crossing datasets or going backwards (sweep wraps) are not integrated */
+static void build_integ_pyramid(Raw *raw, int idx, Raw_colcache *cc)
+{
+  SPICE_DATA *gv = raw->values[idx];
+  SPICE_DATA *xv = raw->values[0];
+  double *s, *s2, dx, y0, y1, a, a2;
+  int l, j, k, p, n, dset = 0, next_dset;
+
+  cc->levels = pyramid_levels(raw);
+  cc->integ = my_calloc(_ALLOC_ID_, cc->levels, sizeof(double *));
+  cc->integ2 = my_calloc(_ALLOC_ID_, cc->levels, sizeof(double *));
+  dbg(1, "build_integ_pyramid(): %s, levels=%d\n", raw->names[idx], cc->levels);
+  n = raw->allpoints;
+  next_dset = raw->npoints[0];
+  for(l = 0; l < cc->levels; l++) {
+    n /= PYRAMID_BLOCK;
+    cc->integ[l] = my_malloc(_ALLOC_ID_, n * sizeof(double));
+    cc->integ2[l] = my_malloc(_ALLOC_ID_, n * sizeof(double));
+    s = l ? cc->integ[l - 1] : NULL;
+    s2 = l ? cc->integ2[l - 1] : NULL;
+    for(j = 0; j < n; j++) {
+      a = a2 = 0.0;
+      for(k = j * PYRAMID_BLOCK; k < (j + 1) * PYRAMID_BLOCK; k++) {
+        if(l) { /* upper levels sum previous level blocks */
+          a += s[k];
+          a2 += s2[k];
+          continue;
+        }
+        p = k;
+        while(dset < raw->datasets - 1 && p >= next_dset) next_dset += raw->npoints[++dset];
+        if(p + 1 >= next_dset || (dx = xv[p + 1] - xv[p]) <= 0.0) continue;
+        y0 = gv[p];
+        y1 = gv[p + 1];
+        a += dx * (y0 + y1) * 0.5;
+        a2 += dx * (y0 * y0 + y0 * y1 + y1 * y1) / 3.0;
+      }
+      cc->integ[l][j] = a;
+      cc->integ2[l][j] = a2;
+    }
+  }
+}
+
+/* integrals of data column 'idx' (s) and of its square (s2) versus sweep variable
+ * on points range [a, b] of one dataset, using integral pyramid built on first use */
+static void get_raw_integ(Raw *raw, int idx, int a, int b, double *s, double *s2)
+{
+  Raw_colcache *pyr = NULL;
+  SPICE_DATA *gv = raw->values[idx];
+  SPICE_DATA *xv = raw->values[0];
+  int l, lev, bs, nbs, p;
+  double dx;
+
+  if(idx < raw->nvars && b - a >= 2 * PYRAMID_BLOCK) {
+    pyr = get_colcache(raw, idx);
+    if(!pyr->integ) build_integ_pyramid(raw, idx, pyr);
+  }
+  *s = *s2 = 0.0;
+  /* intervals [p, p + 1], p = a ... b - 1 */
+  for(p = a; p < b; ) {
+    lev = -1;
+    bs = 1;
+    if(pyr) for(l = 0, nbs = PYRAMID_BLOCK; l < pyr->levels; l++) {
+      if(p % nbs || p + nbs > b) break;
+      lev = l;
+      bs = nbs;
+      if(l + 1 < pyr->levels) nbs *= PYRAMID_BLOCK;
+    }
+    if(lev == -1) {
+      if((dx = xv[p + 1] - xv[p]) > 0.0) {
+        *s += dx * (gv[p] + gv[p + 1]) * 0.5;
+        *s2 += dx * (gv[p] * gv[p] + gv[p] * gv[p + 1] + gv[p + 1] * gv[p + 1]) / 3.0;
+      }
+    } else {
+      *s += pyr->integ[lev][p / bs];
+      *s2 += pyr->integ2[lev][p / bs];
+    }
+    p += bs;
+  }
+}
+
+/* statistics of data column 'idx' in dataset 'dset' for sweep variable in [x1, x2]
+ * (whole dataset if x1 > x2): stats[] = { min, max, average, rms, points }.
+ * average and rms are integrals versus sweep variable divided by the x span,
+ * Return 0 if no points in range. If sweep variable is monotonic in dataset range is found
+ * with a binary search and min/max/integrals are read from the column pyramids */
+int get_raw_stats(Raw *raw, int idx, int dset, double x1, double x2, double *stats)
+{
+  SPICE_DATA *xv, *gv;
+  int ofs = 0, ofs_end, a, b, lo, hi, mid, p, d;
+  double span, s, s2;
+
+  if(!raw || idx < 0 || idx > raw->nvars || dset < 0 || dset >= raw->datasets) return 0;
+  if(!get_raw_column(raw, 0) || !(gv = get_raw_column(raw, idx))) return 0;
+  xv = raw->values[0];
+  for(d = 0; d < dset; d++) ofs += raw->npoints[d];
+  ofs_end = ofs + raw->npoints[dset];
+  if(ofs_end <= ofs) return 0;
+  a = ofs; b = ofs_end - 1;
+  if(x1 <= x2 && get_raw_run(raw, 0, ofs, ofs_end - 1)) {
+    lo = ofs; hi = ofs_end; /* first point with x >= x1 */
+    while(lo < hi) {
+      mid = lo + (hi - lo) / 2;
+      if(xv[mid] < x1) lo = mid + 1;
+      else hi = mid;
+    }
+    a = lo;
+    lo = a; hi = ofs_end; /* first point with x > x2 */
+    while(lo < hi) {
+      mid = lo + (hi - lo) / 2;
+      if(xv[mid] <= x2) lo = mid + 1;
+      else hi = mid;
+    }
+    b = lo - 1;
+  } else if(x1 <= x2) { /* not monotonic: points in range must be contiguous */
+    for(a = ofs; a < ofs_end && (xv[a] < x1 || xv[a] > x2); a++);
+    for(b = a; b + 1 < ofs_end && xv[b + 1] >= x1 && xv[b + 1] <= x2; b++);
+  }
+  if(a > b || a >= ofs_end) return 0;
+  get_raw_minmax(raw, idx, a, b, &stats[0], &stats[1]);
+  span = xv[b] - xv[a];
+  if(span <= 0.0) { /* single point or no x span: plain averages */
+    s = s2 = 0.0;
+    for(p = a; p <= b; p++) {
+      s += gv[p];
+      s2 += gv[p] * gv[p];
+    }
+    stats[2] = s / (b - a + 1);
+    stats[3] = sqrt(s2 / (b - a + 1));
+  } else {
+    get_raw_integ(raw, idx, a, b, &s, &s2);
+    stats[2] = s / span;
+    stats[3] = sqrt(s2 / span);
+  }
+  stats[4] = b - a + 1;
+  return 1;
+}
+
+/* return value of variable 'idx' at absolute position 'point' without gathering
+ * the whole data column if raw file is mapped */
+double get_raw_point(Raw *raw, int idx, int point)
+{
+  int dset;
+
+  if(!raw || !raw->values || idx < 0 || idx > raw->nvars || point < 0 || point >= raw->allpoints) return 0.0;
+  if(raw->values[idx]) return raw->values[idx][point];
+  if(raw->vcd && idx < raw->nvars && raw->map_col[idx] >= 0) return vcd_value(&raw->vcd[idx], point);
+  if(!raw->map || idx == raw->nvars || raw->map_col[idx] < 0 || !map_is_valid(raw)) return 0.0;
+  if(raw->map_columns) { /* raw cache file */
+    const char *col = raw->map + raw->map_ofs[0];
+    float f;
+    double d;
+    if(raw->map_float) {
+      memcpy(&f, col + ((size_t)raw->map_col[idx] * raw->allpoints + point) * sizeof(float), sizeof(float));
+      return f;
+    }
+    memcpy(&d, col + ((size_t)raw->map_col[idx] * raw->allpoints + point) * sizeof(double), sizeof(double));
+    return d;
+  }
+  for(dset = 0; dset < raw->datasets - 1 && point >= raw->npoints[dset]; dset++) {
+    point -= raw->npoints[dset];
+  }
+  return raw_map_value(raw, raw->map + raw->map_ofs[dset] +
+         (size_t)point * raw->map_nvars * sizeof(double), raw->map_col[idx]);
+}
+
+/* raw_mmap mode: setup data columns after all datasets have been indexed.
+ * only sweep variable (needed by all graphs) is read now */
+static void map_data_columns(Raw *raw)
+{
+  int i;
+  raw->values = my_calloc(_ALLOC_ID_, raw->nvars + 1, sizeof(SPICE_DATA *));
+  raw->map_col = my_malloc(_ALLOC_ID_, raw->nvars * sizeof(int));
+  raw->map_lru = my_calloc(_ALLOC_ID_, raw->nvars, sizeof(int));
+  for(i = 0; i < raw->nvars; i++) raw->map_col[i] = i;
+  /* extra data column for custom data plots */
+  raw->values[raw->nvars] = my_calloc(_ALLOC_ID_, raw->allpoints, sizeof(SPICE_DATA));
+  get_raw_column(raw, 0);
+}
+
+/* raw cache: a column major copy of the loaded raw file data ("<rawfile>.xcache"), written
+ * after reading a raw file if raw_cache is set. Data is stored after AC magnitude/phase
+ * conversion, as double or as float (raw_cache_float), so next time the raw file is read
+ * columns are simply copied (or mapped if raw_mmap is set).
+ * Cache file is used only if raw file size, modification time and sample hash
+ * and the requested analysis type match. Format:
+ *
+ * xschem_rawcache 1
+ * rawsize 123456
+ * rawmtime 1700000000
+ * rawhash 2309133113
+ * type tran
+ * sim_type tran
+ * float 0
+ * nvars 3
+ * datasets 2
+ * npoints 101 99
+ * time
+ * v(a)
+ * v(b)
+ * data
+ * <binary data aligned to 8 bytes: nvars columns of all datasets points>
+ */
+#define RAW_CACHE_MAGIC "xschem_rawcache 1\n"
+#define RAW_CACHE_BATCH 64 /* data columns gathered at once from mapped raw file */
+#define RAW_CACHE_SAMPLE 65536 /* bytes hashed at beginning and end of raw file */
+
+static int no_raw_cache = 0; /* set while reading temporary raw files */
+static int force_raw_map = 0; /* map raw file also if raw_mmap not set (raw_to_vcd()) */
+
+/* hash of first and last RAW_CACHE_SAMPLE bytes of raw file */
+static unsigned int raw_sample_hash(FILE *fd, size_t size)
+{
+  unsigned int h = 5381;
+  unsigned char *buf;
+  size_t n, i;
+  int k;
+
+  buf = my_malloc(_ALLOC_ID_, RAW_CACHE_SAMPLE);
+  for(k = 0; k < 2; k++) {
+    if(k == 1 && size <= RAW_CACHE_SAMPLE) break;
+    xfseek(fd, k == 0 ? 0 : size - RAW_CACHE_SAMPLE, SEEK_SET);
+    n = fread(buf, 1, RAW_CACHE_SAMPLE, fd);
+    for(i = 0; i < n; i++) h += (h << 5) + buf[i];
+  }
+  my_free(_ALLOC_ID_, &buf);
+  xfseek(fd, 0, SEEK_SET);
+  return h;
+}
+
+/* load raw data from raw cache of raw file 'f' (opened as 'fd') if valid.
+ * return 1 if data loaded */
+static int read_raw_cache(const char *f, FILE *fd, Raw *raw, const char *type)
+{
+  char cname[PATH_MAX + 10];
+  char *line = NULL, *ptr, *end;
+  FILE *cfd;
+  struct stat st, cst;
+  int ok = 1, nvars = 0, datasets = 0, fl = 0, i, p, n = 0, allpoints = 0, names = 0;
+  unsigned long size = 0, mtime = 0;
+  unsigned int hash = 0;
+  size_t ofs, elsize;
+  void *buf;
+
+  raw_cache_name(f, cname, S(cname));
+  if(fstat(fileno(fd), &st) || stat(cname, &cst)) return 0;
+  if(!(cfd = fopen(cname, fopen_read_mode))) return 0;
+  if(!(line = my_fgets(cfd, NULL)) || strcmp(line, RAW_CACHE_MAGIC)) ok = 0;
+  my_free(_ALLOC_ID_, &line);
+  /* header lines */
+  while(ok && (line = my_fgets(cfd, NULL))) {
+    if((ptr = strchr(line, '\n'))) *ptr = '\0';
+    if(names && n < nvars) { /* variable names follow npoints, may be any string */
+      if(!raw->names) raw->names = my_calloc(_ALLOC_ID_, nvars, sizeof(char *));
+      my_strdup2(_ALLOC_ID_, &raw->names[n], line);
+      n++;
+    }
+    else if(!strcmp(line, "data")) break;
+    else if(!strncmp(line, "rawsize ", 8)) size = strtoul(line + 8, NULL, 10);
+    else if(!strncmp(line, "rawmtime ", 9)) mtime = strtoul(line + 9, NULL, 10);
+    else if(!strncmp(line, "rawhash ", 8)) hash = (unsigned int)strtoul(line + 8, NULL, 10);
+    else if(!strncmp(line, "type ", 5)) ok = !strcmp(line + 5, type ? type : "-");
+    else if(!strncmp(line, "sim_type ", 9)) my_strdup(_ALLOC_ID_, &raw->sim_type, line + 9);
+    else if(!strncmp(line, "float ", 6)) fl = atoi(line + 6);
+    else if(!strncmp(line, "nvars ", 6)) nvars = atoi(line + 6);
+    else if(!strncmp(line, "datasets ", 9)) {
+      datasets = atoi(line + 9);
+      if(datasets > 0) raw->npoints = my_calloc(_ALLOC_ID_, datasets, sizeof(int));
+    }
+    else if(!strncmp(line, "npoints ", 8) && raw->npoints) {
+      ptr = line + 8;
+      for(i = 0; i < datasets; i++) {
+        raw->npoints[i] = (int)strtol(ptr, &end, 10);
+        if(end == ptr) break;
+        allpoints += raw->npoints[i];
+        ptr = end;
+      }
+      if(i < datasets) ok = 0;
+      names = 1;
+    }
+    my_free(_ALLOC_ID_, &line);
+  }
+  if(line) my_free(_ALLOC_ID_, &line);
+  else ok = 0; /* no data line */
+  if(ok) ok = nvars > 0 && datasets > 0 && n == nvars && raw->sim_type;
+  if(ok) ok = size == (unsigned long)st.st_size && mtime == (unsigned long)st.st_mtime;
+  if(ok) ok = hash == raw_sample_hash(fd, st.st_size);
+  ofs = (xftell(cfd) + 7) & ~(size_t)7; /* data is aligned to 8 bytes */
+  elsize = fl ? sizeof(float) : sizeof(double);
+  if(ok) ok = (size_t)cst.st_size >= ofs + (size_t)nvars * allpoints * elsize;
+  if(!ok) {
+    dbg(1, "read_raw_cache(): %s not valid, reading raw file\n", cname);
+    for(i = 0; i < n; i++) my_free(_ALLOC_ID_, &raw->names[i]);
+    my_free(_ALLOC_ID_, &raw->names);
+    my_free(_ALLOC_ID_, &raw->npoints);
+    my_free(_ALLOC_ID_, &raw->sim_type);
+    fclose(cfd);
+    return 0;
+  }
+  raw->nvars = nvars;
+  raw->datasets = datasets;
+  raw->allpoints = allpoints;
+  raw->cursor_b_val = my_calloc(_ALLOC_ID_, nvars, sizeof(double));
+  for(i = 0; i < nvars; i++) int_hash_lookup(&raw->table, raw->names[i], i, XINSERT_NOREPLACE);
+  #ifdef __unix__
+  if(tclgetboolvar("raw_mmap")) { /* columns will be copied from mapped cache file when used */
+    void *map = mmap(NULL, cst.st_size, PROT_READ, MAP_PRIVATE, fileno(cfd), 0);
+    if(map != MAP_FAILED) {
+      raw->map = map;
+      raw->map_size = cst.st_size;
+      raw->map_mtime = cst.st_mtime;
+      raw->map_checked = 0;
+      raw->map_ofs = my_malloc(_ALLOC_ID_, sizeof(size_t));
+      raw->map_ofs[0] = ofs;
+      raw->map_nvars = nvars;
+      raw->map_columns = 1;
+      raw->map_float = fl;
+      fclose(cfd);
+      dbg(1, "read_raw_cache(): mapped %s\n", cname);
+      return 1;
+    }
+  }
+  #endif
+  /* read all columns */
+  raw->values = my_calloc(_ALLOC_ID_, nvars + 1, sizeof(SPICE_DATA *));
+  buf = my_malloc(_ALLOC_ID_, allpoints * elsize);
+  xfseek(cfd, ofs, SEEK_SET);
+  for(i = 0; i <= nvars; i++) {
+    raw->values[i] = my_calloc(_ALLOC_ID_, allpoints, sizeof(SPICE_DATA));
+    if(i == nvars) break; /* custom data plots column */
+    if(fread(buf, elsize, allpoints, cfd) != (size_t)allpoints) {
+      dbg(0, "read_raw_cache(): short read from %s\n", cname);
+      continue;
+    }
+    for(p = 0; p < allpoints; p++) {
+      if(fl) raw->values[i][p] = (SPICE_DATA)((float *)buf)[p];
+      else raw->values[i][p] = (SPICE_DATA)((double *)buf)[p];
+    }
+  }
+  my_free(_ALLOC_ID_, &buf);
+  fclose(cfd);
+  dbg(1, "read_raw_cache(): read %s\n", cname);
+  return 1;
+}
+
+/* write raw cache of just read raw file 'f' (opened as 'fd'), see read_raw_cache() */
+static void write_raw_cache(const char *f, FILE *fd, Raw *raw, const char *type)
+{
+  char cname[PATH_MAX + 10], tmpname[PATH_MAX + 20];
+  FILE *cfd;
+  struct stat st;
+  int i, j, k, n, p, *idx, ok = 1;
+  int fl = tclgetboolvar("raw_cache_float");
+  float *fbuf = NULL;
+  size_t ofs;
+
+  if(fstat(fileno(fd), &st)) return;
+  if(raw->map && !map_is_valid(raw)) return;
+  raw_cache_name(f, cname, S(cname));
+  my_snprintf(tmpname, S(tmpname), "%s.tmp", cname);
+  if(!(cfd = fopen(tmpname, "wb"))) {
+    dbg(0, "write_raw_cache(): can not write %s\n", tmpname);
+    return;
+  }
+  fputs(RAW_CACHE_MAGIC, cfd);
+  fprintf(cfd, "rawsize %lu\nrawmtime %lu\n", (unsigned long)st.st_size, (unsigned long)st.st_mtime);
+  fprintf(cfd, "rawhash %u\n", raw_sample_hash(fd, st.st_size));
+  fprintf(cfd, "type %s\nsim_type %s\nfloat %d\n", type ? type : "-", raw->sim_type, fl);
+  fprintf(cfd, "nvars %d\ndatasets %d\nnpoints", raw->nvars, raw->datasets);
+  for(i = 0; i < raw->datasets; i++) fprintf(cfd, " %d", raw->npoints[i]);
+  fputc('\n', cfd);
+  for(i = 0; i < raw->nvars; i++) fprintf(cfd, "%s\n", raw->names[i]);
+  fputs("data\n", cfd);
+  ofs = xftell(cfd);
+  for(; ofs & 7; ofs++) fputc('\n', cfd);
+  if(fl) fbuf = my_malloc(_ALLOC_ID_, raw->allpoints * sizeof(float));
+  idx = my_malloc(_ALLOC_ID_, RAW_CACHE_BATCH * sizeof(int));
+  for(i = 0; ok && i < raw->nvars; i = j) {
+    /* raw_mmap: gather a batch of not loaded columns in one pass over mapped raw file */
+    n = 0;
+    for(j = i; j < raw->nvars && j - i < RAW_CACHE_BATCH; j++) {
+      if(raw->values[j]) continue;
+      raw->values[j] = my_calloc(_ALLOC_ID_, raw->allpoints, sizeof(SPICE_DATA));
+      idx[n++] = j;
+    }
+    gather_columns(raw, idx, n);
+    for(k = i; ok && k < j; k++) {
+      if(fl) {
+        for(p = 0; p < raw->allpoints; p++) fbuf[p] = (float)raw->values[k][p];
+        ok = fwrite(fbuf, sizeof(float), raw->allpoints, cfd) == (size_t)raw->allpoints;
+      } else if(sizeof(SPICE_DATA) == sizeof(double)) {
+        ok = fwrite(raw->values[k], sizeof(double), raw->allpoints, cfd) == (size_t)raw->allpoints;
+      } else {
+        for(p = 0; ok && p < raw->allpoints; p++) {
+          double d = raw->values[k][p];
+          ok = fwrite(&d, sizeof(double), 1, cfd) == 1;
+        }
+      }
+    }
+    for(k = 0; k < n; k++) my_free(_ALLOC_ID_, &raw->values[idx[k]]);
+  }
+  my_free(_ALLOC_ID_, &idx);
+  if(fbuf) my_free(_ALLOC_ID_, &fbuf);
+  if(fclose(cfd)) ok = 0;
+  if(ok && !rename(tmpname, cname)) {
+    dbg(1, "write_raw_cache(): written %s\n", cname);
+  } else {
+    dbg(0, "write_raw_cache(): failed to write %s\n", cname);
+    remove(tmpname);
+  }
+}
+
 /* parse ascii raw header section:
  * returns: 1 if dataset and variables were read.
  *          0 if transient sim dataset not found
@@ -496,6 +1785,8 @@ static void read_binary_block(FILE *fd, Raw *raw, int ac)
  *         156     i(v0)   current
  *         157     i(v1)   current
  * Binary:
+ *
+ * ASCII raw files have 'Values:' instead of 'Binary:' followed by point index and values
  */
 static int read_dataset(FILE *fd, Raw **rawptr, const char *type)
 { 
@@ -505,6 +1796,8 @@ static int read_dataset(FILE *fd, Raw **rawptr, const char *type)
   int exit_status = 0, npoints, nvars;
   int dbglev=1;
   const char *sim_type = NULL;
+  size_t linepos; /* file offset of current line */
+  int numpos = 0; /* offset in line of number of points */
   Raw *raw;
  
   if(!rawptr) {
@@ -521,27 +1814,40 @@ static int read_dataset(FILE *fd, Raw **rawptr, const char *type)
     if(!my_strcasecmp(type, "spectrum")) type = "ac";
     if(!my_strcasecmp(type, "sp")) type = "ac";
   }
+  linepos = xftell(fd);
   while((line = my_fgets(fd, NULL))) {
     my_strdup2(_ALLOC_ID_, &lowerline, line);
     strtolower(lowerline);
-    /* this is an ASCII raw file. We don't handle this (yet) */
+    /* after this line come ASCII values of nvars * npoints data points */
     if(!strcmp(line, "Values:\n") || !strcmp(line, "Values:\r\n")) {
-      dbg(dbglev, "read_dataset(): ASCII raw files can not be read. "
-             "Use binary format in ngspice (set filetype=binary)\n");
-      tcleval("alert_ {read_dataset(): ASCII raw files can not be read. "
-             "Use binary format in ngspice (set filetype=binary)}");
-      extra_rawfile(3, NULL, NULL, -1.0, -1.0);
-      /* free_rawfile(rawptr, 0); */
-      exit_status = 0;
-      goto read_dataset_done;
+      if(sim_type && raw->map && raw->datasets) {
+        dbg(0, "read_dataset(): ASCII dataset after mapped binary datasets, not read\n");
+        goto read_dataset_done;
+      }
+      if(sim_type) {
+        my_strdup(_ALLOC_ID_, &raw->sim_type, sim_type);
+        done_header = 1;
+        dbg(dbglev, "read_dataset(): read ASCII values, nvars=%d npoints=%d\n", nvars, npoints);
+        if(raw->map) unmap_rawfile(raw); /* ASCII data can not be mapped, read all */
+        read_ascii_block(fd, raw, nvars, npoints, ac, 1);
+        raw->datasets++;
+        exit_status = 1;
+      } else {
+        dbg(dbglev, "read_dataset(): skip ASCII values, nvars=%d npoints=%d\n", nvars, npoints);
+        read_ascii_block(fd, raw, nvars, npoints, ac, 0);
+      }
+      sim_type = NULL; /* ready for next header */
+      done_points = 0;
+      ac = 0;
     }
     /* after this line comes the binary blob made of nvars * npoints * sizeof(double) bytes */
-    if(!strcmp(line, "Binary:\n") || !strcmp(line, "Binary:\r\n")) {
+    else if(!strcmp(line, "Binary:\n") || !strcmp(line, "Binary:\r\n")) {
       if(sim_type) {
         my_strdup(_ALLOC_ID_, &raw->sim_type, sim_type);
         done_header = 1;
         dbg(dbglev, "read_dataset(): read binary block, nvars=%d npoints=%d\n", nvars, npoints);
-        read_binary_block(fd, raw, ac); 
+        if(raw->map) map_binary_block(fd, raw, ac);
+        else read_binary_block(fd, raw, ac);
         raw->datasets++;
         exit_status = 1;
       } else { 
@@ -610,7 +1916,7 @@ static int read_dataset(FILE *fd, Raw **rawptr, const char *type)
      * to skip binary blobs */
     else if(!strncmp(line, "No. of Data Rows :", 18)) {
       /* array of number of points of datasets (they are of varialbe length) */
-      n = sscanf(line, "No. of Data Rows : %d", &npoints);
+      n = sscanf(line, "No. of Data Rows : %n%d", &numpos, &npoints);
       if(n < 1) {
         dbg(0, "read_dataset(): WAARNING: malformed raw file, aborting\n");
         extra_rawfile(3, NULL, NULL, -1.0, -1.0);
@@ -621,6 +1927,7 @@ static int read_dataset(FILE *fd, Raw **rawptr, const char *type)
       if(sim_type) {
         my_realloc(_ALLOC_ID_, &raw->npoints, (raw->datasets+1) * sizeof(int));
         raw->npoints[raw->datasets] = npoints;
+        raw->follow_hdr_pos = linepos + numpos;
         /* multi-point OP is equivalent to a DC sweep. Change  sim_type */
         if(raw->npoints[raw->datasets] > 1 && !strcmp(sim_type, "op") ) {
           sim_type = "dc";
@@ -652,7 +1959,7 @@ static int read_dataset(FILE *fd, Raw **rawptr, const char *type)
       }
     }
     else if(!done_points && !strncmp(line, "No. Points:", 11)) {
-      n = sscanf(line, "No. Points: %d", &npoints);
+      n = sscanf(line, "No. Points: %n%d", &numpos, &npoints);
       if(n < 1) {
         dbg(0, "read_dataset(): WAARNING: malformed raw file, aborting\n");
         extra_rawfile(3, NULL, NULL, -1.0, -1.0);
@@ -663,6 +1970,7 @@ static int read_dataset(FILE *fd, Raw **rawptr, const char *type)
       if(sim_type) {
         my_realloc(_ALLOC_ID_, &raw->npoints, (raw->datasets+1) * sizeof(int));
         raw->npoints[raw->datasets] = npoints;
+        raw->follow_hdr_pos = linepos + numpos;
         /* multi-point OP is equivalent to a DC sweep. Change  sim_type */
         if(raw->npoints[raw->datasets] > 1 && !strcmp(sim_type, "op") ) {
           sim_type = "dc";
@@ -710,6 +2018,7 @@ static int read_dataset(FILE *fd, Raw **rawptr, const char *type)
       variables = 1 ;
     }
     my_free(_ALLOC_ID_, &line);
+    linepos = xftell(fd);
   } /*  while((line = my_fgets(fd, NULL))  */
   read_dataset_done:
   if(line) my_free(_ALLOC_ID_, &line);
@@ -722,18 +2031,15 @@ static int read_dataset(FILE *fd, Raw **rawptr, const char *type)
   return exit_status;
 }
 
-void free_rawfile(Raw **rawptr, int dr)
+/* see set_op_data() */
+static Raw *op_data_raw = NULL; /* raw file of ngspice::ngspice_data values */
+static const char *op_data_fmt = "%.4g";
+
+/* free all data of raw file, but not the Raw struct itself */
+static void free_raw_data(Raw *raw)
 {
   int i;
 
-  Raw *raw;
-  if(!rawptr || !*rawptr) {
-    dbg(0, "free_rawfile(): no raw file to clear\n");
-    if(dr) draw();
-    return;
-  }
-  raw = *rawptr;
-  dbg(0, "free_rawfile(): clearing data\n");
   if(raw->names) {
     for(i = 0 ; i < raw->nvars; ++i) {
       my_free(_ALLOC_ID_, &raw->names[i]);
@@ -748,11 +2054,35 @@ void free_rawfile(Raw **rawptr, int dr)
     }
     my_free(_ALLOC_ID_, &raw->values);
   }
+  if(raw->vcd) {
+    for(i = 0 ; i < raw->nvars; ++i) {
+      my_free(_ALLOC_ID_, &raw->vcd[i].point);
+      my_free(_ALLOC_ID_, &raw->vcd[i].val);
+    }
+    my_free(_ALLOC_ID_, &raw->vcd);
+  }
+  free_raw_colcache(raw, -1);
+  free_expr_cache(raw);
+  unmap_rawfile(raw);
   if(raw->sim_type) my_free(_ALLOC_ID_, &raw->sim_type);
   if(raw->npoints) my_free(_ALLOC_ID_, &raw->npoints);
   if(raw->rawfile) my_free(_ALLOC_ID_, &raw->rawfile);
   if(raw->schname) my_free(_ALLOC_ID_, &raw->schname);
   if(raw->table.table) int_hash_free(&raw->table);
+}
+
+void free_rawfile(Raw **rawptr, int dr)
+{
+  Raw *raw;
+  if(!rawptr || !*rawptr) {
+    dbg(0, "free_rawfile(): no raw file to clear\n");
+    if(dr) draw();
+    return;
+  }
+  raw = *rawptr;
+  dbg(0, "free_rawfile(): clearing data\n");
+  if(raw == op_data_raw) op_data_raw = NULL; /* ngspice::ngspice_data values no more available */
+  free_raw_data(raw);
   my_free(_ALLOC_ID_, rawptr);
 
   if(has_x) {
@@ -825,7 +2155,9 @@ int raw_read_from_attr(Raw **rawptr, const char *type, double sweep1, double swe
         fwrite(s, decoded_length, 1, fd);
         fclose(fd);
         my_free(_ALLOC_ID_, &s);
+        no_raw_cache = 1; /* do not write a cache of a temporary file */
         res = raw_read(tmp_filename, rawptr, type, sweep1, sweep2);
+        no_raw_cache = 0;
         unlink(tmp_filename);
       } else {
         dbg(0, "raw_read_from_attr(): failed to open file %s for reading\n", tmp_filename);
@@ -841,8 +2173,10 @@ int raw_add_vector(const char *varname, const char *expr)
   int res = 0;
   Raw *raw = xctx->raw;
   if(!raw || !raw->values) return 0;
+  raw->modified = 1;
 
   if(!int_hash_lookup(&raw->table, varname, 0, XLOOKUP)) {
+    free_expr_cache(raw); /* expressions using 'varname' may now be evaluated */
     raw->nvars++;
     my_realloc(_ALLOC_ID_, &raw->names, raw->nvars * sizeof(char *));
     my_realloc(_ALLOC_ID_, &raw->cursor_b_val, raw->nvars * sizeof(double));
@@ -850,12 +2184,29 @@ int raw_add_vector(const char *varname, const char *expr)
     raw->names[raw->nvars - 1] = NULL;
     my_strdup2(_ALLOC_ID_, &raw->names[raw->nvars - 1], varname);
     int_hash_lookup(&raw->table, raw->names[raw->nvars - 1], raw->nvars - 1, XINSERT_NOREPLACE);
+    if(raw->map_col) {
+      my_realloc(_ALLOC_ID_, &raw->map_col, raw->nvars * sizeof(int));
+      my_realloc(_ALLOC_ID_, &raw->map_lru, raw->nvars * sizeof(int));
+      raw->map_col[raw->nvars - 1] = -1; /* not in raw file */
+      raw->map_lru[raw->nvars - 1] = 0;
+    }
+    if(raw->vcd) {
+      my_realloc(_ALLOC_ID_, &raw->vcd, raw->nvars * sizeof(Vcd_signal));
+      memset(&raw->vcd[raw->nvars - 1], 0, sizeof(Vcd_signal));
+    }
+    if(raw->colcache) {
+      my_realloc(_ALLOC_ID_, &raw->colcache, raw->nvars * sizeof(Raw_colcache *));
+      raw->colcache[raw->nvars - 1] = NULL;
+    }
     my_realloc(_ALLOC_ID_, &raw->values, (raw->nvars + 1) * sizeof(SPICE_DATA *));
     raw->values[raw->nvars] = NULL;
     my_realloc(_ALLOC_ID_, &raw->values[raw->nvars], raw->allpoints * sizeof(SPICE_DATA));
+    raw->follow_alloc = raw->allpoints; /* new column has no spare room */
     res = 1;
   }
   if(expr) {
+    free_raw_colcache(raw, int_hash_lookup(&raw->table, varname, 0, XLOOKUP)->value);
+    free_expr_cache(raw); /* results of expressions using 'varname' change */
     plot_raw_custom_data(0, 0, raw->allpoints -1, expr, varname);
   } else if(res == 1) {
     for(f = 0; f < raw->allpoints; f++) {
@@ -865,6 +2216,90 @@ int raw_add_vector(const char *varname, const char *expr)
   return res;
 }
 
+/* follow mode: read data rows appended to the last dataset of raw file by a still
+ * running simulation, without reading again data already loaded.
+ * Simulators write the final 'No. Points:' value when the dataset is complete.
+ * return number of new points, 0 if no new data, -1 if dataset is complete or
+ * can not be followed */
+int raw_follow(Raw *raw)
+{
+  FILE *fd;
+  int i, p, dset, npoints = 0, avail, chunk;
+  size_t rowsize, size;
+  double *tmp;
+
+  if(!raw || !raw->values || !raw->rawfile || !raw->datasets) return -1;
+  if(raw->map || !(raw->sweep1 == raw->sweep2 && raw->sweep1 == -1.0)) {
+    dbg(0, "raw_follow(): follow mode not available with raw_mmap or sweep range\n");
+    return -1;
+  }
+  if(!raw->follow_pos) return -1; /* not a binary raw file */
+  fd = fopen(raw->rawfile, fopen_read_mode);
+  if(!fd) {
+    dbg(0, "raw_follow(): failed to open file %s for reading\n", raw->rawfile);
+    return -1;
+  }
+  dset = raw->datasets - 1;
+  if(raw->follow_hdr_pos && !xfseek(fd, raw->follow_hdr_pos, SEEK_SET)) {
+    if(fscanf(fd, "%d", &npoints) != 1) npoints = 0;
+  }
+  xfseek(fd, 0, SEEK_END);
+  size = xftell(fd);
+  if(size < raw->follow_pos) {
+    dbg(0, "raw_follow(): raw file %s has been overwritten\n", raw->rawfile);
+    fclose(fd);
+    return -1;
+  }
+  rowsize = raw->follow_nvars * sizeof(double);
+  avail = (int)((size - raw->follow_pos) / rowsize); /* complete rows written so far */
+  if(npoints > 0) { /* dataset complete: do not read beyond its data block */
+    if(avail > npoints - raw->npoints[dset]) avail = npoints - raw->npoints[dset];
+    if(avail <= 0) {
+      fclose(fd);
+      return -1;
+    }
+  }
+  if(avail <= 0) {
+    fclose(fd);
+    return 0;
+  }
+  dbg(1, "raw_follow(): reading %d new points\n", avail);
+  /* grow data columns geometrically */
+  if(raw->allpoints + avail > raw->follow_alloc) {
+    raw->follow_alloc = 2 * raw->follow_alloc;
+    if(raw->follow_alloc < raw->allpoints + avail) raw->follow_alloc = raw->allpoints + avail;
+    for(i = 0; i <= raw->nvars; i++) {
+      my_realloc(_ALLOC_ID_, &raw->values[i], raw->follow_alloc * sizeof(SPICE_DATA));
+    }
+  }
+  xfseek(fd, raw->follow_pos, SEEK_SET);
+  chunk = avail < 1024 ? avail : 1024;
+  tmp = my_malloc(_ALLOC_ID_, chunk * rowsize);
+  for(p = 0; p < avail; p += chunk) {
+    int j, n = avail - p < chunk ? avail - p : chunk;
+    if(fread(tmp, rowsize, n, fd) != (size_t)n) {
+      dbg(0, "raw_follow(): short read from %s\n", raw->rawfile);
+      avail = p;
+      break;
+    }
+    for(j = 0; j < n; j++) {
+      store_binary_row(raw, tmp + j * raw->follow_nvars, raw->follow_nvars, raw->allpoints + p + j, raw->follow_ac);
+    }
+  }
+  my_free(_ALLOC_ID_, &tmp);
+  fclose(fd);
+  /* vectors added with 'xschem raw add' are not in raw file */
+  for(i = raw->follow_nvars; i < raw->nvars; i++) {
+    for(p = raw->allpoints; p < raw->allpoints + avail; p++) raw->values[i][p] = 0.0;
+  }
+  raw->follow_pos += avail * rowsize;
+  raw->npoints[dset] += avail;
+  raw->allpoints += avail;
+  free_raw_colcache(raw, -1);
+  free_expr_cache(raw);
+  return avail;
+}
+
 /* read a ngspice raw file (with data portion in binary format) */
 int raw_read(const char *f, Raw **rawptr, const char *type, double sweep1, double sweep2)
 {
@@ -892,8 +2327,18 @@ int raw_read(const char *f, Raw **rawptr, const char *type, double sweep1, doubl
   int_hash_init(&raw->table, HASHSIZE);
   fd = fopen(f, fopen_read_mode);
   if(fd) {
-    if((res = read_dataset(fd, rawptr, type)) == 1) {
+    /* sweep1, sweep2 filtering needs all data to be read */
+    int full = sweep1 == sweep2 && sweep1 == -1.0;
+    int vcd = is_vcd_file(fd);
+    int cache = full && !vcd && !no_raw_cache && tclgetboolvar("raw_cache");
+    int cached = cache && read_raw_cache(f, fd, raw, type);
+
+    if(!cached && !vcd && full && (force_raw_map || tclgetboolvar("raw_mmap"))) map_rawfile(fd, raw);
+    if(vcd) res = (!type || !strcmp(type, "tran")) && vcd_read(fd, raw); /* sweep range not used */
+    else if(!cached) res = read_dataset(fd, rawptr, type);
+    if(cached || res == 1) {
       int i;
+      res = 1;
       set_modify(-2); /* clear text floater caches */
       my_strdup2(_ALLOC_ID_, &raw->rawfile, f);
       my_strdup2(_ALLOC_ID_, &raw->schname, xctx->sch[xctx->currsch]);
@@ -902,7 +2347,9 @@ int raw_read(const char *f, Raw **rawptr, const char *type, double sweep1, doubl
       for(i = 0; i < raw->datasets; ++i) {
         raw->allpoints +=  raw->npoints[i];
       }
-      dbg(0, "Raw file data read: %s\n", f);
+      if(raw->map) map_data_columns(raw);
+      if(cache && !cached) write_raw_cache(f, fd, raw, type);
+      dbg(0, "Raw file data read%s: %s\n", cached ? " from cache" : "", f);
       dbg(0, "points=%d, vars=%d, datasets=%d sim_type=%s\n", 
              raw->allpoints, raw->nvars, raw->datasets, raw->sim_type ? raw->sim_type : "NULL");
     } else {
@@ -925,6 +2372,105 @@ int raw_read(const char *f, Raw **rawptr, const char *type, double sweep1, doubl
   return 0;
 }
 
+/* short unique printable identifier of variable 'idx' in vcd files */
+static void vcd_id(int idx, char *id)
+{
+  static const char syms[] =
+    "0123456789abcdefghijklmnopqrstuvwxyz"
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZ=+-_)(*&^%$#@!~`:;',\"<.>/?|";
+  const int n = sizeof(syms) - 1;
+  char tmp[8];
+  int pos = 0;
+
+  do {
+    tmp[pos++] = syms[idx % n];
+    idx /= n;
+  } while(idx);
+  while(pos) *id++ = tmp[--pos];
+  *id = '\0';
+}
+
+/* convert first transient dataset of raw file 'f' to vcd file 'vcd' (same format as rawtovcd).
+ * Data rows are streamed from the mapped raw file, so memory use does not depend on raw file
+ * size (all data is read if file can not be mapped, like ASCII raw files).
+ * If vth > vtl values are converted to digital levels with hysteresis: level changes only
+ * when crossing the opposite threshold. Only value changes are written.
+ * return 1 if successfull, 0 otherwise */
+int raw_to_vcd(const char *f, const char *vcd, double vth, double vtl)
+{
+  Raw *raw = NULL;
+  FILE *fd;
+  char *ids, *outbuf, *c;
+  const char *row = NULL;
+  double *lastvalue, val;
+  unsigned char *lastbin, b = 'x';
+  int res, v, p, nvars, binary = vth > vtl, changed;
+  long t, lastt = 0;
+  const double timescale = 1e11; /* 10ps */
+  const double rel_precision = 5e-3, abs_precision = 1e-10;
+
+  force_raw_map = no_raw_cache = 1;
+  res = raw_read(f, &raw, "tran", -1.0, -1.0);
+  force_raw_map = no_raw_cache = 0;
+  if(!res) return 0;
+  if(!(fd = fopen(vcd, "w"))) {
+    dbg(0, "raw_to_vcd(): failed to open file %s for writing\n", vcd);
+    free_raw_data(raw);
+    my_free(_ALLOC_ID_, &raw);
+    return 0;
+  }
+  outbuf = my_malloc(_ALLOC_ID_, 1 << 20);
+  setvbuf(fd, outbuf, _IOFBF, 1 << 20);
+  nvars = raw->nvars;
+  ids = my_malloc(_ALLOC_ID_, nvars * 8);
+  lastvalue = my_malloc(_ALLOC_ID_, nvars * sizeof(double));
+  lastbin = my_malloc(_ALLOC_ID_, nvars);
+  fprintf(fd, "$timescale\n   10ps\n$end\n");
+  for(v = 1; v < nvars; v++) {
+    vcd_id(v, ids + v * 8);
+    fprintf(fd, "$var %s 1 %s ", binary ? "reg" : "real", ids + v * 8);
+    for(c = raw->names[v]; *c; c++) putc(*c == ':' ? '.' : *c, fd);
+    fprintf(fd, " $end\n");
+  }
+  fprintf(fd, "$enddefinitions $end\n");
+  for(p = 0; p < raw->npoints[0]; p++) {
+    if(raw->map && !raw->map_columns) row = raw->map + raw->map_ofs[0] + (size_t)p * raw->map_nvars * sizeof(double);
+    t = (long)((row ? raw_map_value(raw, row, raw->map_col[0]) : get_raw_point(raw, 0, p)) * timescale);
+    if(p == 0) fprintf(fd, "#0\n$dumpvars\n");
+    changed = 0;
+    for(v = 1; v < nvars; v++) {
+      val = row ? raw_map_value(raw, row, raw->map_col[v]) : get_raw_point(raw, v, p);
+      if(binary) {
+        b = val > vth ? '1' : val < vtl ? '0' : p ? lastbin[v] : 'x';
+        if(p && b == lastbin[v]) continue;
+        lastbin[v] = b;
+      } else {
+        if(p && !((val != 0.0 && fabs((val - lastvalue[v]) / val) > rel_precision) ||
+                  (val == 0.0 && fabs(val - lastvalue[v]) > abs_precision))) continue;
+        lastvalue[v] = val;
+      }
+      if(p && !changed && t != lastt) fprintf(fd, "#%ld\n", t);
+      changed = 1;
+      if(binary) {
+        putc(b, fd);
+        fputs(ids + v * 8, fd);
+        putc('\n', fd);
+      } else fprintf(fd, "r%.3g %s\n", val, ids + v * 8);
+    }
+    if(p == 0) fprintf(fd, "$end\n");
+    else if(changed) lastt = t;
+  }
+  fclose(fd);
+  dbg(0, "raw_to_vcd(): %d points written to %s\n", p, vcd);
+  free_raw_data(raw);
+  my_free(_ALLOC_ID_, &raw);
+  my_free(_ALLOC_ID_, &outbuf);
+  my_free(_ALLOC_ID_, &ids);
+  my_free(_ALLOC_ID_, &lastvalue);
+  my_free(_ALLOC_ID_, &lastbin);
+  return 1;
+}
+
 int raw_deletevar(const char *name)
 {
   int ret = 0;
@@ -935,8 +2481,11 @@ int raw_deletevar(const char *name)
   n = get_raw_index(name, &entry);
   if(n < 0) return ret;
   dbg(1, "n=%d, %s \n", n, entry->token);
+  raw->modified = 1;
   int_hash_lookup(&raw->table, entry->token, 0, XDELETE);
   my_free(_ALLOC_ID_, &raw->names[n]);
+  free_raw_colcache(raw, n);
+  free_expr_cache(raw); /* variable indexes change */
   for(i = n + 1; i < raw->nvars; i++) {
     int_hash_lookup(&raw->table, raw->names[i], i - 1, XINSERT); /* update hash table */
     raw->names[i - 1] = raw->names[i];
@@ -945,6 +2494,18 @@ int raw_deletevar(const char *name)
   for(i = n + 1; i <= raw->nvars; i++) {
     raw->values[i - 1] = raw->values[i];
   }
+  if(raw->map_col) for(i = n + 1; i < raw->nvars; i++) {
+    raw->map_col[i - 1] = raw->map_col[i];
+    raw->map_lru[i - 1] = raw->map_lru[i];
+  }
+  if(raw->vcd) {
+    my_free(_ALLOC_ID_, &raw->vcd[n].point);
+    my_free(_ALLOC_ID_, &raw->vcd[n].val);
+    for(i = n + 1; i < raw->nvars; i++) raw->vcd[i - 1] = raw->vcd[i];
+  }
+  if(raw->colcache) for(i = n + 1; i < raw->nvars; i++) {
+    raw->colcache[i - 1] = raw->colcache[i];
+  }
   raw->nvars--;
   my_realloc(_ALLOC_ID_, &raw->names, sizeof(char *) * raw->nvars);
   my_realloc(_ALLOC_ID_, &raw->values, sizeof(SPICE_DATA *) * raw->nvars + 1);
@@ -952,6 +2513,218 @@ int raw_deletevar(const char *name)
   return ret;
 }
 
+/* raw file memory manager: keep resident data of all loaded raw files within raw_memory_budget
+ * (MB, 0: no limit). Least recently used data columns of mapped raw files (raw_mmap) and
+ * least recently used whole raw files that are not mapped are freed. Freed columns are gathered
+ * again from the mapped file when accessed, freed raw files are read again when switching to them.
+ * Data used since previous trim (currently plotted) and the active raw file are never freed. */
+
+/* memory used by data column 'i' of raw file and its derived data */
+static size_t raw_column_size(Raw *raw, int i)
+{
+  size_t size = 0, n;
+  int l;
+  Raw_colcache *cc;
+
+  if(raw->values && raw->values[i]) size += (size_t)raw->allpoints * sizeof(SPICE_DATA);
+  if(i < raw->nvars && raw->colcache && (cc = raw->colcache[i])) {
+    n = raw->allpoints;
+    for(l = 0; l < cc->levels; l++) {
+      n /= PYRAMID_BLOCK;
+      if(cc->min) size += 2 * n * sizeof(SPICE_DATA);
+      if(cc->integ) size += 2 * n * sizeof(double);
+    }
+    size += cc->nruns * sizeof(int);
+    size += cc->lev.n * (sizeof(int) + sizeof(char));
+  }
+  return size;
+}
+
+/* resident data size of raw file, mapped raw file pages are not counted, vcd value changes are */
+static size_t raw_resident_size(Raw *raw)
+{
+  size_t size = 0;
+  int i;
+
+  if(!raw || !raw->values) return 0;
+  for(i = 0; i <= raw->nvars; i++) size += raw_column_size(raw, i);
+  if(raw->vcd) for(i = 0; i < raw->nvars; i++) {
+    size += raw->vcd[i].n * (sizeof(int) + sizeof(SPICE_DATA));
+  }
+  return size;
+}
+
+/* free all data columns of a raw file not used by graphs, it will be read again when needed */
+static void raw_evict(Raw *raw)
+{
+  int i;
+
+  dbg(1, "raw_evict(): %s %s\n", raw->rawfile, raw->sim_type ? raw->sim_type : "");
+  free_raw_colcache(raw, -1);
+  free_expr_cache(raw);
+  for(i = 0; i <= raw->nvars; i++) my_free(_ALLOC_ID_, &raw->values[i]);
+  raw->evicted = 1;
+}
+
+/* read again data of a raw file freed by raw_trim_memory(),
+ * keeping annotation state and hierarchy info */
+static void raw_reload(Raw *raw)
+{
+  Raw *tmp = NULL, *save = xctx->raw;
+  int i, ok;
+
+  dbg(1, "raw_reload(): %s %s\n", raw->rawfile, raw->sim_type ? raw->sim_type : "");
+  raw->evicted = 0;
+  if(raw->sim_type && !strcmp(raw->sim_type, "table")) {
+    xctx->raw = NULL;
+    ok = table_read(raw->rawfile);
+    tmp = xctx->raw;
+    xctx->raw = save;
+    if(tmp) my_strdup(_ALLOC_ID_, &tmp->sim_type, raw->sim_type);
+  } else {
+    ok = raw_read(raw->rawfile, &tmp, raw->sim_type, raw->sweep1, raw->sweep2);
+  }
+  if(!ok || tmp->nvars != raw->nvars) {
+    dbg(0, "raw_reload(): %s can not be read again, data no more available\n", raw->rawfile);
+    if(tmp) {
+      free_raw_data(tmp);
+      my_free(_ALLOC_ID_, &tmp);
+    }
+    for(i = 0; i < raw->datasets; i++) raw->npoints[i] = 0;
+    raw->allpoints = 0;
+    return;
+  }
+  tmp->annot_p = raw->annot_p;
+  tmp->annot_x = raw->annot_x;
+  tmp->annot_sweep_idx = raw->annot_sweep_idx;
+  tmp->level = raw->level;
+  tmp->lru = raw->lru;
+  my_free(_ALLOC_ID_, &tmp->cursor_b_val);
+  tmp->cursor_b_val = raw->cursor_b_val;
+  raw->cursor_b_val = NULL;
+  my_free(_ALLOC_ID_, &tmp->schname);
+  tmp->schname = raw->schname;
+  raw->schname = NULL;
+  free_raw_data(raw);
+  *raw = *tmp; /* raw keeps its address, referenced by xctx->extra_raw_arr[] */
+  my_free(_ALLOC_ID_, &tmp);
+}
+
+/* mark raw file as used, reading again its data if freed by raw_trim_memory() */
+static void raw_use(Raw *raw)
+{
+  if(!raw) return;
+  raw->lru = ++raw_lru_stamp;
+  if(raw->evicted) raw_reload(raw);
+}
+
+typedef struct {
+  Raw *raw;
+  int idx; /* data column, -1: whole raw file */
+  int lru;
+  size_t size;
+} Raw_victim;
+
+static int victim_cmp(const void *a, const void *b)
+{
+  return ((const Raw_victim *)a)->lru - ((const Raw_victim *)b)->lru;
+}
+
+/* apply raw_max_columns and raw_memory_budget limits. Must be called only when no
+ * pointers to data columns are held (draw_graph_all() before drawing) */
+void raw_trim_memory(void)
+{
+  Raw **raws, *raw;
+  Raw_victim *victim;
+  int nraws, i, j, n = 0, max = 0;
+  double mb = tclgetdoublevar("raw_memory_budget");
+  size_t budget = mb > 0.0 ? (size_t)(mb * 1024.0 * 1024.0) : 0, total = 0;
+
+  nraws = xctx->extra_raw_n;
+  raws = xctx->extra_raw_arr;
+  if(nraws == 0) {
+    if(!xctx->raw) return;
+    nraws = 1;
+    raws = &xctx->raw;
+  }
+  for(i = 0; i < nraws; i++) raw_trim_columns(raws[i]);
+  if(budget > 0) {
+    for(i = 0; i < nraws; i++) {
+      total += raw_resident_size(raws[i]);
+      if(raws[i]->map_col) max += raws[i]->nvars;
+      else max++;
+    }
+  }
+  if(total > budget) {
+    victim = my_malloc(_ALLOC_ID_, max * sizeof(Raw_victim));
+    for(i = 0; i < nraws; i++) {
+      raw = raws[i];
+      if(!raw->values) continue;
+      if(raw->map_col) { /* mapped or vcd data columns, not the sweep variable */
+        for(j = 1; j < raw->nvars; j++) {
+          if(!raw->values[j] || raw->map_col[j] < 0 || raw->map_lru[j] > raw_trim_stamp) continue;
+          victim[n].raw = raw;
+          victim[n].idx = j;
+          victim[n].lru = raw->map_lru[j];
+          victim[n++].size = raw_column_size(raw, j);
+        }
+      } else if(raw != xctx->raw && !raw->evicted && !raw->modified && raw->rawfile &&
+                raw->lru <= raw_trim_stamp) {
+        victim[n].raw = raw;
+        victim[n].idx = -1;
+        victim[n].lru = raw->lru;
+        victim[n++].size = raw_resident_size(raw);
+      }
+    }
+    qsort(victim, n, sizeof(Raw_victim), victim_cmp);
+    for(i = 0; i < n && total > budget; i++) {
+      if(victim[i].idx == -1) raw_evict(victim[i].raw);
+      else {
+        free_raw_colcache(victim[i].raw, victim[i].idx);
+        my_free(_ALLOC_ID_, &victim[i].raw->values[victim[i].idx]);
+      }
+      total -= victim[i].size;
+    }
+    dbg(1, "raw_trim_memory(): freed %d items, resident=%lu\n", i, (unsigned long)total);
+    if(total > budget) dbg(1, "raw_trim_memory(): plotted data exceeds raw_memory_budget\n");
+    my_free(_ALLOC_ID_, &victim);
+  }
+  raw_trim_stamp = raw_lru_stamp;
+}
+
+/* print resident memory of loaded raw files, one line for each:
+ * index rawfile sim_type resident_bytes loaded_columns columns state
+ * state is 'loaded', 'mapped' (raw_mmap), 'vcd' or 'evicted' (see raw_trim_memory())
+ * last line: total resident bytes and raw_memory_budget in bytes */
+void raw_memory_info(void)
+{
+  Raw **raws, *raw;
+  int nraws, i, j, loaded;
+  size_t size, total = 0;
+  double mb = tclgetdoublevar("raw_memory_budget");
+  char s[200];
+
+  nraws = xctx->extra_raw_n;
+  raws = xctx->extra_raw_arr;
+  if(nraws == 0 && xctx->raw) {
+    nraws = 1;
+    raws = &xctx->raw;
+  }
+  for(i = 0; i < nraws; i++) {
+    raw = raws[i];
+    size = raw_resident_size(raw);
+    total += size;
+    for(loaded = j = 0; raw->values && j < raw->nvars; j++) if(raw->values[j]) loaded++;
+    my_snprintf(s, S(s), " %lu %d %d %s\n", (unsigned long)size, loaded, raw->nvars,
+      raw->evicted ? "evicted" : raw->map ? "mapped" : raw->vcd ? "vcd" : "loaded");
+    Tcl_AppendResult(interp, my_itoa(i), " ", raw->rawfile ? raw->rawfile : "NULL", " ",
+      raw->sim_type ? raw->sim_type : "NULL", s, NULL);
+  }
+  my_snprintf(s, S(s), "total %lu budget %lu", (unsigned long)total,
+    mb > 0.0 ? (unsigned long)(mb * 1024.0 * 1024.0) : 0UL);
+  Tcl_AppendResult(interp, s, NULL);
+}
+
 /* create a new raw file with '(max - min) / step' points with only a sweep variable in it. */
 int new_rawfile(const char *name, const char *type, const char *sweepvar,
                        double start, double end, double step)
@@ -996,6 +2769,7 @@ int new_rawfile(const char *name, const char *type, const char *sweepvar,
       my_strdup2(_ALLOC_ID_, &raw->schname, xctx->sch[xctx->currsch]);
       my_strdup(_ALLOC_ID_, &raw->sim_type, type);
       raw->level = xctx->currsch;
+      raw->modified = 1; /* not from a file */
       my_realloc(_ALLOC_ID_, &raw->npoints, 1 * sizeof(int)); /* for now assume only one dataset */
       raw->datasets = 1;
       raw->allpoints = number;
@@ -1027,6 +2801,7 @@ int new_rawfile(const char *name, const char *type, const char *sweepvar,
   } else {
     ret = 0;
   }
+  raw_use(xctx->raw);
   return ret;
 }
 
@@ -1226,9 +3001,48 @@ int extra_rawfile(int what, const char *file, const char *type, double sweep1, d
   } else {
     ret = 0;
   }
+  raw_use(xctx->raw);
   return ret;
 }
 
+/* ngspice::ngspice_data tcl array of annotated values (operating point or cursor b position)
+ * is not filled when annotating: a trace sets elements from raw->cursor_b_val[] only
+ * when tcl code reads them, 'array get|names|...' commands set all elements */
+static void set_op_data_elem(Raw *raw, int i)
+{
+  char s[100];
+  my_snprintf(s, S(s), op_data_fmt, raw->cursor_b_val[i]);
+  Tcl_SetVar2(interp, "ngspice::ngspice_data", raw->names[i], s, TCL_GLOBAL_ONLY);
+}
+
+static char *op_data_trace(ClientData cd, Tcl_Interp *i, const char *name1, const char *name2, int flags)
+{
+  Raw *raw = op_data_raw;
+  Int_hashentry *entry;
+  int n;
+
+  if(!raw || !raw->names || !raw->cursor_b_val) return NULL;
+  if(name2) { /* read of an element (may not exist yet) */
+    entry = int_hash_lookup(&raw->table, name2, 0, XLOOKUP);
+    if(entry && entry->value < raw->nvars) set_op_data_elem(raw, entry->value);
+  } else { /* array command: set all elements */
+    for(n = 0; n < raw->nvars; n++) set_op_data_elem(raw, n);
+  }
+  return NULL;
+}
+
+/* (re)create ngspice::ngspice_data with values in raw->cursor_b_val[], formatted with fmt */
+void set_op_data(Raw *raw, const char *fmt)
+{
+  Tcl_UnsetVar(interp, "ngspice::ngspice_data", TCL_GLOBAL_ONLY);
+  op_data_raw = raw;
+  op_data_fmt = fmt;
+  Tcl_SetVar2(interp, "ngspice::ngspice_data", "n vars", my_itoa(raw->nvars), TCL_GLOBAL_ONLY);
+  Tcl_SetVar2(interp, "ngspice::ngspice_data", "n points", "1", TCL_GLOBAL_ONLY);
+  Tcl_TraceVar2(interp, "ngspice::ngspice_data", NULL,
+      TCL_GLOBAL_ONLY | TCL_TRACE_READS | TCL_TRACE_ARRAY, op_data_trace, NULL);
+}
+
 int update_op()
 {
   int res = 0, p = 0, i;
@@ -1237,19 +3051,101 @@ int update_op()
     xctx->raw->annot_p = 0;
     dbg(1, "update_op(): nvars=%d\n", xctx->raw->nvars);
     for(i = 0; i < xctx->raw->nvars; ++i) {
-      char s[100];
       res = 1;
-      xctx->raw->cursor_b_val[i] =  xctx->raw->values[i][p];
-      my_snprintf(s, S(s), "%.4g", xctx->raw->values[i][p]);
-      dbg(1, "%s = %g\n", xctx->raw->names[i], xctx->raw->values[i][p]);
-      tclvareval("array set ngspice::ngspice_data [list {",  xctx->raw->names[i], "} ", s, "]", NULL);
+      xctx->raw->cursor_b_val[i] = get_raw_point(xctx->raw, i, p);
+      dbg(1, "%s = %g\n", xctx->raw->names[i], xctx->raw->cursor_b_val[i]);
     }
-    tclvareval("set ngspice::ngspice_data(n\\ vars) ", my_itoa( xctx->raw->nvars), NULL);
-    tclvareval("set ngspice::ngspice_data(n\\ points) 1", NULL);
+    set_op_data(xctx->raw, "%.4g");
   } 
   return res;
 }
 
+#define TABLE_DELIM(c) ((c) == ',' || (c) == ' ' || (c) == '\t' || (c) == '\n')
+
+/* parse table file contents buf[0 ... len - 1] (not nul terminated) into raw.
+ * 'lines' is an upper bound of the number of data lines, used to allocate columns */
+static void table_parse(Raw *raw, const char *buf, size_t len, size_t lines)
+{
+  const char *line, *eol, *ptr, *end = buf + len, *tok;
+  char numbuf[100];
+  int nline = 0, field, npoints = 0, dataset_points = 0, i, nvars = 0;
+  int prev_prev_empty = 0, prev_empty = 0;
+  size_t toklen;
+  SPICE_DATA **values = NULL;
+
+  for(line = buf; line < end; line = eol + 1) {
+    int empty = 1;
+    if(!(eol = memchr(line, '\n', end - line))) eol = end;
+    if(line[0] == '#') continue;
+    for(ptr = line; ptr < eol; ptr++) { /* non empty line ? */
+      if(!TABLE_DELIM(*ptr)) {
+        empty = 0;
+        break;
+      }
+    }
+    if(empty) {
+      prev_prev_empty = prev_empty;
+      prev_empty = 1;
+      continue;
+    }
+    if(!raw->datasets || (prev_prev_empty == 1 && prev_empty == 1) ) {
+      raw->datasets++;
+      my_realloc(_ALLOC_ID_, &raw->npoints, raw->datasets * sizeof(int));
+      dataset_points = 0;
+    }
+    prev_prev_empty = prev_empty = 0;
+    field = 0;
+    for(ptr = line; ptr < eol; ) {
+      while(ptr < eol && TABLE_DELIM(*ptr)) ptr++;
+      if(ptr == eol) break;
+      tok = ptr;
+      while(ptr < eol && !TABLE_DELIM(*ptr)) ptr++;
+      toklen = ptr - tok;
+      if(nline == 0) { /* header line */
+        my_realloc(_ALLOC_ID_, &raw->names, (field + 1) * sizeof(char *));
+        raw->names[field] = my_malloc(_ALLOC_ID_, toklen + 1);
+        memcpy(raw->names[field], tok, toklen);
+        raw->names[field][toklen] = '\0';
+        int_hash_lookup(&raw->table, raw->names[field], field, XINSERT_NOREPLACE);
+        raw->nvars = field + 1;
+      } else { /* data line */
+        if(field >= nvars) break;
+        if(eol == end) { /* last line without newline: number needs a terminator */
+          if(toklen >= sizeof(numbuf)) toklen = sizeof(numbuf) - 1;
+          memcpy(numbuf, tok, toklen);
+          numbuf[toklen] = '\0';
+          tok = numbuf;
+        }
+        #if SPICE_DATA_TYPE == 1 /* float */
+        values[field][npoints] = (SPICE_DATA)my_atof(tok);
+        #else /* double */
+        values[field][npoints] = (SPICE_DATA)my_atod(tok);
+        #endif
+      }
+      ++field;
+    }
+    if(nline) { /* skip header line for npoints calculation*/
+      for(; field < nvars; field++) values[field][npoints] = 0.0; /* missing fields */
+      ++npoints;
+      dataset_points++;
+    }
+    raw->npoints[raw->datasets - 1] = dataset_points;
+    ++nline;
+    if(nline == 1) {
+      raw->values = my_calloc(_ALLOC_ID_, raw->nvars + 1, sizeof(SPICE_DATA *));
+      for(i = 0; i <= raw->nvars; i++) { /* one extra column for wave expressions */
+        my_realloc(_ALLOC_ID_, &raw->values[i], lines * sizeof(SPICE_DATA));
+      }
+      values = raw->values;
+      nvars = raw->nvars;
+    }
+  }
+  /* give back memory allocated for comment and empty lines */
+  if(raw->values && (size_t)npoints < lines) for(i = 0; i <= raw->nvars; i++) {
+    my_realloc(_ALLOC_ID_, &raw->values[i], (npoints ? npoints : 1) * sizeof(SPICE_DATA));
+  }
+}
+
 /* Read data organized as a table
  * First line is the header line containing variable names.
  * data is presented in column format after the header line
@@ -1272,15 +3168,16 @@ int update_op()
  *     0.1     0.0     1.5    0.6
  *     ...     ...     ...    ...
  *
+ * File is mapped in memory (unix) and parsed in place, data is stored directly
+ * into column arrays allocated once.
  */
 int table_read(const char *f)
 {
   int res = 0;
-  FILE *fd;
   int ufd;
   size_t lines, bytes;
-  char *line = NULL, *line_ptr, *line_save;
-  const char *line_tok;
+  char *buf = NULL;
+  int mapped = 0;
   Raw *raw;
   if(xctx->raw) {
     dbg(0, "table_read(): must clear current data file before loading new\n");
@@ -1296,104 +3193,52 @@ int table_read(const char *f)
   ufd = open(f, O_RDONLY);
   if(ufd < 0) goto err;
   count_lines_bytes(ufd, &lines, &bytes);
-  close(ufd);
-
+  lines++; /* last line may not end with a newline */
   int_hash_init(&raw->table, HASHSIZE);
-  fd = fopen(f, fopen_read_mode);
-  if(fd) {
-    int nline = 0;
-    int field;
-    int npoints = 0;
-    int dataset_points = 0;
-    int prev_prev_empty = 0, prev_empty = 0;
-    res = 1;
-    /* read data line by line */
-    while((line = my_fgets(fd, NULL))) {
-      int empty = 1;
-      if(line[0] == '#') {
-        goto clear;
-      }
-      line_ptr = line;
-      while(*line_ptr) { /* non empty line ? */
-        if(*line_ptr != ',' && *line_ptr != ' ' && *line_ptr != '\t' && *line_ptr != '\n') {
-          empty = 0;
-          break;
-        }
-        line_ptr++;
-      }
-      if(empty) {
-        prev_prev_empty = prev_empty;
-        prev_empty = 1;
-        goto clear;
-      }
-      if(!raw->datasets || (prev_prev_empty == 1 && prev_empty == 1) ) {
-        raw->datasets++;
-        my_realloc(_ALLOC_ID_, &raw->npoints, raw->datasets * sizeof(int));
-        dataset_points = 0;
-      }
-      prev_prev_empty = prev_empty = 0;
-      line_ptr = line;
-      field = 0;
-      #ifdef __unix__
-      while( (line_tok = strtok_r(line_ptr, ", \t\n", &line_save)) ) {
-      #else
-      while( (line_tok = my_strtok_r(line_ptr, ", \t\n", "", 0, &line_save)) ) {
-      #endif
-        line_ptr = NULL;
-        /* dbg(1,"%s ", line_tok); */
-        if(nline == 0) { /* header line */
-          my_realloc(_ALLOC_ID_, &raw->names, (field + 1) * sizeof(char *));
-          raw->names[field] = NULL;
-          my_strcat(_ALLOC_ID_, &raw->names[field], line_tok);
-          int_hash_lookup(&raw->table, raw->names[field], field, XINSERT_NOREPLACE);
-          raw->nvars = field + 1;
-        } else { /* data line */
-          if(field >= raw->nvars) break;
-          #if SPICE_DATA_TYPE == 1 /* float */
-          raw->values[field][npoints] = (SPICE_DATA)my_atof(line_tok);
-          #else /* double */
-          raw->values[field][npoints] = (SPICE_DATA)my_atod(line_tok);
-          #endif
-        }
-        ++field;
-      }
-      if(nline) { /* skip header line for npoints calculation*/
-        ++npoints;
-        dataset_points++;
-      }
-      raw->npoints[raw->datasets - 1] = dataset_points;
-      /* dbg(1, "\n"); */
-      ++nline;
-      if(nline == 1) {
-        int f;
-        raw->values = my_calloc(_ALLOC_ID_, raw->nvars + 1, sizeof(SPICE_DATA *));
-        for(f = 0; f <= raw->nvars; f++) { /* one extra column for wave expressions */
-          my_realloc(_ALLOC_ID_, &raw->values[f], lines * sizeof(SPICE_DATA));
-        }
+  res = 1;
+  if(bytes > 0) {
+    #ifdef __unix__
+    void *ptr = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, ufd, 0);
+    if(ptr != MAP_FAILED) {
+      buf = ptr;
+      mapped = 1;
+    }
+    #endif
+    if(!mapped) { /* read whole file */
+      FILE *fd = fopen(f, fopen_read_mode);
+      if(!fd) {
+        close(ufd);
+        goto err;
       }
-      clear:
-      my_free(_ALLOC_ID_, &line);
-    } /* while(line ....) */
+      buf = my_malloc(_ALLOC_ID_, bytes);
+      bytes = fread(buf, 1, bytes, fd);
+      fclose(fd);
+    }
+    table_parse(raw, buf, bytes, lines);
+    #ifdef __unix__
+    if(mapped) munmap(buf, bytes);
+    #endif
+    if(!mapped) my_free(_ALLOC_ID_, &buf);
+  }
+  close(ufd);
+  raw->allpoints = 0;
+  if(res == 1) {
+    int i;
+    my_strdup2(_ALLOC_ID_, &raw->rawfile, f);
+    my_strdup2(_ALLOC_ID_, &raw->schname, xctx->sch[xctx->currsch]);
+    raw->level = xctx->currsch;
     raw->allpoints = 0;
-    if(res == 1) {
-      int i;
-      my_strdup2(_ALLOC_ID_, &raw->rawfile, f);
-      my_strdup2(_ALLOC_ID_, &raw->schname, xctx->sch[xctx->currsch]);
-      raw->level = xctx->currsch;
-      raw->allpoints = 0;
-      for(i = 0; i < raw->datasets; ++i) {
-        raw->allpoints +=  raw->npoints[i];
-      }
-      dbg(0, "Table file data read: %s\n", f);
-      dbg(0, "points=%d, vars=%d, datasets=%d\n",
-             raw->allpoints, raw->nvars, raw->datasets);
-    } else {
-      dbg(0, "table_read(): no useful data found\n");
+    for(i = 0; i < raw->datasets; ++i) {
+      raw->allpoints +=  raw->npoints[i];
     }
-    raw->cursor_b_val = my_calloc(_ALLOC_ID_, raw->nvars, sizeof(double));
-    fclose(fd);
-    return res;
+    dbg(0, "Table file data read: %s\n", f);
+    dbg(0, "points=%d, vars=%d, datasets=%d\n",
+           raw->allpoints, raw->nvars, raw->datasets);
+  } else {
+    dbg(0, "table_read(): no useful data found\n");
   }
+  raw->cursor_b_val = my_calloc(_ALLOC_ID_, raw->nvars, sizeof(double));
+  return res;
   err:
   dbg(0, "table_read(): failed to open file %s for reading\n", f);
   return 0;
@@ -1402,77 +3247,52 @@ int table_read(const char *f)
 /* given a node XXyy try XXyy , xxyy, XXYY, v(XXyy), v(xxyy), V(XXYY) */
 int get_raw_index(const char *node, Int_hashentry **entry_ret)
 {
-  char inode[512];
-  char vnode[512];
   Int_hashentry *entry;
 
-
   dbg(1, "get_raw_index(): node=%s\n", node);
   if(sch_waves_loaded() >= 0) {
-    my_strncpy(inode, node, S(inode));
-    entry = int_hash_lookup(&xctx->raw->table, inode, 0, XLOOKUP);
-    if(!entry) {
-      strtoupper(inode);
-      entry = int_hash_lookup(&xctx->raw->table, inode, 0, XLOOKUP);
-    }
-    if(!entry) {
-      strtolower(inode);
-      entry = int_hash_lookup(&xctx->raw->table, inode, 0, XLOOKUP);
-    }
-    if(!entry) {
-      my_snprintf(vnode, S(vnode), "v(%s)", inode);
-      entry = int_hash_lookup(&xctx->raw->table, vnode, 0, XLOOKUP);
-    }
-    if(!entry && strstr(inode, "i(v.x")) {
-      char *ptr = inode;
-      inode[2] = 'i';
-      inode[3] = '(';
-      ptr += 2;
-      entry = int_hash_lookup(&xctx->raw->table, ptr, 0, XLOOKUP);
-    }
-
+    entry = raw_index_lookup(xctx->raw, node);
     if(entry_ret) *entry_ret = entry;
-    if(entry) return entry->value;
+    if(entry) {
+      get_raw_column(xctx->raw, entry->value); /* if raw file is mapped load data now */
+      return entry->value;
+    }
   }
   return -1;
 }
 
-/* store calculated custom graph data for later retrieval as in running average calculations 
- * what: 
- * 0: clear data
- * 1: store value
- * 2: retrieve value
- */
-static double ravg_store(int what , int i, int p, int last, double value)
-{
-  static int imax = 0;
-  static double **arr = NULL;
-  int j;
+/* point buffers of graph expression operators that look back at previous results
+ * (ravg() running integral, del() delayed values), one per operator position,
+ * indexed from first evaluated point. Kept and reused between evaluations,
+ * grown when a longer dataset is evaluated */
+static double **expr_buf = NULL;
+static int *expr_buf_size = NULL;
+static int expr_nbuf = 0;
 
-  /* 
-  dbg(0, "ravg_store: what= %d i= %d p= %d last= %d value=%g\n",
-              what, i, p, last, value);
-  */
-  if(what == 2) {
-    return arr[i][p];
-  } else if(what == 1) {
-    if(i >= imax) {
-      int new_size = i + 4;
-      my_realloc(_ALLOC_ID_, &arr, sizeof(double *) * new_size);
-      for(j = imax; j < new_size; ++j) {
-        arr[j] = my_calloc(_ALLOC_ID_, last + 1, sizeof(double));
-      }
-      imax = new_size;
-    }
-    arr[i][p] = value;
-  } else if(what == 0 && imax) {
-    for(j = 0; j < imax; ++j) {
-      my_free(_ALLOC_ID_, &arr[j]);
+static double *get_expr_buf(int i, int n)
+{
+  if(i >= expr_nbuf) {
+    my_realloc(_ALLOC_ID_, &expr_buf, (i + 1) * sizeof(double *));
+    my_realloc(_ALLOC_ID_, &expr_buf_size, (i + 1) * sizeof(int));
+    for(; expr_nbuf <= i; expr_nbuf++) {
+      expr_buf[expr_nbuf] = NULL;
+      expr_buf_size[expr_nbuf] = 0;
     }
-    my_free(_ALLOC_ID_, &arr);
-    imax = 0;
   }
-  return 0.0;
+  if(expr_buf_size[i] < n) {
+    expr_buf_size[i] = n + n / 2;
+    my_realloc(_ALLOC_ID_, &expr_buf[i], expr_buf_size[i] * sizeof(double));
+  }
+  return expr_buf[i];
+}
+
+static void free_expr_bufs(void)
+{
+  int i;
+  for(i = 0; i < expr_nbuf; i++) my_free(_ALLOC_ID_, &expr_buf[i]);
+  my_free(_ALLOC_ID_, &expr_buf);
+  my_free(_ALLOC_ID_, &expr_buf_size);
+  expr_nbuf = 0;
 }
 
 #define STACKMAX 200
@@ -1527,6 +3347,11 @@ static double ravg_store(int what , int i, int p, int last, double value)
 
 #define ORDER_DERIV 1 /* 1 or 2: 1st order or 2nd order differentiation. 1st order is faster */
 
+#define EXPR_BLOCK 256 /* number of points evaluated at once by each expression operation */
+#define EXPR_CACHE_SIZE 32 /* number of compiled expressions kept */
+#define EXPR_RESULT_CACHE_SIZE 64 /* number of expression results kept */
+#define EXPR_RESULT_MAX_POINTS 4000000 /* max total number of points of kept expression results */
+
 typedef struct {
   int i;
   double d;
@@ -1535,30 +3360,123 @@ typedef struct {
   double prevprevy;
   double prev;
   int prevp;
+  double *buf; /* see get_expr_buf() */
 } Stack1;
 
-int plot_raw_custom_data(int sweep_idx, int first, int last, const char *expr, const char *yname)
+/* compiled graph expressions, so expression strings are parsed only once */
+typedef struct {
+  Raw *raw; /* expression variables are indexes in this raw file */
+  char *expr;
+  int nops; /* -1 if expression uses variables not found in raw file */
+  Stack1 *ops;
+} Expr_cache;
+
+static Expr_cache expr_cache[EXPR_CACHE_SIZE];
+static int expr_cache_next = 0;
+
+/* graph expression results on a point range, so redraws with unchanged sweep range
+ * (cursor moves, expose events, other graphs) only copy data */
+typedef struct {
+  Raw *raw;
+  char *expr;
+  int sweep_idx, datasets, first, last; /* evaluation request */
+  int start; /* data[0] is result at point 'start' (<= first, see plot_raw_custom_data()) */
+  SPICE_DATA *data;
+  int stamp; /* last use, for LRU replacement */
+} Expr_result;
+
+static Expr_result expr_result[EXPR_RESULT_CACHE_SIZE];
+static int expr_result_stamp = 0;
+static int expr_result_points = 0; /* total stored points */
+
+static void free_expr_result(Expr_result *r)
 {
-  int i, p, idx;
-  const char *n;
-  char *endptr, *ntok_copy = NULL, *ntok_save, *ntok_ptr;
-  Stack1 stack1[STACKMAX];
-  double stack2[STACKMAX]={0}, tmp, result, avg;
-  int stackptr1 = 0, stackptr2 = 0;
-  SPICE_DATA *y;
-  SPICE_DATA *x = xctx->raw->values[sweep_idx];
-  SPICE_DATA *sweepx = xctx->raw->values[0];
+  if(!r->expr) return;
+  expr_result_points -= r->last - r->start + 1;
+  my_free(_ALLOC_ID_, &r->expr);
+  my_free(_ALLOC_ID_, &r->data);
+  r->raw = NULL;
+}
 
-  y = xctx->raw->values[xctx->raw->nvars]; /* custom plot data column */
-  if(yname != NULL) {
-    int yidx = get_raw_index(yname, NULL);
-    if(yidx >= 0) {
-      y = xctx->raw->values[yidx]; /* provided index */
+/* forget compiled expressions, expression results and graph envelopes of 'raw' (all if NULL).
+ * Must be called if raw file variables are added, deleted, changed or raw file is freed */
+void free_expr_cache(Raw *raw)
+{
+  int i;
+  for(i = 0; i < EXPR_CACHE_SIZE; i++) {
+    if(!expr_cache[i].expr || (raw && expr_cache[i].raw != raw)) continue;
+    my_free(_ALLOC_ID_, &expr_cache[i].expr);
+    my_free(_ALLOC_ID_, &expr_cache[i].ops);
+    expr_cache[i].raw = NULL;
+  }
+  for(i = 0; i < EXPR_RESULT_CACHE_SIZE; i++) {
+    if(raw && expr_result[i].raw != raw) continue;
+    free_expr_result(&expr_result[i]);
+  }
+  free_graph_envelopes(raw);
+  free_expr_bufs();
+}
+
+/* copy cached result of 'expr' evaluated on [first, last] into y[].
+ * return 1 if found, 0 otherwise */
+static int get_expr_result(const char *expr, int sweep_idx, int first, int last, SPICE_DATA *y)
+{
+  int i;
+  Expr_result *r;
+  for(i = 0; i < EXPR_RESULT_CACHE_SIZE; i++) {
+    r = &expr_result[i];
+    if(r->expr && r->raw == xctx->raw && r->sweep_idx == sweep_idx && r->first == first &&
+       r->last == last && r->datasets == xctx->raw->datasets && !strcmp(r->expr, expr)) {
+      memcpy(y + r->start, r->data, (last - r->start + 1) * sizeof(SPICE_DATA));
+      r->stamp = ++expr_result_stamp;
+      dbg(1, "get_expr_result(): cached: expr=%s, first=%d, last=%d\n", expr, first, last);
+      return 1;
     }
   }
+  return 0;
+}
+
+/* store result y[start...last] of 'expr' evaluated on [first, last], replacing least
+ * recently used results if more than EXPR_RESULT_MAX_POINTS points are stored */
+static void store_expr_result(const char *expr, int sweep_idx, int first, int last, int start, SPICE_DATA *y)
+{
+  int i, n = last - start + 1;
+  Expr_result *r, *empty;
+  if(n <= 0 || n > EXPR_RESULT_MAX_POINTS) return;
+  for(;;) {
+    r = empty = NULL;
+    for(i = 0; i < EXPR_RESULT_CACHE_SIZE; i++) {
+      if(!expr_result[i].expr) {
+        if(!empty) empty = &expr_result[i];
+      } else if(!r || expr_result[i].stamp < r->stamp) r = &expr_result[i];
+    }
+    if(empty && expr_result_points + n <= EXPR_RESULT_MAX_POINTS) break;
+    free_expr_result(r); /* least recently used */
+  }
+  r = empty;
+  r->raw = xctx->raw;
+  my_strdup2(_ALLOC_ID_, &r->expr, expr);
+  r->sweep_idx = sweep_idx;
+  r->datasets = xctx->raw->datasets;
+  r->first = first;
+  r->last = last;
+  r->start = start;
+  r->data = my_malloc(_ALLOC_ID_, n * sizeof(SPICE_DATA));
+  memcpy(r->data, y + start, n * sizeof(SPICE_DATA));
+  r->stamp = ++expr_result_stamp;
+  expr_result_points += n;
+}
+
+/* parse RPN expression into ops[] (at least STACKMAX entries).
+ * returns number of operations or -1 if expression can not be evaluated */
+static int compile_expr(const char *expr, Stack1 *ops)
+{
+  int stackptr1 = 0, idx;
+  const char *n;
+  char *endptr, *ntok_copy = NULL, *ntok_save, *ntok_ptr;
+
   my_strdup2(_ALLOC_ID_, &ntok_copy, expr);
   ntok_ptr = ntok_copy;
-  dbg(1, "plot_raw_custom_data(): expr=%s, first=%d, last=%d\n", expr, first, last);
   while( (n = my_strtok_r(ntok_ptr, " \t\n", "", 0, &ntok_save)) ) {
     if(stackptr1 >= STACKMAX -2) {
       dbg(0, "stack overflow in graph expression parsing. Interrupted\n");
@@ -1566,229 +3484,312 @@ int plot_raw_custom_data(int sweep_idx, int first, int last, const char *expr, c
       return -1;
     }
     ntok_ptr = NULL;
-    dbg(1, "  plot_raw_custom_data(): n = %s\n", n);
-    if(!strcmp(n, "+")) stack1[stackptr1++].i = PLUS;
-    else if(!strcmp(n, "==")) stack1[stackptr1++].i = EQ;
-    else if(!strcmp(n, "!=")) stack1[stackptr1++].i = NE;
-    else if(!strcmp(n, ">")) stack1[stackptr1++].i = GT;
-    else if(!strcmp(n, "<")) stack1[stackptr1++].i = LT;
-    else if(!strcmp(n, ">=")) stack1[stackptr1++].i = GE;
-    else if(!strcmp(n, "<=")) stack1[stackptr1++].i = LE;
-    else if(!strcmp(n, "-")) stack1[stackptr1++].i = MINUS;
-    else if(!strcmp(n, "*")) stack1[stackptr1++].i = MULT;
-    else if(!strcmp(n, "/")) stack1[stackptr1++].i = DIVIS;
-    else if(!strcmp(n, "**")) stack1[stackptr1++].i = POW;
-    else if(!strcmp(n, "?")) stack1[stackptr1++].i = COND; /* conditional expression */
-    else if(!strcmp(n, "atan()")) stack1[stackptr1++].i = ATAN;
-    else if(!strcmp(n, "asin()")) stack1[stackptr1++].i = ASIN;
-    else if(!strcmp(n, "acos()")) stack1[stackptr1++].i = ACOS;
-    else if(!strcmp(n, "tan()")) stack1[stackptr1++].i = TAN;
-    else if(!strcmp(n, "sin()")) stack1[stackptr1++].i = SIN;
-    else if(!strcmp(n, "cos()")) stack1[stackptr1++].i = COS;
-    else if(!strcmp(n, "abs()")) stack1[stackptr1++].i = ABS;
-    else if(!strcmp(n, "sgn()")) stack1[stackptr1++].i = SGN;
-    else if(!strcmp(n, "sqrt()")) stack1[stackptr1++].i = SQRT;
-    else if(!strcmp(n, "tanh()")) stack1[stackptr1++].i = TANH;
-    else if(!strcmp(n, "cosh()")) stack1[stackptr1++].i = COSH;
-    else if(!strcmp(n, "sinh()")) stack1[stackptr1++].i = SINH;
-    else if(!strcmp(n, "atanh()")) stack1[stackptr1++].i = ATANH;
-    else if(!strcmp(n, "acosh()")) stack1[stackptr1++].i = ACOSH;
-    else if(!strcmp(n, "asinh()")) stack1[stackptr1++].i = ASINH;
-    else if(!strcmp(n, "exp()")) stack1[stackptr1++].i = EXP;
-    else if(!strcmp(n, "ln()")) stack1[stackptr1++].i = LN;
-    else if(!strcmp(n, "log10()")) stack1[stackptr1++].i = LOG10;
-    else if(!strcmp(n, "integ()")) {
-      if(first > 0) first--;
-      stack1[stackptr1++].i = INTEG;
-    }
-    else if(!strcmp(n, "avg()")) stack1[stackptr1++].i = AVG;
-    else if(!strcmp(n, "ravg()")) stack1[stackptr1++].i = RAVG;
-    else if(!strcmp(n, "max()")) stack1[stackptr1++].i = MAX;
-    else if(!strcmp(n, "min()")) stack1[stackptr1++].i = MIN;
-    else if(!strcmp(n, "im()")) stack1[stackptr1++].i = IMAG;
-    else if(!strcmp(n, "re()")) stack1[stackptr1++].i = REAL;
-    else if(!strcmp(n, "del()")) {
-      int d, t = 0, p = 0;
-      /* set 'first' to beginning of dataset containing 'first' */
-      for(d = 0; d < xctx->raw->datasets; d++) {
-        t += xctx->raw->npoints[d];
-        if(t > first) break;
-        p = t;
-      }
-      first = p;
-      stack1[stackptr1++].i = DEL;
-    }
-    else if(!strcmp(n, "db20()")) stack1[stackptr1++].i = DB20;
-    else if(!strcmp(n, "deriv()")) {
-      stack1[stackptr1++].i = DERIV;
-      if(first > 0) first--;
-      if(first > 0) first--;
-    }
-    else if(!strcmp(n, "deriv0()")) {
-      stack1[stackptr1++].i = DERIV0;
-      if(first > 0) first--;
-      if(first > 0) first--;
-    }
-    else if(!strcmp(n, "prev()")) {
-      stack1[stackptr1++].i = PREV;
-      if(first > 0) first--;
-    }
-    else if(!strcmp(n, "exch()")) stack1[stackptr1++].i = EXCH;
-    else if(!strcmp(n, "dup()")) stack1[stackptr1++].i = DUP;
-    else if(!strcmp(n, "idx()")) stack1[stackptr1++].i = IDX;
+    dbg(1, "  compile_expr(): n = %s\n", n);
+    if(!strcmp(n, "+")) ops[stackptr1++].i = PLUS;
+    else if(!strcmp(n, "==")) ops[stackptr1++].i = EQ;
+    else if(!strcmp(n, "!=")) ops[stackptr1++].i = NE;
+    else if(!strcmp(n, ">")) ops[stackptr1++].i = GT;
+    else if(!strcmp(n, "<")) ops[stackptr1++].i = LT;
+    else if(!strcmp(n, ">=")) ops[stackptr1++].i = GE;
+    else if(!strcmp(n, "<=")) ops[stackptr1++].i = LE;
+    else if(!strcmp(n, "-")) ops[stackptr1++].i = MINUS;
+    else if(!strcmp(n, "*")) ops[stackptr1++].i = MULT;
+    else if(!strcmp(n, "/")) ops[stackptr1++].i = DIVIS;
+    else if(!strcmp(n, "**")) ops[stackptr1++].i = POW;
+    else if(!strcmp(n, "?")) ops[stackptr1++].i = COND; /* conditional expression */
+    else if(!strcmp(n, "atan()")) ops[stackptr1++].i = ATAN;
+    else if(!strcmp(n, "asin()")) ops[stackptr1++].i = ASIN;
+    else if(!strcmp(n, "acos()")) ops[stackptr1++].i = ACOS;
+    else if(!strcmp(n, "tan()")) ops[stackptr1++].i = TAN;
+    else if(!strcmp(n, "sin()")) ops[stackptr1++].i = SIN;
+    else if(!strcmp(n, "cos()")) ops[stackptr1++].i = COS;
+    else if(!strcmp(n, "abs()")) ops[stackptr1++].i = ABS;
+    else if(!strcmp(n, "sgn()")) ops[stackptr1++].i = SGN;
+    else if(!strcmp(n, "sqrt()")) ops[stackptr1++].i = SQRT;
+    else if(!strcmp(n, "tanh()")) ops[stackptr1++].i = TANH;
+    else if(!strcmp(n, "cosh()")) ops[stackptr1++].i = COSH;
+    else if(!strcmp(n, "sinh()")) ops[stackptr1++].i = SINH;
+    else if(!strcmp(n, "atanh()")) ops[stackptr1++].i = ATANH;
+    else if(!strcmp(n, "acosh()")) ops[stackptr1++].i = ACOSH;
+    else if(!strcmp(n, "asinh()")) ops[stackptr1++].i = ASINH;
+    else if(!strcmp(n, "exp()")) ops[stackptr1++].i = EXP;
+    else if(!strcmp(n, "ln()")) ops[stackptr1++].i = LN;
+    else if(!strcmp(n, "log10()")) ops[stackptr1++].i = LOG10;
+    else if(!strcmp(n, "integ()")) ops[stackptr1++].i = INTEG;
+    else if(!strcmp(n, "avg()")) ops[stackptr1++].i = AVG;
+    else if(!strcmp(n, "ravg()")) ops[stackptr1++].i = RAVG;
+    else if(!strcmp(n, "max()")) ops[stackptr1++].i = MAX;
+    else if(!strcmp(n, "min()")) ops[stackptr1++].i = MIN;
+    else if(!strcmp(n, "im()")) ops[stackptr1++].i = IMAG;
+    else if(!strcmp(n, "re()")) ops[stackptr1++].i = REAL;
+    else if(!strcmp(n, "del()")) ops[stackptr1++].i = DEL;
+    else if(!strcmp(n, "db20()")) ops[stackptr1++].i = DB20;
+    else if(!strcmp(n, "deriv()")) ops[stackptr1++].i = DERIV;
+    else if(!strcmp(n, "deriv0()")) ops[stackptr1++].i = DERIV0;
+    else if(!strcmp(n, "prev()")) ops[stackptr1++].i = PREV;
+    else if(!strcmp(n, "exch()")) ops[stackptr1++].i = EXCH;
+    else if(!strcmp(n, "dup()")) ops[stackptr1++].i = DUP;
+    else if(!strcmp(n, "idx()")) ops[stackptr1++].i = IDX;
     else if( (strtod(n, &endptr)), endptr > n) { /* NUMBER */
-      stack1[stackptr1].i = NUMBER;
-      stack1[stackptr1++].d = atof_spice(n);
+      ops[stackptr1].i = NUMBER;
+      ops[stackptr1++].d = atof_spice(n);
     }
     else { /* SPICE_NODE */
       idx = get_raw_index(n, NULL);
       if(idx == -1) {
-        dbg(1, "plot_raw_custom_data(): no data found: %s\n", n);
+        dbg(1, "compile_expr(): no data found: %s\n", n);
         my_free(_ALLOC_ID_, &ntok_copy);
         return -1; /* no data found in raw file */
       }
-      stack1[stackptr1].i = SPICE_NODE;
-      stack1[stackptr1].idx = idx;
+      ops[stackptr1].i = SPICE_NODE;
+      ops[stackptr1].idx = idx;
       stackptr1++;
     }
   } /* while(n = my_strtok_r(...) */
   my_free(_ALLOC_ID_, &ntok_copy);
-  for(p = first ; p <= last; p++) {
+  return stackptr1;
+}
+
+/* get compiled expression 'expr' for current raw file into ops[], compiling it if not cached */
+static int get_expr_program(const char *expr, Stack1 *ops)
+{
+  int i, nops;
+  Expr_cache *e;
+
+  for(i = 0; i < EXPR_CACHE_SIZE; i++) {
+    e = &expr_cache[i];
+    if(e->expr && e->raw == xctx->raw && !strcmp(e->expr, expr)) break;
+  }
+  if(i == EXPR_CACHE_SIZE) { /* not found: compile and store in next cache slot */
+    e = &expr_cache[expr_cache_next];
+    expr_cache_next = (expr_cache_next + 1) % EXPR_CACHE_SIZE;
+    my_free(_ALLOC_ID_, &e->ops);
+    e->ops = my_malloc(_ALLOC_ID_, STACKMAX * sizeof(Stack1));
+    e->nops = compile_expr(expr, e->ops);
+    e->raw = xctx->raw;
+    my_strdup2(_ALLOC_ID_, &e->expr, expr);
+  }
+  nops = e->nops;
+  if(nops > 0) memcpy(ops, e->ops, nops * sizeof(Stack1));
+  for(i = 0; i < nops; i++) {
+    /* raw_mmap: column may have been freed (raw_max_columns) since expression was compiled */
+    if(ops[i].i == SPICE_NODE) get_raw_column(xctx->raw, ops[i].idx);
+  }
+  return nops;
+}
+
+/* evaluate graph expression 'expr' on points [first, last], put result in
+ * custom data column (or column of variable 'yname' if given)
+ * Expression is compiled once (see get_expr_program()) and each operation is
+ * executed on blocks of EXPR_BLOCK points, stateful operations (integ, avg, deriv, ...)
+ * process block points in sequence */
+int plot_raw_custom_data(int sweep_idx, int first, int last, const char *expr, const char *yname)
+{
+  int i, k, p, n, b0, nops, req_first = first;
+  Stack1 stack1[STACKMAX];
+  int stackptr2 = 0;
+  double *stack2, *a, *b, *c, tmp, result, avg;
+  SPICE_DATA *y;
+  SPICE_DATA *x = xctx->raw->values[sweep_idx];
+  SPICE_DATA *sweepx = xctx->raw->values[0];
+
+  y = xctx->raw->values[xctx->raw->nvars]; /* custom plot data column */
+  if(yname != NULL) {
+    int yidx = get_raw_index(yname, NULL);
+    if(yidx >= 0) {
+      y = xctx->raw->values[yidx]; /* provided index */
+    }
+  }
+  dbg(1, "plot_raw_custom_data(): expr=%s, first=%d, last=%d\n", expr, first, last);
+  if(yname == NULL && get_expr_result(expr, sweep_idx, first, last, y)) return xctx->raw->nvars;
+  nops = get_expr_program(expr, stack1);
+  if(nops == -1) return -1;
+  /* operations using previous points start calculations before 'first' */
+  for(i = 0; i < nops; ++i) {
+    switch(stack1[i].i) {
+      case DERIV:
+      case DERIV0:
+        if(first > 0) first--;
+        if(first > 0) first--;
+        break;
+      case INTEG:
+      case PREV:
+        if(first > 0) first--;
+        break;
+      case DEL:
+        {
+          int d, t = 0, p = 0;
+          /* set 'first' to beginning of dataset containing 'first' */
+          for(d = 0; d < xctx->raw->datasets; d++) {
+            t += xctx->raw->npoints[d];
+            if(t > first) break;
+            p = t;
+          }
+          first = p;
+        }
+        break;
+    }
+    /* divide by zero returns previous result */
+    if(stack1[i].i == DIVIS) stack1[i].prev = first > 0 ? y[first - 1] : 0.0;
+    stack1[i].prevp = first;
+  }
+  for(i = 0; i < nops; ++i) {
+    if(stack1[i].i == RAVG || stack1[i].i == DEL) stack1[i].buf = get_expr_buf(i, last - first + 2);
+  }
+  /* stack of EXPR_BLOCK point vectors */
+  stack2 = my_malloc(_ALLOC_ID_, (nops + 1) * EXPR_BLOCK * sizeof(double));
+  for(b0 = first; b0 <= last; b0 += EXPR_BLOCK) {
+    n = last - b0 + 1;
+    if(n > EXPR_BLOCK) n = EXPR_BLOCK;
     stackptr2 = 0;
-    for(i = 0; i < stackptr1; ++i) {
+    for(i = 0; i < nops; ++i) {
+      /* c: top of stack, b: 2nd, a: 3rd element */
+      c = stack2 + stackptr2 * EXPR_BLOCK;
       if(stack1[i].i == NUMBER) { /* number */
-        stack2[stackptr2++] = stack1[i].d;
+        for(k = 0; k < n; k++) c[k] = stack1[i].d;
+        stackptr2++;
       }
       else if(stack1[i].i == IDX) {
-        stack2[stackptr2++] = (double)p;
+        for(k = 0; k < n; k++) c[k] = (double)(b0 + k);
+        stackptr2++;
       }
       else if(stack1[i].i == SPICE_NODE && stack1[i].idx < xctx->raw->nvars) { /* spice node */
-        stack2[stackptr2++] =  xctx->raw->values[stack1[i].idx][p];
+        SPICE_DATA *v = xctx->raw->values[stack1[i].idx] + b0;
+        for(k = 0; k < n; k++) c[k] = v[k];
+        stackptr2++;
       }
+      c = stack2 + (stackptr2 - 1) * EXPR_BLOCK;
+      b = c - EXPR_BLOCK;
+      a = b - EXPR_BLOCK;
       if(stackptr2 > 2) { /* 3 argument operators */
         if(stack1[i].i == COND) { /*  X cond Y ? --> X if conf == 1 else Y */
-          dbg(0, "%g %g %g\n",  stack2[stackptr2 - 3],  stack2[stackptr2 - 2],  stack2[stackptr2 - 1]);
-          stack2[stackptr2 - 3] = stack2[stackptr2 - 2] ? stack2[stackptr2 - 3] : stack2[stackptr2 - 1];
+          for(k = 0; k < n; k++) a[k] = b[k] ? a[k] : c[k];
           stackptr2 -= 2;
         }
       }
       if(stackptr2 > 1) { /* 2 argument operators */
         switch(stack1[i].i) {
           case PLUS:
-            stack2[stackptr2 - 2] = stack2[stackptr2 - 2] + stack2[stackptr2 - 1];
+            for(k = 0; k < n; k++) b[k] = b[k] + c[k];
             stackptr2--;
             break;
           case MINUS:
-            stack2[stackptr2 - 2] = stack2[stackptr2 - 2] - stack2[stackptr2 - 1];
+            for(k = 0; k < n; k++) b[k] = b[k] - c[k];
             stackptr2--;
             break;
           case EQ:
-            stack2[stackptr2 - 2] = (stack2[stackptr2 - 2] == stack2[stackptr2 - 1]);
+            for(k = 0; k < n; k++) b[k] = (b[k] == c[k]);
             stackptr2--;
             break;
           case NE:
-            stack2[stackptr2 - 2] = (stack2[stackptr2 - 2] != stack2[stackptr2 - 1]);
+            for(k = 0; k < n; k++) b[k] = (b[k] != c[k]);
             stackptr2--;
             break;
           case GT:
-            stack2[stackptr2 - 2] = (stack2[stackptr2 - 2] > stack2[stackptr2 - 1]);
+            for(k = 0; k < n; k++) b[k] = (b[k] > c[k]);
             stackptr2--;
             break;
           case LT:
-            stack2[stackptr2 - 2] = (stack2[stackptr2 - 2] < stack2[stackptr2 - 1]);
+            for(k = 0; k < n; k++) b[k] = (b[k] < c[k]);
             stackptr2--;
             break;
           case GE:
-            stack2[stackptr2 - 2] = (stack2[stackptr2 - 2] >= stack2[stackptr2 - 1]);
+            for(k = 0; k < n; k++) b[k] = (b[k] >= c[k]);
             stackptr2--;
             break;
           case LE:
-            stack2[stackptr2 - 2] = (stack2[stackptr2 - 2] <= stack2[stackptr2 - 1]);
+            for(k = 0; k < n; k++) b[k] = (b[k] <= c[k]);
             stackptr2--;
             break;
           case MULT:
-            stack2[stackptr2 - 2] = stack2[stackptr2 - 2] * stack2[stackptr2 - 1];
+            for(k = 0; k < n; k++) b[k] = b[k] * c[k];
             stackptr2--;
             break;
           case DIVIS:
-            if(stack2[stackptr2 - 1]) {
-              stack2[stackptr2 - 2] = stack2[stackptr2 - 2] / stack2[stackptr2 - 1];
-            } else if(stack2[stackptr2 - 2] == 0.0) {
-              stack2[stackptr2 - 2] = 0;
-            } else {
-              stack2[stackptr2 - 2] =  y[p - 1];
+            for(k = 0; k < n; k++) {
+              if(c[k]) {
+                b[k] = b[k] / c[k];
+              } else if(b[k] == 0.0) {
+                b[k] = 0;
+              } else {
+                b[k] = stack1[i].prev;
+              }
+              stack1[i].prev = b[k];
             }
             stackptr2--;
             break;
           case DEL:
-            tmp = stack2[stackptr2 - 1];
-            ravg_store(1, i, p, last, stack2[stackptr2 - 2]);
-            if(fabs(x[p] - x[first]) <= tmp) {
-              result = stack2[stackptr2 - 2];
-              stack1[i].prevp = first;
-            } else {
-              double delta =  fabs(x[p] - x[stack1[i].prevp]);
-              while(stack1[i].prevp <= last && delta > tmp) {
-                stack1[i].prevp++;
-                delta = fabs(x[p] - x[stack1[i].prevp]);
-              }
-              /* choose the closest:  stack1[i].prev or stack1[i].prev - 1 */
-              if( stack1[i].prevp > 0) {
-                double delta1 =  fabs(x[p] - x[stack1[i].prevp-1]);
-                if(fabs(delta1 - tmp) < fabs(delta - tmp)) stack1[i].prevp--;
+            for(k = 0; k < n; k++) {
+              p = b0 + k;
+              tmp = c[k];
+              stack1[i].buf[p - first] = b[k];
+              if(fabs(x[p] - x[first]) <= tmp) {
+                result = b[k];
+                stack1[i].prevp = first;
+              } else {
+                double delta =  fabs(x[p] - x[stack1[i].prevp]);
+                while(stack1[i].prevp <= last && delta > tmp) {
+                  stack1[i].prevp++;
+                  delta = fabs(x[p] - x[stack1[i].prevp]);
+                }
+                /* choose the closest:  stack1[i].prev or stack1[i].prev - 1 */
+                if( stack1[i].prevp > 0) {
+                  double delta1 =  fabs(x[p] - x[stack1[i].prevp-1]);
+                  if(fabs(delta1 - tmp) < fabs(delta - tmp)) stack1[i].prevp--;
+                }
+                result = stack1[i].buf[stack1[i].prevp - first];
               }
-              result =  ravg_store(2, i, stack1[i].prevp, 0, 0);
+              b[k] = result;
             }
-            stack2[stackptr2 - 2] = result;
             stackptr2--;
             break;
           case RAVG:
-            if( p == first ) {
-              result = 0;
-              stack1[i].prevy = stack2[stackptr2 - 2];
-              stack1[i].prev = 0;
-              stack1[i].prevp = first;
-            } else {
-              result = stack1[i].prev + (x[p] - x[p - 1]) * (stack1[i].prevy + stack2[stackptr2 - 2]) * 0.5;
-              stack1[i].prevy =  stack2[stackptr2 - 2];
-              stack1[i].prev = result;
-            }
-            ravg_store(1, i, p, last, result);
-            
-            while(stack1[i].prevp <= last && x[p] - x[stack1[i].prevp] > stack2[stackptr2 - 1]) {
-              /* dbg(1, "%g  -->  %g\n", x[stack1[i].prevp], x[p]); */
-              stack1[i].prevp++;
+            for(k = 0; k < n; k++) {
+              p = b0 + k;
+              if( p == first ) {
+                result = 0;
+                stack1[i].prevy = b[k];
+                stack1[i].prev = 0;
+                stack1[i].prevp = first;
+              } else {
+                result = stack1[i].prev + (x[p] - x[p - 1]) * (stack1[i].prevy + b[k]) * 0.5;
+                stack1[i].prevy =  b[k];
+                stack1[i].prev = result;
+              }
+              stack1[i].buf[p - first] = result; /* running integral */
+              while(stack1[i].prevp <= last && x[p] - x[stack1[i].prevp] > c[k]) {
+                stack1[i].prevp++;
+              }
+              b[k] = (result - stack1[i].buf[stack1[i].prevp - first]) / c[k];
             }
-            stack2[stackptr2 - 2] = (result - ravg_store(2, i, stack1[i].prevp, 0, 0)) / stack2[stackptr2 - 1];
-            /* dbg(1, "result=%g ravg_store=%g\n", result,  ravg_store(2, i, stack1[i].prevp, 0, 0)); */
             stackptr2--;
             break;
           case MAX:
-            stack2[stackptr2 - 2] = stack2[stackptr2 - 2] < stack2[stackptr2 - 1] ?
-                                    stack2[stackptr2 - 1] :  stack2[stackptr2 - 2];
+            for(k = 0; k < n; k++) b[k] = b[k] < c[k] ? c[k] : b[k];
             stackptr2--;
             break;
           case MIN:
-            stack2[stackptr2 - 2] = stack2[stackptr2 - 2] > stack2[stackptr2 - 1] ?
-                                    stack2[stackptr2 - 1] :  stack2[stackptr2 - 2];
+            for(k = 0; k < n; k++) b[k] = b[k] > c[k] ? c[k] : b[k];
             stackptr2--;
             break;
           case POW:
-            stack2[stackptr2 - 2] =  pow(stack2[stackptr2 - 2], stack2[stackptr2 - 1]);
+            for(k = 0; k < n; k++) b[k] = pow(b[k], c[k]);
             stackptr2--;
             break;
           case REAL:
-            stack2[stackptr2 - 2] = stack2[stackptr2 - 2] * cos(stack2[stackptr2 - 1] * XSCH_PI / 180.);
+            for(k = 0; k < n; k++) b[k] = b[k] * cos(c[k] * XSCH_PI / 180.);
             stackptr2--;
             break;
           case IMAG:
-            stack2[stackptr2 - 2] = stack2[stackptr2 - 2] * sin(stack2[stackptr2 - 1] * XSCH_PI / 180.);
+            for(k = 0; k < n; k++) b[k] = b[k] * sin(c[k] * XSCH_PI / 180.);
             stackptr2--;
             break;
           case EXCH:
-            tmp = stack2[stackptr2 - 2];
-            stack2[stackptr2 - 2] = stack2[stackptr2 - 1];
-            stack2[stackptr2 - 1] = tmp;
+            for(k = 0; k < n; k++) {
+              tmp = b[k];
+              b[k] = c[k];
+              c[k] = tmp;
+            }
             break;
           default:
             break;
@@ -1797,215 +3798,230 @@ int plot_raw_custom_data(int sweep_idx, int first, int last, const char *expr, c
       if(stackptr2 > 0) { /* 1 argument operators */
         switch(stack1[i].i) {
           case AVG:
-            if( p == first ) {
-              avg = stack2[stackptr2 - 1];
-              stack1[i].prevy = stack2[stackptr2 - 1];
-              stack1[i].prev = stack2[stackptr2 - 1];
-            } else {
-              if((x[p] != x[first])) {
-                avg = stack1[i].prev * (x[p - 1] - x[first]) + 
-                    (x[p] - x[p - 1]) * (stack1[i].prevy + stack2[stackptr2 - 1]) * 0.5;
-                avg /= (x[p] - x[first]);
-              } else  {
-                avg = stack1[i].prev;
+            for(k = 0; k < n; k++) {
+              p = b0 + k;
+              if( p == first ) {
+                avg = c[k];
+                stack1[i].prevy = c[k];
+                stack1[i].prev = c[k];
+              } else {
+                if((x[p] != x[first])) {
+                  avg = stack1[i].prev * (x[p - 1] - x[first]) +
+                      (x[p] - x[p - 1]) * (stack1[i].prevy + c[k]) * 0.5;
+                  avg /= (x[p] - x[first]);
+                } else  {
+                  avg = stack1[i].prev;
+                }
+                stack1[i].prevy =  c[k];
+                stack1[i].prev = avg;
               }
-              stack1[i].prevy =  stack2[stackptr2 - 1];
-              stack1[i].prev = avg;
+              c[k] =  avg;
             }
-            stack2[stackptr2 - 1] =  avg;
             break;
           case DUP:
-            stack2[stackptr2] =  stack2[stackptr2 - 1];
+            for(k = 0; k < n; k++) c[k + EXPR_BLOCK] = c[k];
             stackptr2++;
             break;
-          case INTEG: 
-            if( p == first ) {
-              result = 0;
-              stack1[i].prevy = stack2[stackptr2 - 1];
-              stack1[i].prev = 0;
-            } else {
-              result = stack1[i].prev + (x[p] - x[p - 1]) * (stack1[i].prevy + stack2[stackptr2 - 1]) * 0.5;
-              stack1[i].prevy =  stack2[stackptr2 - 1];
-              stack1[i].prev = result;
+          case INTEG:
+            for(k = 0; k < n; k++) {
+              p = b0 + k;
+              if( p == first ) {
+                result = 0;
+                stack1[i].prevy = c[k];
+                stack1[i].prev = 0;
+              } else {
+                result = stack1[i].prev + (x[p] - x[p - 1]) * (stack1[i].prevy + c[k]) * 0.5;
+                stack1[i].prevy =  c[k];
+                stack1[i].prev = result;
+              }
+              c[k] =  result;
             }
-            stack2[stackptr2 - 1] =  result;
             break;
           #if ORDER_DERIV==1
-          case DERIV: 
-            if( p == first ) {
-              result = 0;
-              stack1[i].prevy = stack2[stackptr2 - 1];
-              stack1[i].prev = 0;
-            } else {
-              if((x[p] != x[p - 1])) 
-                result =  (stack2[stackptr2 - 1] - stack1[i].prevy) / (x[p] - x[p - 1]);
-              else
-                result = stack1[i].prev;
-              stack1[i].prevy = stack2[stackptr2 - 1] ;
-              stack1[i].prev = result;
+          case DERIV:
+            for(k = 0; k < n; k++) {
+              p = b0 + k;
+              if( p == first ) {
+                result = 0;
+                stack1[i].prevy = c[k];
+                stack1[i].prev = 0;
+              } else {
+                if((x[p] != x[p - 1]))
+                  result =  (c[k] - stack1[i].prevy) / (x[p] - x[p - 1]);
+                else
+                  result = stack1[i].prev;
+                stack1[i].prevy = c[k] ;
+                stack1[i].prev = result;
+              }
+              c[k] =  result;
             }
-            stack2[stackptr2 - 1] =  result;
             break;
           case DERIV0:
-            if( p == first ) {
-              result = 0;
-              stack1[i].prevy = stack2[stackptr2 - 1];
-              stack1[i].prev = 0;
-            } else {
-              if((sweepx[p] != sweepx[p - 1]))
-                result =  (stack2[stackptr2 - 1] - stack1[i].prevy) / (sweepx[p] - sweepx[p - 1]);
-              else
-                result = stack1[i].prev;
-              stack1[i].prevy = stack2[stackptr2 - 1] ;
-              stack1[i].prev = result;
+            for(k = 0; k < n; k++) {
+              p = b0 + k;
+              if( p == first ) {
+                result = 0;
+                stack1[i].prevy = c[k];
+                stack1[i].prev = 0;
+              } else {
+                if((sweepx[p] != sweepx[p - 1]))
+                  result =  (c[k] - stack1[i].prevy) / (sweepx[p] - sweepx[p - 1]);
+                else
+                  result = stack1[i].prev;
+                stack1[i].prevy = c[k] ;
+                stack1[i].prev = result;
+              }
+              c[k] =  result;
             }
-            stack2[stackptr2 - 1] =  result;
             break;
           #else /* second order backward differentiation formulas */
           case DERIV:
-            if( p == first ) {
-              result = 0;
-              stack1[i].prevy = stack2[stackptr2 - 1];
-              stack1[i].prev = 0;
-            } else if(p == first + 1) {
-              if((x[p] != x[p - 1]))
-                result =  (stack2[stackptr2 - 1] - stack1[i].prevy) / (x[p] - x[p - 1]);
-              else
-                result = stack1[i].prev;
-              stack1[i].prevprevy =  stack1[i].prevy;
-              stack1[i].prevy = stack2[stackptr2 - 1] ;
-              stack1[i].prev = result;
-            } else {
-              double a = x[p - 2] - x[p];
-              double c = x[p - 1] - x[p];
-              double b = a * a / 2.0;
-              double d = c * c / 2.0;
-              double b_on_d = b / d;
-              double fa = stack1[i].prevprevy;
-              double fb = stack1[i].prevy;
-              double fc = stack2[stackptr2 - 1];
-              if(a != 0.0) 
-                result = (fa - b_on_d * fb - (1 - b_on_d) * fc ) / (a - c * b_on_d);
-              else
-                result = stack1[i].prev;
-              stack1[i].prevprevy =  stack1[i].prevy;
-              stack1[i].prevy = stack2[stackptr2 - 1] ;
-              stack1[i].prev = result;
+            for(k = 0; k < n; k++) {
+              p = b0 + k;
+              if( p == first ) {
+                result = 0;
+                stack1[i].prevy = c[k];
+                stack1[i].prev = 0;
+              } else if(p == first + 1) {
+                if((x[p] != x[p - 1]))
+                  result =  (c[k] - stack1[i].prevy) / (x[p] - x[p - 1]);
+                else
+                  result = stack1[i].prev;
+                stack1[i].prevprevy =  stack1[i].prevy;
+                stack1[i].prevy = c[k] ;
+                stack1[i].prev = result;
+              } else {
+                double a = x[p - 2] - x[p];
+                double c = x[p - 1] - x[p];
+                double b = a * a / 2.0;
+                double d = c * c / 2.0;
+                double b_on_d = b / d;
+                double fa = stack1[i].prevprevy;
+                double fb = stack1[i].prevy;
+                double fc = stack2[(stackptr2 - 1) * EXPR_BLOCK + k];
+                if(a != 0.0)
+                  result = (fa - b_on_d * fb - (1 - b_on_d) * fc ) / (a - c * b_on_d);
+                else
+                  result = stack1[i].prev;
+                stack1[i].prevprevy =  stack1[i].prevy;
+                stack1[i].prevy = fc;
+                stack1[i].prev = result;
+              }
+              stack2[(stackptr2 - 1) * EXPR_BLOCK + k] =  result;
             }
-            stack2[stackptr2 - 1] =  result;
             break;
           case DERIV0:
-            if( p == first ) {
-              result = 0;
-              stack1[i].prevy = stack2[stackptr2 - 1];
-              stack1[i].prev = 0;
-            } else if(p == first + 1) {
-              if((sweepx[p] != sweepx[p - 1]))
-                result =  (stack2[stackptr2 - 1] - stack1[i].prevy) / (sweepx[p] - sweepx[p - 1]);
-              else
-                result = stack1[i].prev;
-              stack1[i].prevprevy =  stack1[i].prevy;
-              stack1[i].prevy = stack2[stackptr2 - 1] ;
-              stack1[i].prev = result;
-            } else {
-              double a = sweepx[p - 2] - sweepx[p];
-              double c = sweepx[p - 1] - sweepx[p];
-              double b = a * a / 2.0;
-              double d = c * c / 2.0;
-              double b_on_d = b / d;
-              double fa = stack1[i].prevprevy;
-              double fb = stack1[i].prevy;
-              double fc = stack2[stackptr2 - 1];
-              if(a != 0.0)
-                result = (fa - b_on_d * fb - (1 - b_on_d) * fc ) / (a - c * b_on_d);
-              else
-                result = stack1[i].prev;
-              stack1[i].prevprevy =  stack1[i].prevy;
-              stack1[i].prevy = stack2[stackptr2 - 1] ;
-              stack1[i].prev = result;
+            for(k = 0; k < n; k++) {
+              p = b0 + k;
+              if( p == first ) {
+                result = 0;
+                stack1[i].prevy = c[k];
+                stack1[i].prev = 0;
+              } else if(p == first + 1) {
+                if((sweepx[p] != sweepx[p - 1]))
+                  result =  (c[k] - stack1[i].prevy) / (sweepx[p] - sweepx[p - 1]);
+                else
+                  result = stack1[i].prev;
+                stack1[i].prevprevy =  stack1[i].prevy;
+                stack1[i].prevy = c[k] ;
+                stack1[i].prev = result;
+              } else {
+                double a = sweepx[p - 2] - sweepx[p];
+                double c = sweepx[p - 1] - sweepx[p];
+                double b = a * a / 2.0;
+                double d = c * c / 2.0;
+                double b_on_d = b / d;
+                double fa = stack1[i].prevprevy;
+                double fb = stack1[i].prevy;
+                double fc = stack2[(stackptr2 - 1) * EXPR_BLOCK + k];
+                if(a != 0.0)
+                  result = (fa - b_on_d * fb - (1 - b_on_d) * fc ) / (a - c * b_on_d);
+                else
+                  result = stack1[i].prev;
+                stack1[i].prevprevy =  stack1[i].prevy;
+                stack1[i].prevy = fc;
+                stack1[i].prev = result;
+              }
+              stack2[(stackptr2 - 1) * EXPR_BLOCK + k] =  result;
             }
-            stack2[stackptr2 - 1] =  result;
             break;
           #endif
           case PREV:
-            if(p == first) {
-              result = stack2[stackptr2 - 1];
-            } else {
-              result =  stack1[i].prev;
+            for(k = 0; k < n; k++) {
+              p = b0 + k;
+              if(p == first) {
+                result = c[k];
+              } else {
+                result =  stack1[i].prev;
+              }
+              stack1[i].prev =  c[k];
+              c[k] =  result;
             }
-            stack1[i].prev =  stack2[stackptr2 - 1];
-            stack2[stackptr2 - 1] =  result;
             break;
           case SQRT:
-            stack2[stackptr2 - 1] =  sqrt(stack2[stackptr2 - 1]);
+            for(k = 0; k < n; k++) c[k] = sqrt(c[k]);
             break;
           case TANH:
-            stack2[stackptr2 - 1] =  tanh(stack2[stackptr2 - 1]);
+            for(k = 0; k < n; k++) c[k] = tanh(c[k]);
             break;
           case COSH:
-            stack2[stackptr2 - 1] =  cosh(stack2[stackptr2 - 1]);
+            for(k = 0; k < n; k++) c[k] = cosh(c[k]);
             break;
           case SINH:
-            stack2[stackptr2 - 1] =  sinh(stack2[stackptr2 - 1]);
+            for(k = 0; k < n; k++) c[k] = sinh(c[k]);
             break;
           case ATANH:
-            tmp = stack2[stackptr2 - 1];
-            tmp = 0.5 * log( (1 + tmp) / (1 - tmp) );
-            stack2[stackptr2 - 1] =  tmp;
+            for(k = 0; k < n; k++) c[k] = 0.5 * log( (1 + c[k]) / (1 - c[k]) );
             break;
           case ACOSH:
-            tmp = stack2[stackptr2 - 1];
-            tmp = log(tmp + sqrt(tmp * tmp - 1));
-            stack2[stackptr2 - 1] =  tmp;
+            for(k = 0; k < n; k++) c[k] = log(c[k] + sqrt(c[k] * c[k] - 1));
             break;
           case ASINH:
-            tmp = stack2[stackptr2 - 1];
-            tmp = log(tmp + sqrt(tmp * tmp + 1));
-            stack2[stackptr2 - 1] =  tmp;
+            for(k = 0; k < n; k++) c[k] = log(c[k] + sqrt(c[k] * c[k] + 1));
             break;
           case TAN:
-            stack2[stackptr2 - 1] =  tan(stack2[stackptr2 - 1]);
+            for(k = 0; k < n; k++) c[k] = tan(c[k]);
             break;
           case SIN:
-            stack2[stackptr2 - 1] =  sin(stack2[stackptr2 - 1]);
+            for(k = 0; k < n; k++) c[k] = sin(c[k]);
             break;
           case COS:
-            stack2[stackptr2 - 1] =  cos(stack2[stackptr2 - 1]);
+            for(k = 0; k < n; k++) c[k] = cos(c[k]);
             break;
           case ATAN:
-            stack2[stackptr2 - 1] =  atan(stack2[stackptr2 - 1]);
+            for(k = 0; k < n; k++) c[k] = atan(c[k]);
             break;
           case ASIN:
-            stack2[stackptr2 - 1] =  asin(stack2[stackptr2 - 1]);
+            for(k = 0; k < n; k++) c[k] = asin(c[k]);
             break;
           case ACOS:
-            stack2[stackptr2 - 1] =  acos(stack2[stackptr2 - 1]);
+            for(k = 0; k < n; k++) c[k] = acos(c[k]);
             break;
           case ABS:
-            stack2[stackptr2 - 1] =  fabs(stack2[stackptr2 - 1]);
+            for(k = 0; k < n; k++) c[k] = fabs(c[k]);
             break;
           case EXP:
-            stack2[stackptr2 - 1] =  exp(stack2[stackptr2 - 1]);
+            for(k = 0; k < n; k++) c[k] = exp(c[k]);
             break;
           case LN:
-            stack2[stackptr2 - 1] =  mylog(stack2[stackptr2 - 1]);
+            for(k = 0; k < n; k++) c[k] = mylog(c[k]);
             break;
           case LOG10:
-            stack2[stackptr2 - 1] =  mylog10(stack2[stackptr2 - 1]);
+            for(k = 0; k < n; k++) c[k] = mylog10(c[k]);
             break;
           case DB20:
-            stack2[stackptr2 - 1] =  20 * mylog10(stack2[stackptr2 - 1]);
+            for(k = 0; k < n; k++) c[k] = 20 * mylog10(c[k]);
             break;
           case SGN:
-            stack2[stackptr2 - 1] = stack2[stackptr2 - 1] > 0.0 ? 1 : 
-                                    stack2[stackptr2 - 1] < 0.0 ? -1 : 0; 
+            for(k = 0; k < n; k++) c[k] = c[k] > 0.0 ? 1 : c[k] < 0.0 ? -1 : 0;
             break;
         } /* switch(...) */
       } /* if(stackptr2 > 0) */
-    } /* for(i = 0; i < stackptr1; ++i) */
-    y[p] = (SPICE_DATA)stack2[0];
-  } /* for(p = first ...) */
-  ravg_store(0, 0, 0, 0, 0.0); /* clear data */
+    } /* for(i = 0; i < nops; ++i) */
+    for(k = 0; k < n; k++) y[b0 + k] = stackptr2 ? (SPICE_DATA)stack2[k] : 0.0;
+  } /* for(b0 = first ...) */
+  my_free(_ALLOC_ID_, &stack2);
+  if(yname == NULL) store_expr_result(expr, sweep_idx, req_first, last, first, y);
   return xctx->raw->nvars;
 }
 
@@ -2019,13 +4035,13 @@ double get_raw_value(int dataset, int idx, int point)
   if(xctx->raw && xctx->raw->values && dataset < xctx->raw->datasets) {
     if(dataset == -1) {
       if(point < xctx->raw->allpoints)
-        return xctx->raw->values[idx][point];
+        return get_raw_point(xctx->raw, idx, point);
     } else {
       for(i = 0; i < dataset; ++i) {
         ofs += xctx->raw->npoints[i];
       }
       if(ofs + point < xctx->raw->allpoints) {
-        return xctx->raw->values[idx][ofs + point];
+        return get_raw_point(xctx->raw, idx, ofs + point);
       }
     }
   }
@@ -3114,6 +5130,155 @@ Sch_pin_record *sort_schematic_pins(int *npins)
   return pinnumber_list;
 }             
 
+/* DESIGN CACHE
+ * parsed schematics (attributes and objects, without symbols) and symbol definitions read
+ * from regular files are kept for the whole session and shared by all windows / tabs.
+ * Hierarchy traversals (netlisting, highlighting, printing, descend / go back) get
+ * unchanged cells from memory instead of reading and parsing files again.
+ * Entries are validated with file modification time, size and inode. An entry is
+ * not trusted if the file was modified in the same second it was read (or later,
+ * if file server clock is ahead), since a rewrite keeping the file size in that
+ * same second would not change these, it is read again next time. */
+typedef struct {
+  time_t mtime;
+  time_t read_time; /* time before reading the file */
+  off_t size;
+  ino_t ino;
+  char *version_string;
+  char *header_text;
+  char file_version[100];
+  Undo_slot *objs; /* schematic objects */
+  xSymbol *sym;    /* symbol definition */
+} Design_entry;
+
+static Ptr_hashtable sch_cache = {NULL, 0}; /* safe even with multiple schematics */
+static Ptr_hashtable sym_cache = {NULL, 0}; /* safe even with multiple schematics */
+static char *design_cache_pathlist = NULL; /* search path the cache was built with */
+
+static void free_design_entry(Design_entry *e)
+{
+  if(e->objs) mem_free_objects(e->objs);
+  if(e->sym) {
+    free_symbol(e->sym);
+    my_free(_ALLOC_ID_, &e->sym);
+  }
+  my_free(_ALLOC_ID_, &e->version_string);
+  my_free(_ALLOC_ID_, &e->header_text);
+  my_free(_ALLOC_ID_, &e);
+}
+
+static void free_design_table(Ptr_hashtable *t)
+{
+  int i;
+  Ptr_hashentry *entry;
+
+  for(i = 0; i < t->size; ++i) {
+    for(entry = t->table[i]; entry; entry = entry->next) {
+      free_design_entry(entry->value);
+    }
+  }
+  ptr_hash_free(t);
+}
+
+void free_design_cache(void)
+{
+  free_design_table(&sch_cache);
+  free_design_table(&sym_cache);
+  my_free(_ALLOC_ID_, &design_cache_pathlist);
+}
+
+/* return 1 if design cache is enabled. Cache is flushed if search paths
+ * changed, since instance symbol references are stored relative to these */
+static int design_cache_enabled(void)
+{
+  const char *pathlist;
+
+  if(!tclgetboolvar("design_cache")) {
+    if(sch_cache.table) free_design_cache();
+    return 0;
+  }
+  pathlist = tclgetvar("pathlist");
+  if(!pathlist) pathlist = "";
+  if(!design_cache_pathlist || strcmp(pathlist, design_cache_pathlist)) {
+    free_design_cache();
+    my_strdup2(_ALLOC_ID_, &design_cache_pathlist, pathlist);
+  }
+  if(!sch_cache.table) ptr_hash_init(&sch_cache, HASHSIZE);
+  if(!sym_cache.table) ptr_hash_init(&sym_cache, HASHSIZE);
+  return 1;
+}
+
+/* return cache entry of file f if still matching file status buf, else drop it.
+ * *read_time is set to current time, to be given to design_cache_put() if file is read */
+static Design_entry *design_cache_get(Ptr_hashtable *t, const char *f, struct stat *buf,
+                                      time_t *read_time)
+{
+  Ptr_hashentry *entry;
+  Design_entry *e;
+
+  *read_time = time(NULL);
+  if(!(entry = ptr_hash_lookup(t, f, NULL, XLOOKUP))) return NULL;
+  e = entry->value;
+  if(e->mtime < e->read_time && e->mtime == buf->st_mtime &&
+     e->size == buf->st_size && e->ino == buf->st_ino) return e;
+  free_design_entry(e);
+  ptr_hash_lookup(t, f, NULL, XDELETE);
+  return NULL;
+}
+
+static void design_cache_put(Ptr_hashtable *t, const char *f, struct stat *buf,
+                             time_t read_time, Design_entry *e)
+{
+  e->mtime = buf->st_mtime;
+  e->read_time = read_time;
+  e->size = buf->st_size;
+  e->ino = buf->st_ino;
+  ptr_hash_lookup(t, f, e, XINSERT);
+}
+
+/* remove file f from cache, used when f is written */
+static void design_cache_drop(const char *f)
+{
+  Ptr_hashentry *entry;
+
+  if((entry = ptr_hash_lookup(&sch_cache, f, NULL, XLOOKUP))) {
+    free_design_entry(entry->value);
+    ptr_hash_lookup(&sch_cache, f, NULL, XDELETE);
+  }
+  if((entry = ptr_hash_lookup(&sym_cache, f, NULL, XLOOKUP))) {
+    free_design_entry(entry->value);
+    ptr_hash_lookup(&sym_cache, f, NULL, XDELETE);
+  }
+}
+
+/* store just read schematic f. Schematics with embedded symbols are not cached
+ * since these symbols are loaded while reading the file */
+static void design_cache_save_sch(const char *f, struct stat *buf, time_t read_time)
+{
+  int i;
+  Design_entry *e;
+
+  for(i = 0; i < xctx->instances; ++i) {
+    if(!strboolcmp(get_tok_value(xctx->inst[i].prop_ptr, "embed", 0), "true")) return;
+  }
+  e = my_calloc(_ALLOC_ID_, 1, sizeof(Design_entry));
+  e->objs = mem_save_objects();
+  my_strdup2(_ALLOC_ID_, &e->version_string, xctx->version_string);
+  my_strdup2(_ALLOC_ID_, &e->header_text, xctx->header_text);
+  my_strncpy(e->file_version, xctx->file_version, S(e->file_version));
+  design_cache_put(&sch_cache, f, buf, read_time, e);
+}
+
+/* same as read_xschem_file() getting data from cache entry e */
+static void design_cache_load_sch(Design_entry *e)
+{
+  mem_restore_objects(e->objs);
+  my_strdup2(_ALLOC_ID_, &xctx->version_string, e->version_string);
+  my_strdup2(_ALLOC_ID_, &xctx->header_text, e->header_text);
+  my_strncpy(xctx->file_version, e->file_version, S(xctx->file_version));
+  int_hash_free(&xctx->floater_inst_table);
+}
+
 /* ALWAYS call with absolute path in schname!!! */
 /* return value:
  *   0 : did not save
@@ -3161,6 +5326,8 @@ int save_schematic(const char *schname) /* 20171020 added return value */
   sort_symbol_pins(rect, rects, schname);
   write_xschem_file(fd);
   fclose(fd);
+  design_cache_drop(schname);
+  revalidate_sym_path_index(); /* file may be new */
   /* update time stamp */
   if(!stat(schname, &buf)) {
     xctx->time_last_modify =  buf.st_mtime;
@@ -3232,6 +5399,9 @@ int load_schematic(int load_symbols, const char *fname, int reset_undo, int aler
   char msg[PATH_MAX+100];
   struct stat buf;
   int i, ret = 1; /* success */
+  int cache = 0;
+  Design_entry *cached = NULL;
+  time_t read_time = 0;
   
   xctx->prep_hi_structs=0;
   xctx->prep_net_structs=0;
@@ -3296,7 +5466,12 @@ int load_schematic(int load_symbols, const char *fname, int reset_undo, int aler
         xctx->time_last_modify = 0; /* file does not exist, set mtime to 0 (undefined)*/
       }
     }
-    if(generator) {
+    if(!generator && design_cache_enabled() && !stat(name, &buf)) {
+      cache = 1;
+      cached = design_cache_get(&sch_cache, name, &buf, &read_time);
+    }
+    if(cached) fd = NULL;
+    else if(generator) {
       char *cmd;
       cmd = get_generator_command(fname);
       if(cmd) {
@@ -3305,7 +5480,7 @@ int load_schematic(int load_symbols, const char *fname, int reset_undo, int aler
       } else fd = NULL;
     }
     else fd=fopen(name,fopen_read_mode);
-    if( fd == NULL) {
+    if( fd == NULL && !cached) {
       ret = 0;
       if(alert) {
         fprintf(errfp, "load_schematic(): unable to open file: %s, fname=%s\n", name, fname );
@@ -3318,10 +5493,16 @@ int load_schematic(int load_symbols, const char *fname, int reset_undo, int aler
       if(reset_undo) set_modify(0);
     } else {
       clear_drawing();
-      dbg(1, "load_schematic(): reading file: %s\n", name);
-      read_xschem_file(fd);
-      if(generator) pclose(fd);
-      else fclose(fd); /* 20150326 moved before load symbols */
+      if(cached) {
+        dbg(1, "load_schematic(): %s from design cache\n", name);
+        design_cache_load_sch(cached);
+      } else {
+        dbg(1, "load_schematic(): reading file: %s\n", name);
+        read_xschem_file(fd);
+        if(generator) pclose(fd);
+        else fclose(fd); /* 20150326 moved before load symbols */
+        if(cache) design_cache_save_sch(name, &buf, read_time);
+      }
       if(reset_undo) set_modify(0);
       dbg(2, "load_schematic(): loaded file:wire=%d inst=%d\n",xctx->wires , xctx->instances);
       if(load_symbols) link_symbols_to_instances(-1);
@@ -3913,7 +6094,11 @@ int is_from_web(const char *f)
  * xctx->symbols
  * has_x
  */
-int load_sym_def(const char *name, FILE *embed_fd)
+/* read symbol definition 'name' from file (or from embed_fd if not NULL).
+ * path: if not NULL is the already resolved symbol file path.
+ * *cacheable is cleared if symbol contains components (LCC), since its
+ * definition depends also on other files */
+static int read_sym_def(const char *name, FILE *embed_fd, const char *path, int *cacheable)
 {
   static int recursion_counter=0; /* safe to keep even with multiple schematics, operation not interruptable */
   Lcc *lcc; /* size = level */
@@ -3984,7 +6169,9 @@ int load_sym_def(const char *name, FILE *embed_fd)
     }
     my_free(_ALLOC_ID_, &translated_cmd);
   } else if(!embed_fd) { /* regular symbol: open file */
-    if(!strcmp(xctx->file_version,"1.0")) {
+    if(path) {
+      my_strncpy(sympath, path, S(sympath));
+    } else if(!strcmp(xctx->file_version,"1.0")) {
       my_strncpy(sympath, abs_sym_path(name, ".sym"), S(sympath));
     } else {
       my_strncpy(sympath, abs_sym_path(name, ""), S(sympath));
@@ -4509,6 +6696,7 @@ int load_sym_def(const char *name, FILE *embed_fd)
      lastl[WIRELAYER]++;
      break;
     case 'C': /* symbol is LCC: contains components */
+      if(cacheable) *cacheable = 0;
       load_ascii_string(&symname, lcc[level].fd);
       if (fscanf(lcc[level].fd, "%lf %lf %hd %hd", &inst_x0, &inst_y0, &inst_rot, &inst_flip) < 4) {
         fprintf(errfp, "l_s_d(): WARNING: missing fields for COMPONENT object, ignoring\n");
@@ -4705,6 +6893,44 @@ int load_sym_def(const char *name, FILE *embed_fd)
   return 1;
 }
 
+/* load symbol definition 'name', regular .sym files are taken from the design cache
+ * if enabled and file is unchanged */
+int load_sym_def(const char *name, FILE *embed_fd)
+{
+  char sympath[PATH_MAX];
+  const char *ext;
+  struct stat buf;
+  Design_entry *e;
+  int ret, cacheable = 1;
+  time_t read_time;
+
+  if(!name || embed_fd || strstr(name, "tcleval(") || is_generator(name) ||
+     strstr(name, ".xschem_embedded_") || !design_cache_enabled()) {
+    return read_sym_def(name, embed_fd, NULL, NULL);
+  }
+  my_strncpy(sympath, abs_sym_path(name, strcmp(xctx->file_version, "1.0") ? "" : ".sym"), S(sympath));
+  /* .sch files used as symbols depend also on their .sym file for pin ordering */
+  if(stat(sympath, &buf) || !(ext = strrchr(sympath, '.')) || strcmp(ext, ".sym")) {
+    return read_sym_def(name, NULL, sympath, NULL);
+  }
+  if((e = design_cache_get(&sym_cache, sympath, &buf, &read_time))) {
+    dbg(1, "load_sym_def(): %s from design cache\n", sympath);
+    check_symbol_storage();
+    copy_symbol(&xctx->sym[xctx->symbols], e->sym);
+    my_strdup2(_ALLOC_ID_, &xctx->sym[xctx->symbols].name, name);
+    xctx->symbols++;
+    return 1;
+  }
+  ret = read_sym_def(name, NULL, sympath, &cacheable);
+  if(ret && cacheable) {
+    e = my_calloc(_ALLOC_ID_, 1, sizeof(Design_entry));
+    e->sym = my_calloc(_ALLOC_ID_, 1, sizeof(xSymbol));
+    copy_symbol(e->sym, &xctx->sym[xctx->symbols - 1]);
+    design_cache_put(&sym_cache, sympath, &buf, read_time, e);
+  }
+  return ret;
+}
+
 void make_schematic_symbol_from_sel(void)
 {
   char filename[PATH_MAX] = "";
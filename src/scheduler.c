@@ -134,7 +134,7 @@ static void xschem_cmd_help(int argc, const char **argv)
 }
 
 /* can be used to reach C functions from the Tk shell. */
-int xschem(ClientData clientdata, Tcl_Interp *interp, int argc, const char * argv[])
+static int xschem_command(ClientData clientdata, Tcl_Interp *interp, int argc, const char * argv[])
 {
  int i;
  char name[1024]; /* overflow safe 20161122 */
@@ -3671,14 +3671,18 @@ int xschem(ClientData clientdata, Tcl_Interp *interp, int argc, const char * arg
     case 'r': /*----------------------------------------------*/
 
     /* raw what ...
-     *     what = add | clear | datasets | index | info | loaded | list | new | points | rawfile | del |
-     *            read | set | sim_type | switch | switch_back | table_read | value | values | vars |
+     *     what = add | clear | datasets | follow | index | info | loaded | list | new | points | rawfile |
+     *            del | read | set | sim_type | stats | switch | switch_back | table_read | value | values |
+     *            vars |
      *
      *   xschem raw read filename [type [sweep1 sweep2]]
      *     if sweep1, sweep2 interval is given in 'read' subcommand load only the interval
      *     sweep1 <= sweep_var < sweep2
      *     type is the analysis type to load (tran, dc, ac, op, ...). If not given load first found in
      *     raw file.
+     *     filename may also be a vcd file: it is loaded as a 'tran' dataset, vectors are split
+     *     in bits (name[msb] ... name[lsb]) with scope path prefixed to names ('tb.dut.q'),
+     *     0 and 1 values are 0.0 and 1.0, x and z values are 0.5. sweep range is not used.
      *
      *   xschem raw clear [rawfile [type]]
      *     unload given file and type. If type not given delete all type sfrom rawfile
@@ -3690,6 +3694,25 @@ int xschem(ClientData clientdata, Tcl_Interp *interp, int argc, const char * arg
      *   xschem raw info
      *     print information about loaded raw files and show the currently active one.
      *
+     *   xschem raw memory
+     *     print resident memory of loaded raw files, one line for each:
+     *     index rawfile type bytes loaded_columns columns state
+     *     state is loaded, mapped (raw_mmap), vcd or evicted (data freed to stay within
+     *     raw_memory_budget, read again when raw file is used).
+     *     Last line gives total resident bytes and raw_memory_budget in bytes.
+     *
+     *   xschem raw follow
+     *     read data appended to the last dataset of active raw file by a still running
+     *     simulation and redraw. Return number of new points, -1 if dataset is complete
+     *     or raw file can not be followed. See also 'raw_follow' tcl procedure.
+     *
+     *   xschem raw to_vcd rawfile vcdfile [voltage | vth vtl]
+     *     convert first transient dataset of rawfile to vcdfile (like the rawtovcd tool)
+     *     streaming data rows, so raw file does not need to fit in memory.
+     *     If voltage is given values are converted to digital levels with thresholds
+     *     at 75% and 25% of voltage, or at vth and vtl if given, with hysteresis.
+     *     Returns 1 if successfull.
+     *
      *   xschem raw new name type sweepvar start end step
      *     create a new raw file with sweep variable 'sweepvar' with number=(end - start) / step datapoints
      *     from start value 'start' and step 'step'
@@ -3739,6 +3762,13 @@ int xschem(ClientData clientdata, Tcl_Interp *interp, int argc, const char * arg
      *   xschem raw points [dset]
      *     print simulation points for dataset 'dset' (default: all dataset points combined)
      *
+     *   xschem raw stats node [x1 x2 [dset]]
+     *     return {min max avg rms points} of 'node' for sweep variable in range [x1, x2]
+     *     (whole dataset if not given) in dataset 'dset' (default 0).
+     *     avg and rms are calculated integrating versus the sweep variable.
+     *     Uses the data summaries also used for graph drawing, so this is fast
+     *     also on huge datasets. Returns empty string if no points in range.
+     *
      *   xschem raw set node n value [dset]
      *     change loaded raw file data node[n] to value
      *     dset is the dataset to look into in case of multiple runs (first run = 0)
@@ -3810,6 +3840,8 @@ int xschem(ClientData clientdata, Tcl_Interp *interp, int argc, const char * arg
         Tcl_SetResult(interp, my_itoa(ret), TCL_VOLATILE);
       } else if(argc > 2 && !strcmp(argv[2], "info")) {
         ret = extra_rawfile(4, NULL, NULL, -1.0, -1.0);
+      } else if(argc > 2 && !strcmp(argv[2], "memory")) {
+        raw_memory_info();
       } else if(argc > 2 && !strcmp(argv[2], "switch_back")) {
         ret = extra_rawfile(5, NULL, NULL, -1.0, -1.0);
         update_op();
@@ -3828,6 +3860,21 @@ int xschem(ClientData clientdata, Tcl_Interp *interp, int argc, const char * arg
         Tcl_SetResult(interp, my_itoa(ret), TCL_VOLATILE);
       } else if(argc > 2 && !strcmp(argv[2], "loaded")) {
         Tcl_SetResult(interp, my_itoa(sch_waves_loaded()), TCL_VOLATILE);
+      } else if(argc > 4 && !strcmp(argv[2], "to_vcd")) {
+        double vth = 0.0, vtl = 0.0;
+        if(argc > 6) {
+          vth = atof_spice(argv[5]);
+          vtl = atof_spice(argv[6]);
+        } else if(argc > 5) {
+          vth = atof_spice(argv[5]) * 0.75;
+          vtl = atof_spice(argv[5]) * 0.25;
+        }
+        ret = raw_to_vcd(argv[3], argv[4], vth, vtl);
+        Tcl_SetResult(interp, my_itoa(ret), TCL_VOLATILE);
+      } else if(argc > 2 && !strcmp(argv[2], "follow")) {
+        ret = raw_follow(raw);
+        if(ret > 0 && sch_waves_loaded() >= 0) draw();
+        Tcl_SetResult(interp, my_itoa(ret), TCL_VOLATILE);
       } else if(raw && raw->values) {
         /* xschem raw value v(ldcp) 123 */
         if(argc > 4 && !strcmp(argv[2], "value")) {
@@ -3873,6 +3920,20 @@ int xschem(ClientData clientdata, Tcl_Interp *interp, int argc, const char * arg
               Tcl_AppendResult(interp, n, " ", NULL);
             }
           }
+        } else if(argc > 3 && !strcmp(argv[2], "stats")) {
+          /* xschem raw stats ldcp [x1 x2 [dataset]] */
+          double stats[5], x1 = 1.0, x2 = 0.0;
+          int idx, dataset = 0;
+          idx = get_raw_index(argv[3], NULL);
+          if(argc > 5) {
+            x1 = atof_spice(argv[4]);
+            x2 = atof_spice(argv[5]);
+          }
+          if(argc > 6) dataset = atoi(argv[6]);
+          if(idx >= 0 && get_raw_stats(raw, idx, dataset, x1, x2, stats)) {
+            for(i = 0; i < 4; i++) Tcl_AppendElement(interp, dtoa(stats[i]));
+            Tcl_AppendElement(interp, my_itoa((int)stats[4]));
+          }
         } else if(argc > 3 && !strcmp(argv[2], "add")) {
           int res = 0;
           if(argc > 4) {
@@ -3924,6 +3985,13 @@ int xschem(ClientData clientdata, Tcl_Interp *interp, int argc, const char * arg
                   point += ofs;
                 }
               }
+              get_raw_column(xctx->raw, idx); /* if raw file is mapped load data now */
+              /* modified column of mapped raw file must never be freed and reloaded */
+              if(xctx->raw->map_col) xctx->raw->map_col[idx] = -1;
+              xctx->raw->modified = 1;
+              /* pyramids and integrals of all columns are indexed by the sweep variable */
+              free_raw_colcache(xctx->raw, idx == 0 ? -1 : idx);
+              free_expr_cache(xctx->raw);
               xctx->raw->values[idx][point] = (SPICE_DATA) atof(argv[5]);
               Tcl_SetResult(interp, dtoa(xctx->raw->values[idx][point]), TCL_VOLATILE);
             }
@@ -5316,6 +5384,21 @@ int xschem(ClientData clientdata, Tcl_Interp *interp, int argc, const char * arg
       xctx->ui_state2 = MENUSTARTSNAPWIRE;
     }
 
+    /* spice_postprocess src dest [-xyce]
+     *   Post process raw spice netlist 'src' into 'dest' (same as
+     *   awk -f spice.awk src | awk -f break.awk > dest).
+     *   Used by the netlist procedure, returns 1 if done, 0 on errors */
+    else if(!strcmp(argv[1], "spice_postprocess"))
+    {
+      int xyce = 0;
+      if(argc < 4) {
+        Tcl_SetResult(interp, "Missing arguments", TCL_STATIC);
+        return TCL_ERROR;
+      }
+      if(argc > 4 && !strcmp(argv[4], "-xyce")) xyce = 1;
+      Tcl_SetResult(interp, my_itoa(spice_postprocess(argv[2], argv[3], xyce)), TCL_VOLATILE);
+    }
+
     /* str_replace str rep with [escape]
      *   replace 'rep' with 'with' in string 'str' 
      *   if rep not preceeded by an 'escape' character */
@@ -6047,6 +6130,24 @@ int xschem(ClientData clientdata, Tcl_Interp *interp, int argc, const char * arg
   return TCL_OK;
 }
 
+/* file system state cached by mapped raw files and symbol path index is checked again
+ * once for each xschem command, but not for xschem commands run by tcl code
+ * called while executing a command (netlisting, loading, ...) */
+int xschem(ClientData clientdata, Tcl_Interp *interp, int argc, const char * argv[])
+{
+  static int level = 0; /* safe even with multiple schematics */
+  int ret;
+
+  if(level == 0) {
+    revalidate_raw_maps();
+    revalidate_sym_path_index();
+  }
+  level++;
+  ret = xschem_command(clientdata, interp, argc, argv);
+  level--;
+  return ret;
+}
+
 double tclgetdoublevar(const char *s)
 {
   const char *p;
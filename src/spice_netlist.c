@@ -21,9 +21,50 @@
  */
 
 #include "xschem.h"
+#ifdef __unix__
+#include <sys/wait.h>  /* waitpid */
+#endif
 
 static Str_hashtable model_table = {NULL, 0}; /* safe even with multiple schematics */
 
+/* spice_block_netlist() cache entry: netlist lines of a subcircuit (between .subckt
+ * and .ends) and everything needed to replay its side effects without loading the
+ * schematic: device_model attributes, global nodes and symbols used in the schematic */
+typedef struct {
+  char *sch_hash;   /* content hash of the schematic file */
+  char *text;
+  size_t len;
+  int err;
+  int unconn_base;  /* xctx->netlist_unconn_cnt when text was netlisted ... */
+  int unconn_cnt;   /* ... and number of __UNCONNECTED_PIN__ nets created by the block */
+  int ndeps;
+  char **dep;       /* symbol files used by the schematic ... */
+  char **dep_hash;  /* ... and their content hash */
+  int nmodels;
+  char **model_key;
+  char **model;
+  int nglobals;
+  char **global;
+  int nsyms;
+  xSymbol *sym;
+  char **sym_base;  /* base_name of sym[] */
+  char *msg;        /* parallel netlisting: infowindow messages of the block */
+} Spice_block;
+
+/* parallel netlisting: block to netlist in a worker process */
+typedef struct {
+  int sym;          /* symbol index */
+  int globals;      /* number of global nodes recorded before the block in a serial netlist */
+} Spice_job;
+
+static Ptr_hashtable block_cache = {NULL, 0}; /* safe even with multiple schematics */
+static Str_hashtable file_hash_table = {NULL, 0}; /* file content hashes, valid during one netlist run */
+static char *block_options = NULL; /* netlisting options for block cache keys, NULL: cache not in use */
+static Spice_block *block_record = NULL; /* block being netlisted and stored in cache */
+
+static void spice_block_discover(int i);
+static int spice_block_jobs(FILE *fd, int jobs, Spice_job *job, int njobs, int web_url);
+
 static const char *hier_psprint_mtime(const char *file_name)
 {
   static char date[200];
@@ -168,6 +209,25 @@ static char *model_name(const char *m)
   return model_name_result;
 }
 
+static void block_add(char ***arr, int n, const char *s)
+{
+  my_realloc(_ALLOC_ID_, arr, (n + 1) * sizeof(char *));
+  (*arr)[n] = NULL;
+  my_strdup2(_ALLOC_ID_, &(*arr)[n], s);
+}
+
+static void insert_device_model(const char *m)
+{
+  const char *key = model_name(m);
+
+  str_hash_lookup(&model_table, key, m, XINSERT);
+  if(block_record) {
+    block_add(&block_record->model_key, block_record->nmodels, key);
+    block_add(&block_record->model, block_record->nmodels, m);
+    block_record->nmodels++;
+  }
+}
+
 static int spice_netlist(FILE *fd, int spice_stop )
 {
   int err = 0;
@@ -228,14 +288,14 @@ static int spice_netlist(FILE *fd, int spice_stop )
          m = val;
          if(strchr(val, '@')) m = translate(i, val);
          else m = tcl_hook2(m);
-         if(m[0]) str_hash_lookup(&model_table, model_name(m), m, XINSERT);
+         if(m[0]) insert_device_model(m);
          else {
            my_strdup2(_ALLOC_ID_, &val,
                get_tok_value( (xctx->inst[i].ptr+ xctx->sym)->prop_ptr, "device_model", 2));
            m = val;
            if(strchr(val, '@')) m = translate(i, val);
            else m = tcl_hook2(m);
-           if(m[0]) str_hash_lookup(&model_table, model_name(m), m, XINSERT);
+           if(m[0]) insert_device_model(m);
          }
          my_free(_ALLOC_ID_, &model_name_result);
          my_free(_ALLOC_ID_, &val);
@@ -277,9 +337,16 @@ int global_spice_netlist(int global)  /* netlister driver */
  int found_top_symbol = 0;
  int npins = 0; /* top schematic number of i/o ports */
  Sch_pin_record *pinnumber_list = NULL; /* list of top sch i/o ports ordered wrt sim_pinnumber attr */
+ int jobs = 0; /* parallel netlisting: number of worker processes */
+ Spice_job *job = NULL; /* parallel netlisting: blocks to netlist */
+ int njobs = 0;
 
  exit_code = 0; /* reset exit code */
  split_f = tclgetboolvar("split_files");
+ #ifdef __unix__
+ /* worker processes are forked only in batch mode, they must not use the X connection */
+ if(!has_x && !split_f) jobs = tclgetintvar("netlist_jobs");
+ #endif
  dbg(1, "global_spice_netlist(): invoking push_undo()\n");
  xctx->push_undo();
  xctx->netlist_unconn_cnt=0; /* unique count of unconnected pins while netlisting */
@@ -305,6 +372,14 @@ int global_spice_netlist(int global)  /* netlister driver */
  }
  fprintf(fd, "** sch_path: %s\n", xctx->sch[xctx->currsch]);
 
+ if(tclgetboolvar("spice_block_cache")) {
+   str_hash_init(&file_hash_table, HASHSIZE);
+   my_mstrcat(_ALLOC_ID_, &block_options, "lvs_netlist=", tclgetvar("lvs_netlist"),
+     " lvs_ignore=", tclgetvar("lvs_ignore"), " spiceprefix=", tclgetvar("spiceprefix"),
+     " bus_replacement_char=", tclgetvar("bus_replacement_char"),
+     " search_schematic=", tclgetvar("search_schematic"), " pathlist=", tclgetvar("pathlist"), NULL);
+ } else free_spice_block_cache();
+
  if(xctx->netlist_name[0]) {
    my_snprintf(cellname, S(cellname), "%s", get_cell_w_ext(xctx->netlist_name, 0));
  } else {
@@ -482,11 +557,21 @@ int global_spice_netlist(int global)  /* netlister driver */
         else if(split_f && strboolcmp(get_tok_value(xctx->sym[i].prop_ptr,"verilog_netlist",0),"true")==0 )
           err |= verilog_block_netlist(fd, i);
         else
-          if( strboolcmp(get_tok_value(xctx->sym[i].prop_ptr,"spice_primitive",0),"true") )
-            err |= spice_block_netlist(fd, i);
+          if( strboolcmp(get_tok_value(xctx->sym[i].prop_ptr,"spice_primitive",0),"true") ) {
+            if(jobs > 1) {
+              /* only load the block to find its subcircuits, netlist it later in a worker process */
+              my_realloc(_ALLOC_ID_, &job, (njobs + 1) * sizeof(Spice_job));
+              job[njobs].sym = i;
+              job[njobs++].globals = xctx->max_globals;
+              spice_block_discover(i);
+            }
+            else err |= spice_block_netlist(fd, i);
+          }
       }
     }
    }
+   if(njobs) err |= spice_block_jobs(fd, jobs, job, njobs, web_url);
+   my_free(_ALLOC_ID_, &job);
    if(xctx->hier_attr[xctx->currsch - 1].templ)
      my_free(_ALLOC_ID_, &xctx->hier_attr[xctx->currsch - 1].templ);
    if(xctx->hier_attr[xctx->currsch - 1].prop_ptr)
@@ -587,12 +672,485 @@ int global_spice_netlist(int global)  /* netlister driver */
    if(!debug_var) xunlink(netl_filename);
  }
  my_free(_ALLOC_ID_, &place);
+ if(file_hash_table.table) str_hash_free(&file_hash_table);
+ my_free(_ALLOC_ID_, &block_options);
  xctx->netlist_count = 0;
  tclvareval("show_infotext ", my_itoa(err), NULL); /* critical error: force ERC window showing */
  exit_code = err ? 10 : 0;
  return err;
 }
 
+/* SPICE BLOCK CACHE */
+
+/* content hash of file f, memoized during a netlist run.
+ * "none" if file does not exist, "" if file contents can not be cached (tcleval() constructs) */
+static const char *file_hash(const char *f)
+{
+  Str_hashentry *entry;
+  FILE *fd;
+  char *buf = NULL;
+  size_t i, n = 0;
+  unsigned int h1 = 2166136261U, h2 = 5381U;
+  char res[60];
+
+  if((entry = str_hash_lookup(&file_hash_table, f, NULL, XLOOKUP))) return entry->value;
+  if(!(fd = fopen(f, fopen_read_mode))) {
+    my_strncpy(res, "none", S(res));
+  } else {
+    fseek(fd, 0, SEEK_END);
+    n = ftell(fd);
+    fseek(fd, 0, SEEK_SET);
+    buf = my_malloc(_ALLOC_ID_, n + 1);
+    n = fread(buf, 1, n, fd);
+    buf[n] = '\0';
+    fclose(fd);
+    for(i = 0; i < n; i++) {
+      h1 = (h1 ^ (unsigned char)buf[i]) * 16777619U; /* FNV-1a */
+      h2 = h2 * 33U + (unsigned char)buf[i];         /* djb2 */
+    }
+    if(strstr(buf, "tcleval(")) res[0] = '\0';
+    else my_snprintf(res, S(res), "%08x%08x%lx", h1, h2, (unsigned long)n);
+    my_free(_ALLOC_ID_, &buf);
+  }
+  str_hash_lookup(&file_hash_table, f, res, XINSERT);
+  return str_hash_lookup(&file_hash_table, f, NULL, XLOOKUP)->value;
+}
+
+static void free_spice_block(Spice_block *e)
+{
+  int k;
+
+  for(k = 0; k < e->ndeps; k++) {
+    my_free(_ALLOC_ID_, &e->dep[k]);
+    my_free(_ALLOC_ID_, &e->dep_hash[k]);
+  }
+  for(k = 0; k < e->nmodels; k++) {
+    my_free(_ALLOC_ID_, &e->model_key[k]);
+    my_free(_ALLOC_ID_, &e->model[k]);
+  }
+  for(k = 0; k < e->nglobals; k++) my_free(_ALLOC_ID_, &e->global[k]);
+  for(k = 0; k < e->nsyms; k++) {
+    free_symbol(&e->sym[k]);
+    my_free(_ALLOC_ID_, &e->sym_base[k]);
+  }
+  my_free(_ALLOC_ID_, &e->dep);
+  my_free(_ALLOC_ID_, &e->dep_hash);
+  my_free(_ALLOC_ID_, &e->model_key);
+  my_free(_ALLOC_ID_, &e->model);
+  my_free(_ALLOC_ID_, &e->global);
+  my_free(_ALLOC_ID_, &e->sym);
+  my_free(_ALLOC_ID_, &e->sym_base);
+  my_free(_ALLOC_ID_, &e->sch_hash);
+  my_free(_ALLOC_ID_, &e->text);
+  my_free(_ALLOC_ID_, &e->msg);
+  my_free(_ALLOC_ID_, &e);
+}
+
+void free_spice_block_cache(void)
+{
+  int i;
+  Ptr_hashentry *entry;
+
+  for(i = 0; i < block_cache.size; ++i) {
+    for(entry = block_cache.table[i]; entry; entry = entry->next) {
+      free_spice_block(entry->value);
+    }
+  }
+  ptr_hash_free(&block_cache);
+}
+
+static int block_sym_index(const char *name)
+{
+  int j;
+
+  for(j = 0; j < xctx->symbols; ++j) {
+    if(xctx->sym[j].name && !strcmp(xctx->sym[j].name, name)) return j;
+  }
+  return -1;
+}
+
+/* cache key: schematic, expanded symbol with its parent attributes and netlisting options */
+static char *block_key(int i, const char *filename, int spice_stop)
+{
+  static char *key = NULL;
+  xSymbol *sym = xctx->sym + i;
+  int p;
+
+  my_free(_ALLOC_ID_, &key);
+  my_mstrcat(_ALLOC_ID_, &key, filename, "\n", sym->name, "\n",
+    sym->base_name ? sym->base_name : "", "\n",
+    sym->prop_ptr ? sym->prop_ptr : "", "\n",
+    sym->templ ? sym->templ : "", "\n",
+    sym->parent_prop_ptr ? sym->parent_prop_ptr : "", "\n",
+    xctx->hier_attr[xctx->currsch - 1].templ ? xctx->hier_attr[xctx->currsch - 1].templ : "", "\n",
+    xctx->hier_attr[xctx->currsch - 1].prop_ptr ? xctx->hier_attr[xctx->currsch - 1].prop_ptr : "", "\n",
+    spice_stop ? "spice_stop\n" : "\n", block_options, NULL);
+  for(p = 0; p < sym->rects[PINLAYER]; p++) {
+    my_mstrcat(_ALLOC_ID_, &key, "\n", sym->rect[PINLAYER][p].prop_ptr ?
+      sym->rect[PINLAYER][p].prop_ptr : "", NULL);
+  }
+  return key;
+}
+
+/* load schematic 'filename' and print its netlist lines */
+static int spice_block_body(FILE *fd, const char *filename, int spice_stop)
+{
+  int err = 0;
+
+  spice_stop ? load_schematic(0,filename, 0, 1) : load_schematic(1,filename, 0, 1);
+  get_additional_symbols(1);
+  err |= spice_netlist(fd, spice_stop);  /* 20111113 added spice_stop */
+  err |= warning_overlapped_symbols(0);
+  if(xctx->schprop && xctx->schprop[0]) {
+    fprintf(fd,"**** begin user architecture code\n");
+    fprintf(fd, "%s\n", xctx->schprop);
+    fprintf(fd,"**** end user architecture code\n");
+  }
+  return err;
+}
+
+/* global nodes (labels with global=true) of the loaded schematic: stored in e if not NULL,
+ * otherwise recorded with record_global_node() */
+static void block_globals(Spice_block *e)
+{
+  int k;
+  const char *global_node, *node;
+  xSymbol *symptr;
+
+  for(k = 0; k < xctx->instances; ++k) {
+    if(xctx->inst[k].ptr < 0) continue;
+    symptr = xctx->inst[k].ptr + xctx->sym;
+    if(!symptr->type || strcmp(symptr->type, "label") || !symptr->rects[PINLAYER]) continue;
+    global_node = get_tok_value(xctx->inst[k].prop_ptr, "global", 0);
+    if(!xctx->tok_size) global_node = get_tok_value(symptr->prop_ptr, "global", 0);
+    if(strboolcmp(global_node, "true")) continue;
+    node = xctx->inst[k].lab ? xctx->inst[k].lab : get_tok_value(symptr->templ, "lab", 0);
+    if(!node[0]) continue;
+    if(e) block_add(&e->global, e->nglobals++, node);
+    else record_global_node(1, NULL, node);
+  }
+}
+
+/* record global nodes and symbols of the just netlisted block, symbols from index n0 were
+ * loaded by the block. Return 0 if block can not be cached */
+static int block_record_end(Spice_block *e, int n0)
+{
+  int j, k, cacheable = 1;
+  char *used;
+  const char *h;
+
+  block_globals(e);
+  used = my_calloc(_ALLOC_ID_, xctx->symbols + 1, sizeof(char));
+  for(k = 0; k < xctx->instances; ++k) if(xctx->inst[k].ptr >= 0) used[xctx->inst[k].ptr] = 1;
+  for(j = n0; j < xctx->symbols; ++j) used[j] = 1;
+  for(j = 0; j < xctx->symbols; ++j) {
+    if(used[j] && xctx->sym[j].base_name && (k = block_sym_index(xctx->sym[j].base_name)) >= 0) used[k] = 1;
+  }
+  for(j = 0; j < xctx->symbols; ++j) {
+    if(!used[j]) continue;
+    if(is_generator(xctx->sym[j].name)) cacheable = 0;
+    my_realloc(_ALLOC_ID_, &e->sym, (e->nsyms + 1) * sizeof(xSymbol));
+    copy_symbol(&e->sym[e->nsyms], &xctx->sym[j]);
+    block_add(&e->sym_base, e->nsyms, xctx->sym[j].base_name);
+    e->nsyms++;
+    if(!(xctx->sym[j].flags & EMBEDDED)) {
+      block_add(&e->dep, e->ndeps, abs_sym_path(xctx->sym[j].name, ""));
+      h = file_hash(e->dep[e->ndeps]);
+      if(!h[0]) cacheable = 0;
+      block_add(&e->dep_hash, e->ndeps, h);
+      e->ndeps++;
+    }
+  }
+  my_free(_ALLOC_ID_, &used);
+  return cacheable;
+}
+
+/* print 'len' bytes of netlist text adding 'offset' to __UNCONNECTED_PIN__<n> net numbers,
+ * text must be '\0' terminated */
+static void block_write(FILE *fd, const char *text, size_t len, int offset)
+{
+  const char *p = text, *q;
+  char *r;
+  long n;
+
+  if(!len) return;
+  if(offset) while((q = strstr(p, "__UNCONNECTED_PIN__"))) {
+    q += 19;
+    n = strtol(q, &r, 10);
+    fwrite(p, 1, q - p, fd);
+    if(r > q) fprintf(fd, "%ld", n + offset);
+    p = r;
+  }
+  fwrite(p, 1, len - (p - text), fd);
+}
+
+/* print block from cache and replay its side effects */
+static int block_replay(FILE *fd, Spice_block *e)
+{
+  int k, j, b;
+
+  block_write(fd, e->text, e->len, xctx->netlist_unconn_cnt - e->unconn_base);
+  xctx->netlist_unconn_cnt += e->unconn_cnt;
+  for(k = 0; k < e->nmodels; k++) str_hash_lookup(&model_table, e->model_key[k], e->model[k], XINSERT);
+  for(k = 0; k < e->nglobals; k++) record_global_node(1, NULL, e->global[k]);
+  for(k = 0; k < e->nsyms; k++) {
+    if(block_sym_index(e->sym[k].name) >= 0) continue;
+    check_symbol_storage();
+    j = xctx->symbols;
+    copy_symbol(&xctx->sym[j], &e->sym[k]);
+    xctx->symbols++;
+    if(e->sym_base[k] && (b = block_sym_index(e->sym_base[k])) >= 0) xctx->sym[j].base_name = xctx->sym[b].name;
+  }
+  return e->err;
+}
+
+/* spice_block_body() going through the block cache: if schematic, symbol files and
+ * attributes are unchanged since last netlist the block is printed from cache */
+static int spice_block_cached(FILE *fd, int i, const char *filename, int spice_stop)
+{
+  int k, n0, err;
+  char *key = NULL;
+  const char *sch_hash;
+  Ptr_hashentry *entry;
+  Spice_block *e;
+  FILE *tfd;
+  size_t n;
+  char buf[4096];
+
+  if(!block_cache.table) ptr_hash_init(&block_cache, HASHSIZE);
+  my_strdup2(_ALLOC_ID_, &key, block_key(i, filename, spice_stop));
+  sch_hash = file_hash(filename);
+  entry = ptr_hash_lookup(&block_cache, key, NULL, XLOOKUP);
+  if(entry) {
+    e = entry->value;
+    for(k = 0; k < e->ndeps; k++) if(strcmp(file_hash(e->dep[k]), e->dep_hash[k])) break;
+    if(!strcmp(e->sch_hash, sch_hash) && k == e->ndeps) {
+      dbg(1, "spice_block_cached(): %s from cache\n", filename);
+      my_free(_ALLOC_ID_, &key);
+      return block_replay(fd, e);
+    }
+  }
+  if(!sch_hash[0] || !(tfd = tmpfile())) {
+    my_free(_ALLOC_ID_, &key);
+    return spice_block_body(fd, filename, spice_stop);
+  }
+  e = my_calloc(_ALLOC_ID_, 1, sizeof(Spice_block));
+  n0 = xctx->symbols;
+  block_record = e;
+  e->unconn_base = xctx->netlist_unconn_cnt;
+  err = spice_block_body(tfd, filename, spice_stop);
+  block_record = NULL;
+  e->err = err;
+  e->unconn_cnt = xctx->netlist_unconn_cnt - e->unconn_base;
+  my_strdup2(_ALLOC_ID_, &e->sch_hash, sch_hash);
+  rewind(tfd);
+  while((n = fread(buf, 1, sizeof(buf), tfd)) > 0) {
+    fwrite(buf, 1, n, fd);
+    my_realloc(_ALLOC_ID_, &e->text, e->len + n + 1);
+    memcpy(e->text + e->len, buf, n);
+    e->len += n;
+    e->text[e->len] = '\0';
+  }
+  fclose(tfd);
+  if(block_record_end(e, n0)) {
+    if(entry) free_spice_block(entry->value);
+    ptr_hash_lookup(&block_cache, key, e, XINSERT);
+  } else {
+    free_spice_block(e);
+  }
+  my_free(_ALLOC_ID_, &key);
+  return err;
+}
+
+/* PARALLEL NETLISTING */
+
+/* netlist block j->sym setting up parent attributes as done in the global_spice_netlist() loop.
+ * Global nodes recorded after the block in a serial netlist are hidden while netlisting it,
+ * so ERC messages are the same */
+static int spice_block_job(FILE *fd, Spice_job *j, int web_url)
+{
+  int err, k, n = xctx->max_globals;
+  char **later = NULL;
+
+  my_strdup(_ALLOC_ID_, &xctx->hier_attr[xctx->currsch - 1].templ,
+            tcl_hook2(xctx->sym[j->sym].templ));
+  my_strdup(_ALLOC_ID_, &xctx->hier_attr[xctx->currsch - 1].prop_ptr,
+            tcl_hook2(xctx->sym[j->sym].parent_prop_ptr));
+  if(!web_url) {
+    tclvareval("get_directory [list ", xctx->sch[xctx->currsch - 1], "]", NULL);
+    my_strncpy(xctx->current_dirname, tclresult(),  S(xctx->current_dirname));
+  }
+  if(n > j->globals) {
+    later = my_malloc(_ALLOC_ID_, (n - j->globals) * sizeof(char *));
+    memcpy(later, xctx->globals + j->globals, (n - j->globals) * sizeof(char *));
+    xctx->max_globals = j->globals;
+  }
+  err = spice_block_netlist(fd, j->sym);
+  if(later) {
+    /* block records again its own global nodes, already in later[] */
+    for(k = j->globals; k < xctx->max_globals; k++) my_free(_ALLOC_ID_, &xctx->globals[k]);
+    memcpy(xctx->globals + j->globals, later, (n - j->globals) * sizeof(char *));
+    xctx->max_globals = n;
+    my_free(_ALLOC_ID_, &later);
+  }
+  return err;
+}
+
+/* first pass of parallel netlisting: load the schematic of block i as spice_block_netlist()
+ * would do, to find the subcircuits it uses and record its global nodes, without netlisting it */
+static void spice_block_discover(int i)
+{
+  char filename[PATH_MAX];
+  int spice_stop;
+
+  if(!strcmp(get_tok_value(xctx->sym[i].prop_ptr, "format", 0), "")) return;
+  get_sch_from_sym(filename, xctx->sym + i, -1, 0);
+  if(!strcmp(get_tok_value(xctx->sym[i].prop_ptr, "default_schematic", 0), "ignore")) return;
+  if(get_tok_value(xctx->sym[i].prop_ptr, "spice_sym_def", 0)[0]) return;
+  spice_stop = !strboolcmp(get_tok_value(xctx->sym[i].prop_ptr, "spice_stop", 0), "true");
+  spice_stop ? load_schematic(0,filename, 0, 1) : load_schematic(1,filename, 0, 1);
+  get_additional_symbols(1);
+  block_globals(NULL);
+}
+
+#ifdef __unix__
+static char *block_read(FILE *f, size_t n)
+{
+  char *s = my_malloc(_ALLOC_ID_, n + 1);
+
+  s[fread(s, 1, n, f)] = '\0';
+  return s;
+}
+
+/* worker process w: netlist blocks job[w], job[w + jobs], ... to data, write for each block
+ * its position in data, error, unconnected pin count, messages and device_model attributes to info */
+static void spice_block_worker(FILE *data, FILE *info, int w, int jobs, Spice_job *job, int njobs, int web_url)
+{
+  int k, m;
+  long pos;
+  size_t msgpos;
+  const char *msg;
+  Spice_block *e;
+
+  block_options = NULL; /* no block cache in workers */
+  for(k = w; k < njobs; k += jobs) {
+    e = my_calloc(_ALLOC_ID_, 1, sizeof(Spice_block));
+    block_record = e;
+    pos = ftell(data);
+    msgpos = xctx->infowindow_text ? strlen(xctx->infowindow_text) : 0;
+    e->unconn_base = xctx->netlist_unconn_cnt;
+    e->err = spice_block_job(data, job + k, web_url);
+    block_record = NULL;
+    msg = "";
+    if(xctx->infowindow_text && strlen(xctx->infowindow_text) > msgpos) msg = xctx->infowindow_text + msgpos;
+    if(msgpos && *msg == '\n') msg++;
+    fprintf(info, "%d %d %ld %ld %d %d %d %lu\n", k, e->err, pos, ftell(data) - pos,
+      e->unconn_base, xctx->netlist_unconn_cnt - e->unconn_base, e->nmodels, (unsigned long)strlen(msg));
+    fputs(msg, info);
+    for(m = 0; m < e->nmodels; m++) {
+      fprintf(info, "%lu %lu\n", (unsigned long)strlen(e->model_key[m]), (unsigned long)strlen(e->model[m]));
+      fputs(e->model_key[m], info);
+      fputs(e->model[m], info);
+    }
+    free_spice_block(e);
+  }
+  fflush(data);
+  fflush(info);
+}
+
+/* read results of a worker process, return number of blocks read */
+static int spice_block_results(FILE *data, FILE *info, Spice_block **res, int njobs)
+{
+  int k, m, n = 0;
+  long pos, len;
+  unsigned long l1, l2;
+  Spice_block e, *r;
+
+  rewind(info);
+  while(fscanf(info, "%d %d %ld %ld %d %d %d %lu", &k, &e.err, &pos, &len,
+        &e.unconn_base, &e.unconn_cnt, &e.nmodels, &l1) == 8 && getc(info) == '\n') {
+    if(k < 0 || k >= njobs || res[k]) break;
+    r = my_calloc(_ALLOC_ID_, 1, sizeof(Spice_block));
+    r->err = e.err;
+    r->unconn_base = e.unconn_base;
+    r->unconn_cnt = e.unconn_cnt;
+    r->msg = block_read(info, l1);
+    for(m = 0; m < e.nmodels; m++) {
+      if(fscanf(info, "%lu %lu", &l1, &l2) != 2 || getc(info) != '\n') break;
+      my_realloc(_ALLOC_ID_, &r->model_key, (m + 1) * sizeof(char *));
+      my_realloc(_ALLOC_ID_, &r->model, (m + 1) * sizeof(char *));
+      r->model_key[m] = block_read(info, l1);
+      r->model[m] = block_read(info, l2);
+      r->nmodels++;
+    }
+    fseek(data, pos, SEEK_SET);
+    r->text = block_read(data, len);
+    r->len = len;
+    if(m < e.nmodels || strlen(r->text) != r->len) {
+      free_spice_block(r);
+      break;
+    }
+    res[k] = r;
+    n++;
+  }
+  return n;
+}
+#endif
+
+/* second pass of parallel netlisting: netlist blocks job[] in 'jobs' forked worker processes,
+ * then print them and replay their device_model attributes in job order, as a serial run would do.
+ * Blocks not returned by a worker are netlisted here */
+static int spice_block_jobs(FILE *fd, int jobs, Spice_job *job, int njobs, int web_url)
+{
+  int err = 0, k;
+  Spice_block **res;
+  #ifdef __unix__
+  int w, status;
+  pid_t *pid;
+  FILE **data, **info;
+  #endif
+
+  res = my_calloc(_ALLOC_ID_, njobs, sizeof(Spice_block *));
+  #ifdef __unix__
+  if(jobs > njobs) jobs = njobs;
+  pid = my_calloc(_ALLOC_ID_, jobs, sizeof(pid_t));
+  data = my_calloc(_ALLOC_ID_, jobs, sizeof(FILE *));
+  info = my_calloc(_ALLOC_ID_, jobs, sizeof(FILE *));
+  fflush(NULL); /* do not duplicate pending output in children */
+  for(w = 0; w < jobs; w++) {
+    pid[w] = -1;
+    if(!(data[w] = tmpfile()) || !(info[w] = tmpfile())) break;
+    if((pid[w] = fork()) == 0) { /* child process */
+      spice_block_worker(data[w], info[w], w, jobs, job, njobs, web_url);
+      _exit(0);
+    }
+  }
+  for(w = 0; w < jobs; w++) {
+    if(pid[w] > 0 && waitpid(pid[w], &status, 0) == pid[w] && WIFEXITED(status) && !WEXITSTATUS(status)) {
+      k = spice_block_results(data[w], info[w], res, njobs);
+      dbg(1, "spice_block_jobs(): worker %d returned %d blocks\n", w, k);
+    }
+    if(data[w]) fclose(data[w]);
+    if(info[w]) fclose(info[w]);
+  }
+  my_free(_ALLOC_ID_, &pid);
+  my_free(_ALLOC_ID_, &data);
+  my_free(_ALLOC_ID_, &info);
+  #endif
+  for(k = 0; k < njobs; k++) {
+    if(res[k]) {
+      err |= block_replay(fd, res[k]);
+      if(res[k]->msg[0]) statusmsg(res[k]->msg, 2);
+      free_spice_block(res[k]);
+    } else {
+      dbg(1, "spice_block_jobs(): netlisting %s in parent process\n", xctx->sym[job[k].sym].name);
+      err |= spice_block_job(fd, job + k, web_url);
+    }
+  }
+  my_free(_ALLOC_ID_, &res);
+  return err;
+}
+
 int spice_block_netlist(FILE *fd, int i)
 {
   int err = 0;
@@ -667,15 +1225,8 @@ int spice_block_netlist(FILE *fd, int i)
     my_free(_ALLOC_ID_, &extra);
     fprintf(fd, "\n");
   
-    spice_stop ? load_schematic(0,filename, 0, 1) : load_schematic(1,filename, 0, 1);
-    get_additional_symbols(1);
-    err |= spice_netlist(fd, spice_stop);  /* 20111113 added spice_stop */
-    err |= warning_overlapped_symbols(0);
-    if(xctx->schprop && xctx->schprop[0]) {
-      fprintf(fd,"**** begin user architecture code\n");
-      fprintf(fd, "%s\n", xctx->schprop);
-      fprintf(fd,"**** end user architecture code\n");
-    }
+    if(block_options && !split_f) err |= spice_block_cached(fd, i, filename, spice_stop);
+    else err |= spice_block_body(fd, filename, spice_stop);
     fprintf(fd, ".ends\n\n");
   }
   if(split_f) {
@@ -695,6 +1246,755 @@ int spice_block_netlist(FILE *fd, int i)
   return err;
 }
 
+/* SPICE NETLIST POST PROCESSING */
+
+/* C implementation of the 'awk -f spice.awk | awk -f break.awk' pipeline run
+ * on the netlister output: join continuation lines, expand R1[m:n] instance names
+ * with .param values, expand comma separated instance names and ?n node lists,
+ * handle spice_prefix / #prefix# fields, translate value= and .save lines,
+ * finally break lines longer than 130 chars. Lines are processed and written
+ * one at a time. spice.awk / break.awk are still used for flat netlists or if
+ * tcl variable spice_netlist_awk is set. */
+
+typedef struct {
+  char *s;
+  size_t len;
+  size_t size;
+} Pp_str;
+
+typedef struct {
+  char *buf;  /* copy of line, fields separated by NULs */
+  size_t size;
+  char **f;   /* f[1] ... f[nf], as awk $1 ... $NF */
+  int nf;
+  int fsize;
+} Pp_fields;
+
+typedef struct {
+  FILE *fd;
+  char *yy;   /* pending line, continuation lines are appended here */
+  int first;
+  int user_code;
+  int eof;
+} Pp_join;
+
+typedef struct {
+  FILE *fd;   /* output */
+  int xyce;
+  int user_code;
+  int brk_user_code;
+  int quote;
+  char *spiceprefix;
+  Str_hashtable par; /* .param name=value */
+  Pp_str l;   /* current line ($0) */
+  Pp_str t;   /* scratch */
+  Pp_str o;   /* output line */
+  Pp_str ab;  /* comma separated lists, items separated by NULs */
+  Pp_fields r;
+  size_t *item; /* offset in ab of list items */
+  int item_size;
+  int *arg_first, *arg_num; /* first item index and number of items for each field */
+  int arg_size;
+} Pp_state;
+
+static void pp_cat(Pp_str *d, const char *s, size_t n)
+{
+  if(d->len + n + 1 > d->size) {
+    d->size = (d->len + n + 1) * 2;
+    my_realloc(_ALLOC_ID_, &d->s, d->size);
+  }
+  memcpy(d->s + d->len, s, n);
+  d->len += n;
+  d->s[d->len] = '\0';
+}
+
+static void pp_cats(Pp_str *d, const char *s)
+{
+  pp_cat(d, s, strlen(s));
+}
+
+static void pp_set(Pp_str *d, const char *s)
+{
+  d->len = 0;
+  pp_cat(d, s, strlen(s));
+}
+
+/* awk default field splitting */
+static void pp_split(Pp_fields *r, const char *s)
+{
+  size_t len = strlen(s);
+  char *p;
+
+  if(len + 1 > r->size) {
+    r->size = len + 1;
+    my_realloc(_ALLOC_ID_, &r->buf, r->size);
+  }
+  memcpy(r->buf, s, len + 1);
+  r->nf = 0;
+  p = r->buf;
+  while(1) {
+    while(*p == ' ' || *p == '\t' || *p == '\n') p++;
+    if(!*p) break;
+    if(r->nf + 2 > r->fsize) {
+      r->fsize = (r->nf + 2) * 2;
+      my_realloc(_ALLOC_ID_, &r->f, r->fsize * sizeof(char *));
+    }
+    r->f[++r->nf] = p;
+    while(*p && *p != ' ' && *p != '\t' && *p != '\n') p++;
+    if(!*p) break;
+    *p++ = '\0';
+  }
+}
+
+/* rebuild line from fields as awk does after a field assignment,
+ * field i (if i > 0) replaced with fi */
+static void pp_rebuild(Pp_str *d, Pp_fields *r, int i, const char *fi)
+{
+  int j;
+
+  d->len = 0;
+  pp_cat(d, "", 0);
+  for(j = 1; j <= r->nf; j++) {
+    if(j > 1) pp_cat(d, " ", 1);
+    pp_cats(d, j == i ? fi : r->f[j]);
+  }
+}
+
+/* ^\?-?[0-9]+$ */
+static int pp_is_mult(const char *s)
+{
+  if(*s++ != '?') return 0;
+  if(*s == '-') s++;
+  if(!isdigit((unsigned char)*s)) return 0;
+  while(isdigit((unsigned char)*s)) s++;
+  return *s == '\0';
+}
+
+/* \?-?[0-9] */
+static int pp_has_mult(const char *s)
+{
+  while((s = strchr(s, '?'))) {
+    s++;
+    if(isdigit((unsigned char)s[0]) || (s[0] == '-' && isdigit((unsigned char)s[1]))) return 1;
+  }
+  return 0;
+}
+
+/* ^\*\*\*\* (begin|end) user (architecture|header) code */
+static int pp_user_code_marker(const char *s, const char *be)
+{
+  size_t n = strlen(be);
+
+  if(strncmp(s, "**** ", 5) || strncmp(s + 5, be, n)) return 0;
+  s += 5 + n;
+  return !strncmp(s, " user architecture code", 23) || !strncmp(s, " user header code", 17);
+}
+
+static int pp_is_ident(int c)
+{
+  return isalnum(c) || c == '_';
+}
+
+/* ^##[a-zA-Z_]+ */
+static int pp_is_hash_hash(const char *s)
+{
+  return s[0] == '#' && s[1] == '#' && (isalpha((unsigned char)s[2]) || s[2] == '_');
+}
+
+/* ^#[a-zA-Z_0-9]+#[a-zA-Z_]+ , return prefix length */
+static size_t pp_hash_prefix(const char *s)
+{
+  size_t n = 1;
+
+  if(s[0] != '#') return 0;
+  while(pp_is_ident((unsigned char)s[n])) n++;
+  if(n == 1 || s[n] != '#' || !(isalpha((unsigned char)s[n + 1]) || s[n + 1] == '_')) return 0;
+  return n - 1;
+}
+
+/* case insensitive search of pat in the first n chars of s */
+static const char *pp_strncasestr(const char *s, size_t n, const char *pat)
+{
+  size_t i, m = strlen(pat);
+
+  for(i = 0; i + m <= n; i++) {
+    if(!my_strncasecmp(s + i, pat, m)) return s + i;
+  }
+  return NULL;
+}
+
+/* split s on commas (awk split(s, a, ",")) appending items to st->ab,
+ * return index of first item in st->item, *num set to number of items */
+static int pp_list(Pp_state *st, const char *s, int first_item, int *num)
+{
+  int n = first_item;
+  size_t off;
+
+  *num = 0;
+  if(!s[0]) return first_item;
+  off = st->ab.len;
+  pp_cats(&st->ab, s);
+  st->ab.len++; /* keep NUL terminator */
+  while(1) {
+    if(n + 1 > st->item_size) {
+      st->item_size = (n + 1) * 2;
+      my_realloc(_ALLOC_ID_, &st->item, st->item_size * sizeof(size_t));
+    }
+    st->item[n++] = off;
+    (*num)++;
+    while(st->ab.s[off] && st->ab.s[off] != ',') off++;
+    if(!st->ab.s[off]) break;
+    st->ab.s[off++] = '\0';
+  }
+  return first_item;
+}
+
+/* gsub(pat, rep) on current line, pat is a literal string */
+static void pp_gsub(Pp_state *st, const char *pat, const char *rep)
+{
+  const char *s, *p;
+  size_t n = strlen(pat);
+
+  if(!strstr(st->l.s, pat)) return;
+  st->t.len = 0;
+  pp_cat(&st->t, "", 0);
+  for(s = st->l.s; (p = strstr(s, pat)); s = p + n) {
+    pp_cat(&st->t, s, p - s);
+    pp_cats(&st->t, rep);
+  }
+  pp_cats(&st->t, s);
+  pp_set(&st->l, st->t.s);
+}
+
+#define PP_ITEM(st, i) ((st)->ab.s + (st)->item[i])
+
+static void pp_break(Pp_state *st, char *s, size_t len);
+
+static void pp_emit(Pp_state *st, Pp_str *d)
+{
+  pp_break(st, d->s, d->len);
+}
+
+/* .param lines: remove spaces around '=' then record name=value of each field */
+static void pp_get_params(Pp_state *st, const char *line)
+{
+  const char *s;
+  char *p, *eq, *q;
+  int j;
+
+  st->t.len = 0;
+  pp_cat(&st->t, "", 0);
+  for(s = line; *s; s++) {
+    if(*s == '=') {
+      while(st->t.len && st->t.s[st->t.len - 1] == ' ') st->t.len--;
+      pp_cat(&st->t, "=", 1);
+      while(s[1] == ' ') s++;
+    } else pp_cat(&st->t, s, 1);
+  }
+  pp_split(&st->r, st->t.s);
+  for(j = 2; j <= st->r.nf; j++) {
+    p = st->r.f[j];
+    eq = strrchr(p, '=');
+    if(eq) {
+      *eq = '\0';
+      if((q = strchr(p, '='))) *q = '\0';
+      str_hash_lookup(&st->par, p, eq + 1, XINSERT);
+    } else {
+      str_hash_lookup(&st->par, p, p, XINSERT);
+    }
+  }
+}
+
+static void pp_num(Pp_str *d, double x)
+{
+  char n[50];
+
+  if(x == (double)(long)x) my_snprintf(n, S(n), "%ld", (long)x);
+  else my_snprintf(n, S(n), "%.6g", x);
+  pp_cats(d, n);
+}
+
+/* R1[m:n] --> R1[10],R1[9],...,R1[5] if .param m=10 n=5 */
+static void pp_vector_instance(Pp_state *st)
+{
+  const char *s, *p, *q, *c, *first, *last;
+  char *f;
+  Str_hashentry *entry;
+  double j, jl, step;
+  size_t mark;
+
+  if(st->r.nf < 1) return;
+  s = st->r.f[1];
+  if(!isalpha((unsigned char)s[0])) return;
+  for(p = s + 1; *p && *p != '[' && *p != ']' && *p != ':'; p++);
+  if(p == s + 1 || *p != '[') return;
+  q = p + 1;
+  if(!isalpha((unsigned char)*q) && *q != '_') return;
+  for(c = q; pp_is_ident((unsigned char)*c); c++);
+  if(*c != ':') return;
+  c++;
+  if(!isalpha((unsigned char)*c) && *c != '_') return;
+  for(; pp_is_ident((unsigned char)*c); c++);
+  if(c[0] != ']' || c[1]) return;
+
+  /* s = name[first:last] , split in place */
+  f = st->r.f[1];
+  f[p - s] = '\0';
+  f[strchr(q, ':') - s] = '\0';
+  f[c - s] = '\0';
+  first = f + (q - s);
+  last = first + strlen(first) + 1;
+  if((entry = str_hash_lookup(&st->par, first, NULL, XLOOKUP))) first = entry->value;
+  if((entry = str_hash_lookup(&st->par, last, NULL, XLOOKUP))) last = entry->value;
+
+  st->o.len = 0;
+  pp_cats(&st->o, f);
+  pp_cat(&st->o, "[", 1);
+  pp_cats(&st->o, first);
+  pp_cat(&st->o, "]", 1);
+  j = atof(first);
+  jl = atof(last);
+  step = jl > j ? 1.0 : jl < j ? -1.0 : 0.0;
+  /* step == 0 with first != last would loop forever in spice.awk, stop here */
+  if(strcmp(first, last) && step != 0.0) while(1) {
+    j += step;
+    pp_cat(&st->o, ",", 1);
+    pp_cats(&st->o, f);
+    pp_cat(&st->o, "[", 1);
+    mark = st->o.len;
+    pp_num(&st->o, j);
+    if(!strcmp(st->o.s + mark, last) || (step > 0 ? j >= jl : j <= jl)) {
+      pp_cat(&st->o, "]", 1);
+      break;
+    }
+    pp_cat(&st->o, "]", 1);
+  }
+  pp_rebuild(&st->l, &st->r, 1, st->o.s);
+  pp_split(&st->r, st->l.s);
+}
+
+/* xyce: .save lines of spice_probe elements --> .print, remove trailing m=1 */
+static void pp_xyce(Pp_state *st)
+{
+  const char *s = st->l.s;
+  size_t n;
+
+  while(*s == ' ' || *s == '\t') s++;
+  if(!my_strncasecmp(s, ".save", 5) && (s[5] == ' ' || s[5] == '\t') && pp_has_mult(s + 5)) {
+    pp_rebuild(&st->t, &st->r, 1, "");
+    pp_set(&st->l, ".print ");
+    pp_cat(&st->l, st->t.s, st->t.len);
+    pp_split(&st->r, st->l.s);
+  }
+  /* gsub(/ [mM] *= *1 *$/,"") */
+  n = st->l.len;
+  while(n && st->l.s[n - 1] == ' ') n--;
+  if(!n || st->l.s[--n] != '1') return;
+  while(n && st->l.s[n - 1] == ' ') n--;
+  if(!n || st->l.s[--n] != '=') return;
+  while(n && st->l.s[n - 1] == ' ') n--;
+  if(n < 2 || (st->l.s[n - 1] != 'm' && st->l.s[n - 1] != 'M') || st->l.s[n - 2] != ' ') return;
+  st->l.len = n - 2;
+  st->l.s[st->l.len] = '\0';
+  pp_split(&st->r, st->l.s);
+}
+
+/* .save / .print lines with ?n node lists */
+static void pp_save(Pp_state *st)
+{
+  char *s, *saveinstr = NULL, *savetype, *p;
+  int i, j, num, first;
+
+  for(s = st->l.s; *s; s++) *s = (char)tolower((unsigned char)*s);
+  pp_split(&st->r, st->l.s);
+  my_strdup2(_ALLOC_ID_, &saveinstr, st->r.f[1]);
+  if(!st->xyce) {
+    pp_rebuild(&st->t, &st->r, 1, "");
+    /* remove ?n multiplicity fields and spaces after '(' / before ')' */
+    st->o.len = 0;
+    pp_cat(&st->o, "", 0);
+    for(s = st->t.s; *s; s++) {
+      if(*s == '?' && (isdigit((unsigned char)s[1]) || (s[1] == '-' && isdigit((unsigned char)s[2])))) {
+        while(st->o.len && st->o.s[st->o.len - 1] == ' ') st->o.len--;
+        s++;
+        if(*s == '-') s++;
+        while(isdigit((unsigned char)*s)) s++;
+        while(*s == ' ') s++;
+        s--;
+      } else pp_cat(&st->o, s, 1);
+    }
+    st->t.len = 0;
+    pp_cat(&st->t, "", 0);
+    for(s = st->o.s; *s; s++) {
+      pp_cat(&st->t, s, 1);
+      if(*s == '(') while(s[1] == ' ') s++;
+    }
+    st->o.len = 0;
+    pp_cat(&st->o, "", 0);
+    for(s = st->t.s; *s; s++) {
+      if(*s == ')') while(st->o.len && st->o.s[st->o.len - 1] == ' ') st->o.len--;
+      pp_cat(&st->o, s, 1);
+    }
+    pp_split(&st->r, st->o.s);
+    for(i = 1; i <= st->r.nf; i++) {
+      pp_set(&st->o, st->r.f[i]);
+      savetype = st->o.s;
+      s = st->r.f[i];
+      if((p = strrchr(s, '('))) s = p + 1;
+      if((p = strchr(savetype, '('))) *p = '\0';
+      if((p = strchr(s, ')'))) *p = '\0';
+      st->ab.len = 0;
+      first = pp_list(st, s, 0, &num);
+      for(j = first; j < first + num; j++) {
+        st->t.len = 0;
+        pp_cats(&st->t, saveinstr);
+        pp_cat(&st->t, " ", 1);
+        pp_cats(&st->t, savetype);
+        pp_cat(&st->t, "(", 1);
+        pp_cats(&st->t, PP_ITEM(st, j));
+        pp_cat(&st->t, ")", 1);
+        pp_emit(st, &st->t);
+      }
+    }
+  }
+  my_free(_ALLOC_ID_, &saveinstr);
+}
+
+/* instance lines: one line for each (comma separated) instance name, ?n fields
+ * pick n nodes from the following comma separated node list */
+static void pp_instance(Pp_state *st)
+{
+  static const char *special_devs[] = {"ymemristor", "ylin", "ydelay", "ytransline", "ypgbr",
+     "ypowergridbranch", "yacc", ".model", ".subckt", NULL};
+  Pp_fields *r = &st->r;
+  int i, j, num = 0, names = 0, n, an, special = 0;
+  long l, nmult;
+
+  st->ab.len = 0;
+  if(r->nf >= 1) for(i = 0; special_devs[i]; i++) {
+    if(!my_strcasecmp(r->f[1], special_devs[i])) {
+      special = 1;
+      break;
+    }
+  }
+  if(special) {
+    /* type word before device name: 'ylin 1 a,b,c' --> 'ylin,ylin,ylin 1 a,b,c' */
+    if(r->nf >= 3) pp_list(st, r->f[3], 0, &num);
+    st->o.len = 0;
+    pp_cat(&st->o, "", 0);
+    for(i = 0; i < num; i++) {
+      if(i) pp_cat(&st->o, ",", 1);
+      pp_cats(&st->o, r->f[1]);
+    }
+    pp_rebuild(&st->l, r, 1, st->o.s);
+    pp_split(r, st->l.s);
+    st->ab.len = 0;
+    names = pp_list(st, st->o.s, 0, &num);
+  } else if(r->nf >= 1) {
+    names = pp_list(st, r->f[1], 0, &num);
+  }
+  if(num == 0) {
+    st->o.len = 0;
+    pp_cat(&st->o, "", 0);
+    pp_emit(st, &st->o);
+  }
+  if(r->nf + 2 > st->arg_size) {
+    st->arg_size = (r->nf + 2) * 2;
+    my_realloc(_ALLOC_ID_, &st->arg_first, st->arg_size * sizeof(int));
+    my_realloc(_ALLOC_ID_, &st->arg_num, st->arg_size * sizeof(int));
+  }
+  n = num;
+  for(j = 2; j <= r->nf; j++) {
+    st->arg_num[j] = 0;
+    if(pp_is_mult(r->f[j])) continue;
+    st->arg_first[j] = pp_list(st, r->f[j], n, &an);
+    st->arg_num[j] = an;
+    n += an;
+  }
+  for(i = 1; i <= num; i++) {
+    st->o.len = 0;
+    pp_cats(&st->o, st->spiceprefix ? st->spiceprefix : "");
+    pp_cats(&st->o, PP_ITEM(st, names + i - 1));
+    pp_cat(&st->o, " ", 1);
+    for(j = 2; j <= r->nf; j++) {
+      if(!pp_is_mult(r->f[j])) {
+        pp_cats(&st->o, r->f[j]);
+        pp_cat(&st->o, " ", 1);
+      } else {
+        nmult = atol(r->f[j++] + 1);
+        an = j <= r->nf ? st->arg_num[j] : 0;
+        if(nmult == -1) nmult = an;
+        if(an == 0) continue; /* spice.awk: division by zero */
+        for(l = 0; l < nmult; l++) {
+          pp_cats(&st->o, PP_ITEM(st, st->arg_first[j] + (l + nmult * (i - 1)) % an));
+          pp_cat(&st->o, " ", 1);
+        }
+      }
+    }
+    pp_emit(st, &st->o);
+  }
+}
+
+/* spice.awk process() */
+static void pp_process(Pp_state *st)
+{
+  Pp_fields *r = &st->r;
+  const char *l = st->l.s;
+  char *s, *p;
+  size_t n;
+  int i, changed = 0;
+  static const char *value_sub[] = {"gG cur=", "eE vol=", "rR r=", "cC c=", NULL};
+
+  if(strstr(l, "**** end_element")) {
+    my_free(_ALLOC_ID_, &st->spiceprefix);
+    return;
+  }
+  if(strstr(l, "**** spice_prefix")) {
+    my_strdup2(_ALLOC_ID_, &st->spiceprefix, r->nf >= 3 ? r->f[3] : "");
+    return;
+  }
+  if(strstr(l, "**** begin user header code")) {
+    st->user_code = 1;
+    return;
+  }
+  if(strstr(l, "**** begin user architecture code")) {
+    st->user_code = 1;
+    pp_emit(st, &st->l);
+    return;
+  }
+  if(strstr(l, "**** end user architecture code")) {
+    st->user_code = 0;
+    pp_emit(st, &st->l);
+    return;
+  }
+  if(strstr(l, "**** end user header code")) {
+    st->user_code = 0;
+    return;
+  }
+  if(st->user_code || (r->nf >= 1 && r->f[1][0] == '*')) {
+    pp_emit(st, &st->l);
+    return;
+  }
+  /* ##name --> name, #dx#name,name1 --> ?1 dxname,dxname1 */
+  for(i = 1; i <= r->nf; i++) {
+    if(pp_is_hash_hash(r->f[i])) {
+      r->f[i] += 2;
+      changed = 1;
+    } else if((n = pp_hash_prefix(r->f[i]))) {
+      st->o.len = 0;
+      pp_cat(&st->o, "", 0);
+      if(i > 1 && r->f[i - 1][0] != '?') pp_cats(&st->o, "?1 ");
+      pp_cat(&st->o, r->f[i] + 1, n);
+      for(s = r->f[i] + n + 2; *s; s++) {
+        pp_cat(&st->o, s, 1);
+        if(*s == ',') pp_cat(&st->o, r->f[i] + 1, n);
+      }
+      pp_rebuild(&st->l, r, i, st->o.s);
+      pp_split(r, st->l.s);
+      changed = 0;
+    }
+  }
+  if(changed) {
+    pp_rebuild(&st->t, r, 0, NULL);
+    pp_set(&st->l, st->t.s);
+  }
+  pp_gsub(st, "PARAM:", "");
+  for(i = 0; value_sub[i]; i++) {
+    if(st->l.s[0] == value_sub[i][0] || st->l.s[0] == value_sub[i][1]) {
+      if((p = (char *)pp_strncasestr(st->l.s, st->l.len, " value="))) {
+        n = p - st->l.s;
+        st->t.len = 0;
+        pp_cat(&st->t, st->l.s, n);
+        pp_cats(&st->t, value_sub[i] + 2);
+        pp_cats(&st->t, p + 7);
+        pp_set(&st->l, st->t.s);
+      }
+    }
+  }
+  pp_gsub(st, " value=", " ");
+  pp_gsub(st, " VALUE=", " ");
+  /* diodes: sub(/PERI[ \t]*=/,"PJ=") */
+  if(st->l.s[0] == 'D' && (p = strstr(st->l.s, "PERI"))) {
+    for(; p; p = strstr(p + 1, "PERI")) {
+      for(s = p + 4; *s == ' ' || *s == '\t'; s++);
+      if(*s == '=') break;
+    }
+    if(p) {
+      n = p - st->l.s;
+      st->t.len = 0;
+      pp_cat(&st->t, st->l.s, n);
+      pp_cats(&st->t, "PJ=");
+      pp_cats(&st->t, s + 1);
+      pp_set(&st->l, st->t.s);
+    }
+  }
+  pp_split(r, st->l.s);
+
+  if(r->nf >= 1 && (!my_strcasecmp(r->f[1], ".save") || !my_strcasecmp(r->f[1], ".print")) &&
+     pp_has_mult(st->l.s)) {
+    pp_save(st);
+  } else if(r->nf >= 1 && strstr(r->f[1], ".subckt")) {
+    /* sub(/ m=[0-9]+/," "); gsub(","," ") */
+    for(p = st->l.s; (p = strstr(p, " m=")); p++) {
+      if(isdigit((unsigned char)p[3])) {
+        for(s = p + 3; isdigit((unsigned char)*s); s++);
+        memmove(p + 1, s, strlen(s) + 1);
+        st->l.len -= s - p - 1;
+        break;
+      }
+    }
+    pp_gsub(st, ",", " ");
+    pp_emit(st, &st->l);
+  } else {
+    pp_instance(st);
+  }
+}
+
+/* break.awk: break lines longer than 130 chars, not inside {...} or '...' */
+static void pp_break(Pp_state *st, char *s, size_t len)
+{
+  FILE *fd = st->fd;
+  const char *f1;
+  size_t i, f1len, sep, fld;
+  int pos = 0, nobreak;
+  char first;
+
+  if(pp_user_code_marker(s, "begin")) st->brk_user_code = 1;
+  while(len && (s[len - 1] == ' ' || s[len - 1] == '\t')) len--;
+  s[len] = '\0';
+  for(f1 = s; *f1 == ' ' || *f1 == '\t' || *f1 == '\n'; f1++);
+  if(!*f1) {
+    putc('\n', fd);
+    return;
+  }
+  first = s[0];
+  for(f1len = 0; f1[f1len] && f1[f1len] != ' ' && f1[f1len] != '\t' && f1[f1len] != '\n'; f1len++);
+  /* don't break .include lines as ngspice chokes on these. */
+  if(st->brk_user_code) nobreak = 1;
+  else if(pp_strncasestr(f1, f1len, ".inc") || pp_strncasestr(f1, f1len, ".lib") ||
+          pp_strncasestr(f1, f1len, ".title") || pp_strncasestr(f1, f1len, ".save") ||
+          pp_strncasestr(f1, f1len, ".write")) nobreak = 1;
+  else if(len >= 12 && !strncmp(s, "** ", 3) && !strncmp(s + 6, "_path:", 6)) nobreak = 1;
+  else nobreak = 0;
+
+  if(st->quote || strpbrk(s, "{}'")) {
+    for(i = 0; i < len; i++) {
+      pos++;
+      if(s[i] == '{' || s[i] == '}' || s[i] == '\'') st->quote = !st->quote;
+      if(!nobreak && pos > 130 && !st->quote && (s[i] == ' ' || s[i] == '\t')) {
+        fputs(first == '*' ? "\n*+" : "\n+", fd);
+        pos = 0;
+      }
+      putc(s[i], fd);
+    }
+  } else {
+    for(i = 0; i < len; i += sep + fld) {
+      for(sep = 0; s[i + sep] == ' ' || s[i + sep] == '\t'; sep++);
+      for(fld = 0; i + sep + fld < len && s[i + sep + fld] != ' ' && s[i + sep + fld] != '\t'; fld++);
+      pos += (int)(sep + fld);
+      if(!nobreak && pos > 130) {
+        fputs(first == '*' ? "\n*+" : "\n+", fd);
+        pos = 0;
+      }
+      fwrite(s + i, 1, sep + fld, fd);
+    }
+  }
+  putc('\n', fd);
+  if(pp_user_code_marker(s, "end")) st->brk_user_code = 0;
+}
+
+/* spice.awk line joiner: append '+' continuation lines (not in user code),
+ * return next joined line (to be freed by caller) or NULL at end of file */
+static char *pp_join_next(Pp_join *jn)
+{
+  char *line, *zz;
+  size_t len;
+
+  while(jn->eof == 0) {
+    if(!(line = my_fgets(jn->fd, &len))) {
+      jn->eof = 1;
+      zz = jn->yy;
+      jn->yy = NULL;
+      if(!zz) my_strdup2(_ALLOC_ID_, &zz, "");
+      return zz;
+    }
+    if(len && line[len - 1] == '\n') line[len - 1] = '\0';
+    if(pp_user_code_marker(line, "begin")) jn->user_code = 1;
+    if(line[0] == '+' && !jn->user_code) {
+      my_strcat(_ALLOC_ID_, &jn->yy, " ");
+      my_strcat(_ALLOC_ID_, &jn->yy, line + 1);
+      my_free(_ALLOC_ID_, &line);
+      continue;
+    }
+    zz = jn->yy;
+    jn->yy = line;
+    if(jn->first) {
+      jn->first = 0;
+      my_free(_ALLOC_ID_, &zz);
+      continue;
+    }
+    if(!zz) my_strdup2(_ALLOC_ID_, &zz, "");
+    if(pp_user_code_marker(zz, "end")) jn->user_code = 0;
+    return zz;
+  }
+  return NULL;
+}
+
+/* post process raw spice netlist src into dest (spice.awk | break.awk),
+ * return 1 if done, 0 if files can not be opened */
+int spice_postprocess(const char *src, const char *dest, int xyce)
+{
+  Pp_join jn;
+  Pp_state st;
+  char *line;
+
+  memset(&jn, 0, sizeof(jn));
+  memset(&st, 0, sizeof(st));
+  if(!(jn.fd = fopen(src, fopen_read_mode))) {
+    dbg(0, "spice_postprocess(): can not open %s\n", src);
+    return 0;
+  }
+  if(!(st.fd = fopen(dest, "w"))) {
+    dbg(0, "spice_postprocess(): can not open %s for writing\n", dest);
+    fclose(jn.fd);
+    return 0;
+  }
+  st.xyce = xyce;
+  str_hash_init(&st.par, HASHSIZE);
+  /* first pass: .param values used in R1[m:n] instance names */
+  jn.first = 1;
+  while((line = pp_join_next(&jn))) {
+    if(!my_strncasecmp(line, ".param", 6)) pp_get_params(&st, line);
+    my_free(_ALLOC_ID_, &line);
+  }
+  rewind(jn.fd);
+  jn.eof = jn.user_code = 0;
+  jn.first = 1;
+  while((line = pp_join_next(&jn))) {
+    pp_set(&st.l, line);
+    my_free(_ALLOC_ID_, &line);
+    pp_split(&st.r, st.l.s);
+    pp_vector_instance(&st);
+    if(xyce) pp_xyce(&st);
+    pp_process(&st);
+  }
+  fclose(jn.fd);
+  fclose(st.fd);
+  str_hash_free(&st.par);
+  my_free(_ALLOC_ID_, &st.spiceprefix);
+  my_free(_ALLOC_ID_, &st.l.s);
+  my_free(_ALLOC_ID_, &st.t.s);
+  my_free(_ALLOC_ID_, &st.o.s);
+  my_free(_ALLOC_ID_, &st.ab.s);
+  my_free(_ALLOC_ID_, &st.r.buf);
+  my_free(_ALLOC_ID_, &st.r.f);
+  my_free(_ALLOC_ID_, &st.item);
+  my_free(_ALLOC_ID_, &st.arg_first);
+  my_free(_ALLOC_ID_, &st.arg_num);
+  return 1;
+}
+
+
 /* GENERIC PURPOSE HASH TABLE */
 
 
@@ -491,6 +491,8 @@ static void alloc_xschem_data(const char *top_path, const char *win_path)
   xctx->graph_bottom = 0;
   xctx->graph_left = 0;
   xctx->graph_lastsel = -1;
+  xctx->graph_cache = NULL;
+  xctx->graph_caches = 0;
   xctx->graph_struct.hilight_wave = -1; /* index of wave */
   xctx->wires = 0;
   xctx->instances = 0;
@@ -948,6 +950,9 @@ static void xwin_exit(void)
  trim_chars(NULL, ""); /* clear static data in function */
  tcl_hook2(NULL); /* clear static data in function */
  save_ascii_string(NULL, NULL, 0); /* clear static data in function */
+ free_spice_block_cache(); /* clear spice_block_netlist() cache */
+ free_design_cache(); /* clear load_schematic() / load_sym_def() cache */
+ free_sym_path_index(); /* clear abs_sym_path() directory index */
  dbg(1, "xwin_exit(): removing font\n");
  for(i=0;i<127; ++i) my_free(_ALLOC_ID_, &character[i]);
  dbg(1, "xwin_exit(): closed display\n");
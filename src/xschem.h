@@ -779,6 +779,43 @@ struct hilight_hashentry
 
 
 
+/* data derived from a raw file data column, built on demand and freed
+ * (free_raw_colcache()) whenever column data changes */
+#define PYRAMID_BLOCK 16
+/* run length list of logic levels of a data column, used to draw digital buses */
+typedef struct {
+  double vthl, vthh; /* thresholds used to compute levels */
+  int n; /* number of runs */
+  int *start; /* first point of each run */
+  char *level; /* logic level of each run: 0, 1, 2 (X: value between thresholds) */
+} Raw_levels;
+
+typedef struct {
+  /* multi resolution min/max summary, used to draw waveforms with many more points than
+   * graph pixels. level l block j holds min/max of points [j * bs, (j + 1) * bs),
+   * bs = PYRAMID_BLOCK^(l+1) */
+  int levels;
+  SPICE_DATA **min;
+  SPICE_DATA **max;
+  /* same block structure for integrals of y and y^2 versus sweep variable (linear interpolation)
+   * of intervals [p, p + 1], used for averages and rms values on x ranges */
+  double **integ;
+  double **integ2;
+  /* start points of strictly increasing runs of values, used to binary search sweep variables */
+  int nruns;
+  int *runs;
+  /* logic level runs, rebuilt if thresholds change */
+  Raw_levels lev;
+} Raw_colcache;
+
+/* vcd file signal: value changes as (point, value) pairs, point is the index in the time
+ * (sweep variable) data column of all value change times of the vcd file */
+typedef struct {
+  int n;
+  int *point;
+  SPICE_DATA *val;
+} Vcd_signal;
+
 typedef struct {
   /* spice raw file specific data */
   char **names;
@@ -802,6 +839,34 @@ typedef struct {
   char *schname;
   int level;  /* hierarchy level where raw file has been read */
   double sweep1, sweep2;
+  /* raw_mmap mode: binary raw file is mmap()ed and data columns are gathered
+   * into values[] only when first accessed (see get_raw_column()) */
+  char *map;        /* mapped raw file, NULL if all data has been read into values[] */
+  size_t map_size;
+  time_t map_mtime; /* used to detect raw file being overwritten while mapped */
+  int map_checked;  /* raw_map_stamp when map_valid was last computed (see map_is_valid()) */
+  int map_valid;
+  size_t *map_ofs;  /* file offset of the binary block of each dataset */
+  int map_nvars;    /* number of doubles in each binary block row */
+  int map_ac;       /* complex data: columns are (magnitude, phase) pairs */
+  int map_columns;  /* mapped file is a column major raw cache file (see read_raw_cache()) */
+  int map_float;    /* raw cache file data is stored as float */
+  int *map_col;     /* column in binary block rows for each variable, -1 if not from file.
+                     * Also set for vcd files: data columns are loaded on demand if map_col != NULL */
+  int *map_lru;     /* last access stamp of each data column, for raw_max_columns */
+  /* raw_memory_budget: resident data of least recently used raw files is freed
+   * and read again when switching to them (see raw_trim_memory()) */
+  int lru;          /* last access stamp of raw file */
+  int evicted;      /* data columns have been freed, read again on access */
+  int modified;     /* data changed after reading (raw add|del|set), can not be read again */
+  Vcd_signal *vcd;  /* vcd file: value changes of each variable, data columns built when used */
+  Raw_colcache **colcache; /* derived data of each data column, built when needed */
+  /* follow mode: read data rows appended to last dataset by a running simulation */
+  size_t follow_pos;     /* raw file offset after last read data row */
+  size_t follow_hdr_pos; /* raw file offset of last dataset 'No. Points:' value */
+  int follow_nvars;      /* number of doubles in each binary block row */
+  int follow_ac;
+  int follow_alloc;      /* allocated points in data columns */
 } Raw;
 
 
@@ -888,9 +953,38 @@ typedef struct {
   int hilight_wave; /* wave index */
   int logx, logy;
   int rainbow; /* draw multiple datasets with incrementing colors */
+  int envelope; /* draw min/max band and mean of all datasets instead of each dataset */
+  double envelope_sigma; /* if > 0 draw also mean +/- envelope_sigma * standard deviation */
   double linewidth_mult; /* multiply factor for waveforms line width */
 } Graph_ctx;
 
+/* graph node showing its value at cursor1 position */
+typedef struct {
+  char *ntok; /* node or bus (name followed by bits) */
+  int bus;
+  int idx; /* data column of node or bus msb */
+  int sweep_idx;
+  int dataset; /* dataset to plot, -1: all */
+  int wave_color, wcnt, n_nodes;
+  int measure_p; /* point after cursor1 and sweep values of it and previous point */
+  double measure_x, measure_prev_x;
+} Graph_meas;
+
+/* graph contents (grid, waves, labels) without cursors and cursor1 node values,
+ * used to redraw only cursors when they are moved. Valid until data, zoom or
+ * graph attributes change */
+typedef struct {
+  Pixmap pixmap;
+  int x, y, w, h; /* screen area of graph */
+  char *prop; /* graph attributes contents were drawn with */
+  Raw *raw;
+  int raw_stamp;
+  int flags; /* cursors (2, 4) shown when drawn */
+  int measure_ok; /* cursor1 node values can be updated without drawing waves */
+  int nmeas;
+  Graph_meas *meas;
+} Graph_cache;
+
 typedef struct {
   int savew, saveh;
   double savexor, saveyor, savezoom, savelw;
@@ -1113,6 +1207,8 @@ typedef struct {
   int graph_bottom; 
   int graph_left;
   int graph_lastsel; /* last graph that was clicked (selected) */
+  Graph_cache *graph_cache; /* per graph cached contents, indexed as xctx->rect[GRIDLAYER] */
+  int graph_caches;
   /*    */
   XSegment *biggridpoint;
   XPoint *gridpoint;
@@ -1253,6 +1349,7 @@ extern int embed_rawfile(const char *rawfile);
 extern int read_rawfile_from_attr(const char *b64s, size_t length, const char *type);
 extern int raw_read_from_attr(Raw **rawptr, const char *type, double sweep1, double sweep2);
 extern int raw_add_vector(const char *varname, const char *expr);
+extern int raw_follow(Raw *raw);
 extern int raw_deletevar(const char *name);
 extern int new_rawfile(const char *name, const char *type, const char *sweepvar,
                        double start, double end, double step);
@@ -1268,17 +1365,35 @@ extern unsigned char *base64_decode(const char *data, const size_t input_length,
 extern char *base64_encode(const unsigned char *data, const size_t input_length, size_t *output_length, int brk);
 extern unsigned char *ascii85_encode(const unsigned char *data, const size_t input_length, size_t *output_length);
 extern int  get_raw_index(const char *node, Int_hashentry **entry_ret);
+extern SPICE_DATA *get_raw_column(Raw *raw, int idx);
+extern double get_raw_point(Raw *raw, int idx, int point);
+extern void revalidate_raw_maps(void);
+extern void raw_load_columns(Raw *raw, const char *nodes);
+extern void raw_trim_memory(void);
+extern void raw_memory_info(void);
+extern void free_raw_colcache(Raw *raw, int idx);
+extern int get_raw_run(Raw *raw, int idx, int a, int b);
+extern void get_raw_minmax(Raw *raw, int idx, int a, int b, double *min, double *max);
+extern int get_raw_stamp(void);
+extern Raw_levels *get_raw_levels(Raw *raw, int idx, double vthl, double vthh);
+extern int raw_level_run(Raw_levels *lv, int p);
+extern int get_raw_stats(Raw *raw, int idx, int dset, double x1, double x2, double *stats);
 extern void free_rawfile(Raw **rawptr, int dr);
 extern int update_op();
+extern void set_op_data(Raw *raw, const char *fmt);
 extern int extra_rawfile(int what, const char *f, const char *type, double sweep1, double sweep2);
 extern int raw_read(const char *f, Raw **rawptr, const char *type, double sweep1, double sweep2);
+extern int raw_to_vcd(const char *f, const char *vcd, double vth, double vtl);
 extern int table_read(const char *f);
 extern double get_raw_value(int dataset, int idx, int point);
 extern int plot_raw_custom_data(int sweep_idx, int first, int last, const char *ntok, const char *yname);
+extern void free_expr_cache(Raw *raw);
+extern void free_graph_envelopes(Raw *raw);
 extern int calc_custom_data_yrange(int sweep_idx, const char *express, Graph_ctx *gr);
 extern int sch_waves_loaded(void);
 extern int edit_wave_attributes(int what, int i, Graph_ctx *gr);
 extern void draw_graph(int i, int flags, Graph_ctx *gr, void *ct);
+extern void free_graph_cache(void);
 extern int find_closest_wave(int i, Graph_ctx *gr);
 extern void setup_graph_data(int i, int skip, Graph_ctx *gr);
 extern int graph_fullyzoom(xRect *r,  Graph_ctx *gr, int graph_dataset);
@@ -1330,6 +1445,8 @@ extern const char *get_cell(const char *str, int no_of_dir);
 extern const char *get_cell_w_ext(const char *str, int no_of_dir);
 extern const char *rel_sym_path(const char *s);
 extern const char *abs_sym_path(const char *s, const char *ext);
+extern void free_sym_path_index(void);
+extern void revalidate_sym_path_index(void);
 extern const char *sanitized_abs_sym_path(const char *s, const char *ext);
 extern const char *sanitize(const char *name);
 extern const char *add_ext(const char *f, const char *ext);
@@ -1477,8 +1594,11 @@ extern int global_verilog_netlist(int global);
 extern int vhdl_block_netlist(FILE *fd, int i);
 extern int verilog_block_netlist(FILE *fd, int i);
 extern int spice_block_netlist(FILE *fd, int i);
+extern int spice_postprocess(const char *src, const char *dest, int xyce);
+extern void free_spice_block_cache(void);
 extern void remove_symbols(void);
 extern void remove_symbol(int i);
+extern void free_symbol(xSymbol *sym);
 extern void clear_drawing(void);
 extern int is_from_web(const char *f);
 extern int load_sym_def(const char name[], FILE *embed_fd);
@@ -1505,6 +1625,10 @@ extern void mem_push_undo(void);
 extern void mem_pop_undo(int redo, int set_modify_status);
 extern void mem_delete_undo(void);
 extern void mem_clear_undo(void);
+extern Undo_slot *mem_save_objects(void);
+extern void mem_restore_objects(Undo_slot *u);
+extern void mem_free_objects(Undo_slot *u);
+extern void free_design_cache(void);
 extern int load_schematic(int load_symbol, const char *fname, int reset_undo, int alert);
 /* check if filename already in an open window/tab */
 extern int get_tab_or_window_number(const char *win_path);
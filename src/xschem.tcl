@@ -843,7 +843,7 @@ proc has_included_subcircuit {symname spice_sym_def} {
 # should not be called directly by user 
 # does netlist post processing, called from global_(spice|vhdl|verilog)_netlist()
 proc netlist {source_file show netlist_file} {
- global XSCHEM_SHAREDIR flat_netlist netlist_dir simulate_bg
+ global XSCHEM_SHAREDIR flat_netlist netlist_dir simulate_bg spice_netlist_awk
  global verilog_2001 debug_var OS has_x verilog_bitblast
 
  regsub {/$} $netlist_dir {} netlist_dir
@@ -869,7 +869,12 @@ proc netlist {source_file show netlist_file} {
    set cmd  ${XSCHEM_SHAREDIR}/spice.awk
    set brk ${XSCHEM_SHAREDIR}/break.awk
    set flatten ${XSCHEM_SHAREDIR}/flatten.awk
-   if {$flat_netlist==0} {
+   if {$flat_netlist==0 && !$spice_netlist_awk} {
+     if {![xschem spice_postprocess $source_file $dest $xyce]} {
+       ;# C post processing failed, fall back to awk pipeline
+       eval exec {awk -f $cmd -- $xyce $source_file | awk -f $brk > $dest}
+     }
+   } elseif {$flat_netlist==0} {
      eval exec {awk -f $cmd -- $xyce $source_file | awk -f $brk > $dest}
    } else {
      eval exec {awk -f $cmd -- $xyce $source_file | awk -f $flatten | awk -f $brk > $dest}
@@ -2224,6 +2229,21 @@ proc waves {{type {}}} {
     }
   }
 }
+
+## follow mode: while a simulation is writing the active raw file load newly
+## written data and redraw every $raw_follow_interval ms, until the simulation
+## completes the dataset. 'raw_follow stop' ends follow mode.
+proc raw_follow {{what start}} {
+  global raw_follow_interval raw_follow_id
+  if {[info exists raw_follow_id]} {
+    after cancel $raw_follow_id
+    unset raw_follow_id
+  }
+  if {$what eq {stop}} return
+  if {[xschem raw follow] >= 0} {
+    set raw_follow_id [after $raw_follow_interval raw_follow]
+  }
+}
 # ============================================================
 
 
@@ -2654,7 +2674,7 @@ proc graph_edit_properties {n} {
   global graph_bus graph_sort graph_digital graph_selected graph_sel_color
   global graph_unlocked graph_schname graph_logx graph_logy cadlayers graph_rainbow 
   global graph_linewidth_mult graph_change_done has_x graph_dialog_default_geometry
-  global graph_autoload
+  global graph_autoload graph_envelope
 
   if { ![info exists has_x]} {return} 
   set graph_change_done 0
@@ -2673,6 +2693,8 @@ proc graph_edit_properties {n} {
   set_ne graph_sort 0
   set graph_rainbow 0
   if {[xschem getprop rect 2 $n rainbow] == 1} {set graph_rainbow 1}
+  set graph_envelope 0
+  if {[xschem getprop rect 2 $n envelope] == 1} {set graph_envelope 1}
   set graph_logx 0
   if {[xschem getprop rect 2 $n logx] == 1} {set graph_logx 1}
   set graph_logy 0
@@ -2985,6 +3007,14 @@ proc graph_edit_properties {n} {
          xschem draw_graph $graph_selected
        }
      }
+  checkbutton .graphdialog.top.envelope -text {Envelope} -variable graph_envelope \
+    -command {
+       if { [xschem get schname] eq $graph_schname } {
+         graph_push_undo
+         xschem setprop rect 2 $graph_selected envelope $graph_envelope fast
+         xschem draw_graph $graph_selected
+       }
+     }
   label .graphdialog.top.lw -text "  Line width:"
   entry .graphdialog.top.lwe -width 4 
   bind .graphdialog.top.lwe <KeyRelease> {
@@ -3074,6 +3104,7 @@ proc graph_edit_properties {n} {
   pack .graphdialog.top.dig -side left
   pack .graphdialog.top.unlocked -side left
   pack .graphdialog.top.rainbow -side left
+  pack .graphdialog.top.envelope -side left
   pack .graphdialog.top.lw -side left
   pack .graphdialog.top.lwe -side left
   .graphdialog.top3.ymin insert 0 [xschem getprop rect 2 $graph_selected y1]
@@ -5933,6 +5964,8 @@ proc rel_sym_path {symbol} {
 # given a symbol reference 'sym' return its absolute path
 # Example: % abs_sym_path devices/iopin.sch
 #          /home/schippes/share/xschem/xschem_library/devices/iopin.sym
+# On unix C code uses a built in version of this procedure and of rel_sym_path
+# unless tcl_sym_path is set, so these may be redefined in xschemrc.
 proc abs_sym_path {fname {ext {} } } {
   global pathlist OS
 
@@ -6955,7 +6988,7 @@ set tctx::global_list {
   enter_text_default_geometry filetmp fix_broken_tiled_fill flat_netlist fullscreen
   gaw_fd gaw_tcp_address graph_autoload graph_bus
   graph_change_done graph_digital graph_dialog_default_geometry graph_linewidth_mult graph_logx
-  graph_logy graph_rainbow graph_schname graph_sel_color graph_sel_wave
+  graph_logy graph_rainbow graph_envelope graph_schname graph_sel_color graph_sel_wave
   graph_selected graph_sort graph_unlocked hide_empty_graphs hide_symbols tctx::hsize
   incr_hilight incremental_select infowindow_text intuitive_interface 
   keep_symbols launcher_default_program
@@ -8376,6 +8409,9 @@ set_ne search_schematic 0
 # instead of in the directory of currently loaded schematic.
 set_ne split_files 0
 set_ne flat_netlist 0
+set_ne spice_netlist_awk 0 ;# use spice.awk / break.awk for spice netlist post processing
+set_ne spice_block_cache 0 ;# reuse netlist of unchanged subcircuits from previous netlist runs
+set_ne netlist_jobs 0 ;# spice netlist subcircuits in this number of parallel processes (batch mode)
 set_ne netlist_show 0
 set_ne color_ps 1
 set_ne ps_page_title 1 ;# add a title in the top left page corner
@@ -8442,10 +8478,23 @@ set_ne graph_bus 0
 set_ne graph_logx 0
 set_ne graph_logy 0
 set_ne graph_rainbow 0
+set_ne graph_envelope 0
 set_ne graph_selected {}
 set_ne graph_schname {}
 set_ne graph_change_done 0 ;# used to push undo only once when editing graphs
 set_ne graph_linewidth_mult 1.4 ;# default multiplier (w.r.t. xschem lines) for line width in graphs 
+## map binary raw files in memory and load data columns only when used by graphs
+set_ne raw_mmap 0
+## max number of data columns of mapped raw files kept in memory, 0: no limit
+set_ne raw_max_columns 0
+## max memory (MB) for data of all loaded raw files, least recently used data is freed, 0: no limit
+set_ne raw_memory_budget 0
+## update interval (ms) of raw file follow mode (raw_follow procedure)
+set_ne raw_follow_interval 1000
+## write a column major cache file (<rawfile>.xcache) of loaded raw files and use it next time
+set_ne raw_cache 0
+## store raw cache data in single precision
+set_ne raw_cache_float 0
 # user clicked this wave 
 set_ne graph_sel_wave {}
 # flag to force simulation stop (Esc key pressed) 
@@ -8476,6 +8525,8 @@ set_ne xschem_listen_port {}
 set_ne bespice_listen_port {}
 
 set_ne keep_symbols 0 ;# if set loaded symbols will not be purged when descending/netlisting.
+set_ne design_cache 0 ;# keep parsed schematics and symbols in memory, reload only changed files
+set_ne tcl_sym_path 0 ;# use abs_sym_path / rel_sym_path tcl procs instead of the built in (faster) code
 
 # hide instance details (show only bbox) 
 set_ne hide_symbols 0